@@ -0,0 +1,455 @@
+/********************************************************************************
+ *  This file is part of the lopezworks SDK utility library for C/C++ (lwsdk).
+ *
+ *  Copyright (C) 2015-2017 Edwin R. Lopez
+ *  http://www.lopezworks.info
+ *
+ *  This source code is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation LGPL v2.1
+ *  (http://www.gnu.org/licenses/).
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ *  02110-1301  USA.
+ ********************************************************************************/
+#include "Benchmark.h"
+#include "Files.h"
+#include "Strings.h"
+#include "Utils.h"
+#include "Exceptions.h"
+#include "Alloc.h"
+
+#include <cmath>
+#include <chrono>
+#include <regex>
+#include <vector>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <algorithm>
+#include <unistd.h>
+#include <sys/utsname.h>
+
+using namespace std;
+
+namespace lwsdk::Bench
+{
+    struct BenchEntry
+    {
+        string    name;      // group/name
+        BenchFn_t fn;
+    };
+
+    struct BenchResult
+    {
+        string   name;
+        uint64_t iterations{0};
+        int      repetitions{0};
+        double   nsPerOp{0};        // median over repetitions
+        double   nsPerOpMin{0};
+        double   nsPerOpMax{0};
+        double   bytesPerSecond{0};
+        double   itemsPerSecond{0};
+        double   allocsPerOp{-1};      // -1 if allocations are not tracked
+        bool     failed{false};
+    };
+
+    struct Options
+    {
+        string   filter{".*"};
+        string   jsonPathname;
+        double   minTimeSec{0.5};
+        int      repetitions{5};
+    };
+
+
+    /**
+     * Returns the registry of benchmarks; built on first use since benchmarks are added
+     * from static initializers in other translation units.
+     */
+    static vector<BenchEntry>& registry()
+    {
+        static vector<BenchEntry> entries;
+        return entries;
+    }
+
+
+    static uint64_t nowNanos()
+    {
+        return (uint64_t) chrono::duration_cast<chrono::nanoseconds>( chrono::steady_clock::now().time_since_epoch() ).count();
+    }
+
+
+    bool State::keepRunning()
+    {
+        if ( count == 0 )
+        {
+            allocsStart = Alloc::threadAllocations();
+            startNs = nowNanos();
+        }
+
+        if ( count++ < iterations )
+            return true;
+
+        endNs = nowNanos();
+        allocsEnd = Alloc::threadAllocations();
+        return false;
+    }
+
+
+    bool add( const char *group, const char *name, const BenchFn_t& fn )
+    {
+        registry().push_back( { string( group ) + "/" + name, fn } );
+        return true;
+    }
+
+
+    const string& dataDir()
+    {
+        static string dir = LWSDK_BENCH_DATA_DIR;
+        return dir;
+    }
+
+
+    static bool usedTempDir = false;
+
+    const string& tempDir()
+    {
+        usedTempDir = true;
+
+        static string dir = [] {
+            char tmpl[] = "/tmp/lwsdk-bench-XXXXXX";
+            if ( mkdtemp( tmpl ) == nullptr )
+                throw IOException( "Failed to create benchmark scratch directory", errnoCode() );
+
+            return string( tmpl );
+        }();
+
+        return dir;
+    }
+
+
+    string generateText( size_t lineCount, uint32_t seed )
+    {
+        static const char *words[] = { "alpha", "bravo", "charlie", "delta", "echo", "foxtrot",
+                                       "golf", "hotel", "india", "juliett", "kilo", "lima" };
+        // Fixed LCG rather than <random>, whose distributions may differ across library versions
+        uint32_t x = seed;
+        auto next = [&x] { x = x * 1664525u + 1013904223u; return x >> 8; };
+
+        string text;
+
+        for ( size_t i = 0; i < lineCount; i++ )
+        {
+            int fields = 4 + (int) (next() % 8);
+
+            for ( int f = 0; f < fields; f++ )
+            {
+                if ( f > 0 )
+                    text += ", ";
+
+                if ( next() % 3 == 0 )
+                    text += to_string( next() % 100000 );
+                else
+                    text += words[ next() % 12 ];
+            }
+
+            text += "\n";
+        }
+
+        return text;
+    }
+
+
+    /**
+     * Runs benchmarks and produces their results.
+     */
+    class Runner
+    {
+        const Options& opts;
+
+        /**
+         * Runs the benchmark once for the given number of iterations.
+         */
+        static State runOnce( const BenchEntry& entry, uint64_t iterations )
+        {
+            State state( iterations );
+            entry.fn( state );
+
+            // Benchmark returned without looping, or broke out of the loop
+            if ( state.endNs == 0 )
+            {
+                state.endNs = nowNanos();
+                state.allocsEnd = Alloc::threadAllocations();
+            }
+
+            return state;
+        }
+
+    public:
+        explicit Runner( const Options& opts ) : opts( opts ) {}
+
+        BenchResult run( const BenchEntry& entry )
+        {
+            // Grow the iteration count until a run is long enough to be timed reliably,
+            // then scale it to the requested minimum time
+            uint64_t targetNs = (uint64_t) (opts.minTimeSec * 1e9);
+            uint64_t iterations = 1;
+
+            while ( true )
+            {
+                State state = runOnce( entry, iterations );
+                uint64_t elapsed = max<uint64_t>( 1, state.endNs - state.startNs );
+
+                if ( elapsed >= targetNs / 10 || iterations >= 1000000000ull )
+                {
+                    iterations = max<uint64_t>( 1, (uint64_t) ((double) iterations * (double) targetNs / (double) elapsed ));
+                    break;
+                }
+
+                iterations *= (elapsed < targetNs / 1000) ? 100 : 10;
+            }
+
+            vector<double> samples;
+            State last( 0 );
+
+            for ( int i = 0; i < opts.repetitions; i++ )
+            {
+                last = runOnce( entry, iterations );
+                samples.push_back( (double) (last.endNs - last.startNs) / (double) iterations );
+            }
+
+            sort( samples.begin(), samples.end() );
+
+            BenchResult result;
+            result.name = entry.name;
+            result.iterations = iterations;
+            result.repetitions = opts.repetitions;
+            result.nsPerOp = samples[ samples.size() / 2 ];
+            result.nsPerOpMin = samples.front();
+            result.nsPerOpMax = samples.back();
+
+            if ( last.bytesPerIteration > 0 )
+                result.bytesPerSecond = (double) last.bytesPerIteration * 1e9 / result.nsPerOp;
+
+            if ( last.itemsPerIteration > 0 )
+                result.itemsPerSecond = (double) last.itemsPerIteration * 1e9 / result.nsPerOp;
+
+            if ( Alloc::isEnabled() )
+            {
+                uint64_t allocs = last.allocsEnd - last.allocsStart;
+                result.allocsPerOp = (double) allocs / (double) iterations;
+                result.failed = last.noAllocations && allocs > 0;
+            }
+
+            return result;
+        }
+    };
+
+
+    /**
+     * Escapes a string for a JSON document.
+     */
+    static string jsonString( const string& s )
+    {
+        string out = "\"";
+
+        for ( char c : s )
+        {
+            if ( c == '"' || c == '\\' )
+                out += '\\';
+
+            if ( (unsigned char) c < 0x20 )
+                out += ' ';
+            else
+                out += c;
+        }
+
+        return out + "\"";
+    }
+
+
+    /**
+     * Writes the results as JSON, along with the context they were collected in so runs
+     * from different machines or builds are not compared by mistake.
+     */
+    static void writeJson( ostream& out, const Options& opts, const vector<BenchResult>& results )
+    {
+        struct utsname uts{};
+        uname( &uts );
+
+        out << "{\n";
+        out << "  \"context\": {\n";
+        out << "    \"date\": " << jsonString( Utils::toDateTimeZ( Utils::currentTimeMillis() )) << ",\n";
+        out << "    \"host\": " << jsonString( uts.nodename ) << ",\n";
+        out << "    \"machine\": " << jsonString( uts.machine ) << ",\n";
+        out << "    \"kernel\": " << jsonString( uts.release ) << ",\n";
+        out << "    \"cpus\": " << sysconf( _SC_NPROCESSORS_ONLN ) << ",\n";
+        out << "    \"compiler\": " << jsonString( __VERSION__ ) << ",\n";
+        out << "    \"build_type\": " << jsonString( LWSDK_BENCH_BUILD_TYPE ) << ",\n";
+        out << "    \"alloc_tracking\": " << (Alloc::isEnabled() ? "true" : "false") << ",\n";
+        out << "    \"min_time_sec\": " << opts.minTimeSec << ",\n";
+        out << "    \"repetitions\": " << opts.repetitions << "\n";
+        out << "  },\n";
+        out << "  \"benchmarks\": [";
+
+        for ( size_t i = 0; i < results.size(); i++ )
+        {
+            const BenchResult& r = results[i];
+
+            out << (i == 0 ? "\n" : ",\n");
+            out << "    { \"name\": " << jsonString( r.name )
+                << ", \"iterations\": " << r.iterations
+                << ", \"repetitions\": " << r.repetitions
+                << ", \"ns_per_op\": " << r.nsPerOp
+                << ", \"ns_per_op_min\": " << r.nsPerOpMin
+                << ", \"ns_per_op_max\": " << r.nsPerOpMax
+                << ", \"bytes_per_second\": " << r.bytesPerSecond
+                << ", \"items_per_second\": " << r.itemsPerSecond;
+
+            if ( r.allocsPerOp >= 0 )
+                out << ", \"allocs_per_op\": " << r.allocsPerOp;
+
+            out << " }";
+        }
+
+        out << "\n  ]\n}\n";
+    }
+
+
+    /**
+     * Formats a throughput value with a decimal unit prefix.
+     */
+    static string humanRate( double v, const char *unit )
+    {
+        static const char *prefixes[] = { "", "k", "M", "G", "T" };
+        int p = 0;
+
+        while ( v >= 1000.0 && p < 4 )
+        {
+            v /= 1000.0;
+            p++;
+        }
+
+        char buf[32];
+        snprintf( buf, sizeof( buf ), "%.1f %s%s/s", v, prefixes[p], unit );
+        return buf;
+    }
+
+
+    static void usage( const char *program )
+    {
+        cout << "Usage: " << program << " [options]\n"
+             << "  --filter=REGEX      Run only benchmarks whose group/name matches REGEX\n"
+             << "  --json=FILE         Write results as JSON to FILE, '-' for stdout\n"
+             << "  --min-time=SEC      Minimum time per repetition, default 0.5\n"
+             << "  --repetitions=N     Repetitions per benchmark, default 5\n"
+             << "  --quick             Short runs, e.g. for PGO training: --min-time=0.05 --repetitions=1\n"
+             << "  --list              List benchmarks and exit\n";
+    }
+
+} // ns
+
+
+using namespace lwsdk;
+using namespace lwsdk::Bench;
+
+int main( int argc, char **argv )
+{
+    Options opts;
+    bool listOnly = false;
+
+    for ( int i = 1; i < argc; i++ )
+    {
+        string arg = argv[i];
+        string value = arg.find( '=' ) != string::npos ? arg.substr( arg.find( '=' ) + 1 ) : "";
+
+        if ( Strings::startsWith( arg, "--filter=" ))
+            opts.filter = value;
+        else if ( Strings::startsWith( arg, "--json=" ))
+            opts.jsonPathname = value;
+        else if ( Strings::startsWith( arg, "--min-time=" ))
+            opts.minTimeSec = Strings::parseDouble( value, opts.minTimeSec );
+        else if ( Strings::startsWith( arg, "--repetitions=" ))
+            opts.repetitions = max( 1, Strings::parseInt( value, opts.repetitions ));
+        else if ( arg == "--quick" )
+        {
+            opts.minTimeSec = 0.05;
+            opts.repetitions = 1;
+        }
+        else if ( arg == "--list" )
+            listOnly = true;
+        else
+        {
+            usage( argv[0] );
+            return arg == "--help" || arg == "-h" ? 0 : 1;
+        }
+    }
+
+    regex filter( opts.filter );
+    Runner runner( opts );
+    vector<BenchResult> results;
+    int failures = 0;
+
+    // Table goes to stderr when the JSON goes to stdout
+    ostream& table = (opts.jsonPathname == "-") ? cerr : cout;
+
+    for ( const BenchEntry& entry : registry() )
+    {
+        if ( !regex_search( entry.name, filter ))
+            continue;
+
+        if ( listOnly )
+        {
+            cout << entry.name << "\n";
+            continue;
+        }
+
+        BenchResult r = runner.run( entry );
+        results.push_back( r );
+
+        char line[256];
+        snprintf( line, sizeof( line ), "%-40s %14.1f ns/op %12lu iters  (min %.1f, max %.1f)",
+                  r.name.c_str(), r.nsPerOp, (unsigned long) r.iterations, r.nsPerOpMin, r.nsPerOpMax );
+        table << line;
+
+        if ( r.bytesPerSecond > 0 )
+            table << "  " << humanRate( r.bytesPerSecond, "B" );
+
+        if ( r.itemsPerSecond > 0 )
+            table << "  " << humanRate( r.itemsPerSecond, "items" );
+
+        if ( r.allocsPerOp >= 0 )
+            table << "  " << r.allocsPerOp << " allocs/op";
+
+        if ( r.failed )
+        {
+            table << "  FAILED: expected no allocations";
+            failures++;
+        }
+
+        table << endl;
+    }
+
+    if ( opts.jsonPathname == "-" )
+    {
+        writeJson( cout, opts, results );
+    }
+    else if ( !opts.jsonPathname.empty() )
+    {
+        ofstream out( opts.jsonPathname );
+        writeJson( out, opts, results );
+    }
+
+    if ( usedTempDir )
+        Files::tryRemove( tempDir() );
+
+    return failures > 0 ? 1 : 0;
+}
@@ -0,0 +1,128 @@
+/********************************************************************************
+ *  This file is part of the lopezworks SDK utility library for C/C++ (lwsdk).
+ *
+ *  Copyright (C) 2015-2017 Edwin R. Lopez
+ *  http://www.lopezworks.info
+ *
+ *  This source code is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation LGPL v2.1
+ *  (http://www.gnu.org/licenses/).
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ *  02110-1301  USA.
+ ********************************************************************************/
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+#include <string>
+#include <cstdint>
+#include <functional>
+
+/**
+ * Minimal benchmark harness for the lwsdk benchmark suite. Benchmarks are registered
+ * with LWSDK_BENCHMARK() and timed over the loop driven by State::keepRunning(); any
+ * setup done before the loop is not measured:
+ *
+ *        LWSDK_BENCHMARK( Strings, trim )
+ *        {
+ *            std::string s = "  some text  ";     // not timed
+ *
+ *            while ( state.keepRunning() )
+ *                Bench::doNotOptimize( Strings::trim( s ));
+ *        }
+ */
+namespace lwsdk::Bench
+{
+    class State
+    {
+        uint64_t iterations;
+        uint64_t count{0};
+        uint64_t startNs{0};
+        uint64_t endNs{0};
+        uint64_t bytesPerIteration{0};
+        uint64_t itemsPerIteration{0};
+        uint64_t allocsStart{0};
+        uint64_t allocsEnd{0};
+        bool     noAllocations{false};
+
+        friend class Runner;
+
+    public:
+        explicit State( uint64_t iterations ) : iterations( iterations ) {}
+
+        /**
+         * Returns true while the benchmark loop must keep going. The clock starts with the
+         * first call and stops when it returns false.
+         */
+        bool keepRunning();
+
+        /**
+         * Number of iterations the loop runs for.
+         */
+        uint64_t getIterations() const { return iterations; }
+
+        /**
+         * Reports throughput in bytes per second, given the bytes processed per iteration.
+         */
+        void setBytesPerIteration( uint64_t bytes ) { bytesPerIteration = bytes; }
+
+        /**
+         * Reports throughput in items per second, given the items processed per iteration.
+         */
+        void setItemsPerIteration( uint64_t items ) { itemsPerIteration = items; }
+
+        /**
+         * Marks the loop as a steady-state path that must not allocate; in builds with
+         * allocation tracking the benchmark fails if it does.
+         */
+        void expectNoAllocations() { noAllocations = true; }
+    };
+
+    typedef std::function<void( State& state )> BenchFn_t;
+
+    /**
+     * Registers a benchmark, named "group/name" in the results.
+     */
+    bool add( const char *group, const char *name, const BenchFn_t& fn );
+
+    /**
+     * Directory holding the fixed datasets shipped in benchmarks/data.
+     */
+    const std::string& dataDir();
+
+    /**
+     * Scratch directory for benchmarks creating files, removed on exit.
+     */
+    const std::string& tempDir();
+
+    /**
+     * Returns deterministic text of the given number of lines, made of comma separated
+     * words and numbers, for benchmarks needing larger inputs than the fixed datasets.
+     */
+    std::string generateText( size_t lineCount, uint32_t seed = 1 );
+
+    /**
+     * Keeps the compiler from optimizing away a value computed by the benchmark.
+     */
+    template <typename T> inline void doNotOptimize( const T& value )
+    {
+        asm volatile( "" : : "r,m"( value ) : "memory" );
+    }
+
+} // ns
+
+
+#define LWSDK_BENCHMARK( group, name ) \
+    static void bench_##group##_##name( lwsdk::Bench::State& state ); \
+    static bool bench_##group##_##name##_added = lwsdk::Bench::add( #group, #name, bench_##group##_##name ); \
+    static void bench_##group##_##name( lwsdk::Bench::State& state )
+
+#endif //BENCHMARK_H
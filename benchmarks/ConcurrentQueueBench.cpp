@@ -0,0 +1,90 @@
+/********************************************************************************
+ *  This file is part of the lopezworks SDK utility library for C/C++ (lwsdk).
+ *
+ *  Copyright (C) 2015-2017 Edwin R. Lopez
+ *  http://www.lopezworks.info
+ *
+ *  This source code is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation LGPL v2.1
+ *  (http://www.gnu.org/licenses/).
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ *  02110-1301  USA.
+ ********************************************************************************/
+#include "Benchmark.h"
+#include "ConcurrentQueue.h"
+
+#include <thread>
+
+using namespace std;
+using namespace lwsdk;
+
+
+LWSDK_BENCHMARK( ConcurrentQueue, offerTake )
+{
+    ConcurrentQueue<int> queue;
+
+    while ( state.keepRunning() )
+    {
+        queue.offer( 1 );
+        Bench::doNotOptimize( queue.take() );
+    }
+}
+
+LWSDK_BENCHMARK( ConcurrentQueue, tryOfferTryTake )
+{
+    ConcurrentQueue<int> queue;
+
+    while ( state.keepRunning() )
+    {
+        queue.tryOffer( 1 );
+        Bench::doNotOptimize( queue.tryTake() );
+    }
+}
+
+LWSDK_BENCHMARK( ConcurrentQueue, offerTakeString )
+{
+    ConcurrentQueue<string> queue;
+    string message = "{\"type\":\"status\",\"value\":12345,\"ok\":true}";
+
+    while ( state.keepRunning() )
+    {
+        queue.offer( message );
+        Bench::doNotOptimize( queue.take() );
+    }
+}
+
+LWSDK_BENCHMARK( ConcurrentQueue, takeTimeoutEmpty )
+{
+    ConcurrentQueue<int> queue;
+
+    state.expectNoAllocations();
+
+    while ( state.keepRunning() )
+        Bench::doNotOptimize( queue.take( 0, -1 ));
+}
+
+LWSDK_BENCHMARK( ConcurrentQueue, producerConsumer )
+{
+    // One producer thread, consumer in the benchmark thread; bounded like the webserver queues
+    ConcurrentQueue<int> queue( 1024 );
+    uint64_t n = state.getIterations();
+
+    thread producer( [&queue, n] {
+        for ( uint64_t i = 0; i < n; i++ )
+            queue.offer( (int) i );
+    });
+
+    while ( state.keepRunning() )
+        Bench::doNotOptimize( queue.take() );
+
+    producer.join();
+}
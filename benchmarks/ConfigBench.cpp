@@ -0,0 +1,110 @@
+/********************************************************************************
+ *  This file is part of the lopezworks SDK utility library for C/C++ (lwsdk).
+ *
+ *  Copyright (C) 2015-2017 Edwin R. Lopez
+ *  http://www.lopezworks.info
+ *
+ *  This source code is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation LGPL v2.1
+ *  (http://www.gnu.org/licenses/).
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ *  02110-1301  USA.
+ ********************************************************************************/
+#include "Benchmark.h"
+#include "Config.h"
+
+using namespace std;
+using namespace lwsdk;
+
+
+LWSDK_BENCHMARK( Config, loadConfigFile )
+{
+    string pathname = Bench::dataDir() + "/sample.conf";
+
+    while ( state.keepRunning() )
+    {
+        Config::reset();
+        Config::loadConfigFile( pathname );
+    }
+}
+
+LWSDK_BENCHMARK( Config, loadConfigArgs )
+{
+    const char *args[] = { "/usr/bin/lwsdk-app", "-v", "--port", "8080", "--host=localhost",
+                           "--log-level=debug", "-t5", "--no-color", "input.txt", "output.txt" };
+    int argc = sizeof( args ) / sizeof( args[0] );
+
+    while ( state.keepRunning() )
+    {
+        Config::reset();
+        Config::loadConfigArgs( argc, (char **) args );
+    }
+
+    state.setItemsPerIteration( argc );
+}
+
+/**
+ * Getters run against the options of the sample configuration file.
+ */
+static void loadSample()
+{
+    Config::reset();
+    Config::loadConfigFile( Bench::dataDir() + "/sample.conf" );
+}
+
+LWSDK_BENCHMARK( Config, get )
+{
+    loadSample();
+
+    while ( state.keepRunning() )
+        Bench::doNotOptimize( Config::get( "server.option03" ));
+}
+
+LWSDK_BENCHMARK( Config, getMissing )
+{
+    loadSample();
+
+    while ( state.keepRunning() )
+        Bench::doNotOptimize( Config::get( "server.missing", "default" ));
+}
+
+LWSDK_BENCHMARK( Config, getInt )
+{
+    loadSample();
+
+    while ( state.keepRunning() )
+        Bench::doNotOptimize( Config::getInt( "serial.option00", 0 ));
+}
+
+LWSDK_BENCHMARK( Config, getLong )
+{
+    loadSample();
+
+    while ( state.keepRunning() )
+        Bench::doNotOptimize( Config::getLong( "metrics.option04", 0 ));
+}
+
+LWSDK_BENCHMARK( Config, getDouble )
+{
+    loadSample();
+
+    while ( state.keepRunning() )
+        Bench::doNotOptimize( Config::getDouble( "trace.option02", 0.0 ));
+}
+
+LWSDK_BENCHMARK( Config, getBool )
+{
+    loadSample();
+
+    while ( state.keepRunning() )
+        Bench::doNotOptimize( Config::getBool( "pool.option01" ));
+}
@@ -0,0 +1,73 @@
+/********************************************************************************
+ *  This file is part of the lopezworks SDK utility library for C/C++ (lwsdk).
+ *
+ *  Copyright (C) 2015-2017 Edwin R. Lopez
+ *  http://www.lopezworks.info
+ *
+ *  This source code is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation LGPL v2.1
+ *  (http://www.gnu.org/licenses/).
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ *  02110-1301  USA.
+ ********************************************************************************/
+#include "Benchmark.h"
+#include "Delta.h"
+
+using namespace std;
+using namespace lwsdk;
+
+
+/**
+ * Returns a copy of the text with about 1% of its lines changed.
+ */
+static string editLines( const string& text )
+{
+    string edited = text;
+    size_t pos = 0;
+
+    for ( int line = 0; (pos = edited.find( '\n', pos )) != string::npos; line++, pos++ )
+    {
+        if ( line % 100 == 50 )
+            edited.insert( pos, " edited" );
+    }
+
+    return edited;
+}
+
+LWSDK_BENCHMARK( Delta, encode )
+{
+    string base = Bench::generateText( 4000 );
+    string target = editLines( base );
+    PooledBuffer out = BufferPool::acquire( target.size() );
+
+    while ( state.keepRunning() )
+    {
+        out.clear();
+        Bench::doNotOptimize( Delta::encode( base, target, out, target.size() / 2 ));
+    }
+
+    state.setBytesPerIteration( target.size() );
+}
+
+LWSDK_BENCHMARK( Delta, apply )
+{
+    string base = Bench::generateText( 4000 );
+    string target = editLines( base );
+    PooledBuffer delta = BufferPool::acquire( target.size() );
+    Delta::encode( base, target, delta );
+    string out;
+
+    while ( state.keepRunning() )
+        Bench::doNotOptimize( Delta::apply( base, delta.view(), out ));
+
+    state.setBytesPerIteration( target.size() );
+}
@@ -0,0 +1,111 @@
+/********************************************************************************
+ *  This file is part of the lopezworks SDK utility library for C/C++ (lwsdk).
+ *
+ *  Copyright (C) 2015-2017 Edwin R. Lopez
+ *  http://www.lopezworks.info
+ *
+ *  This source code is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation LGPL v2.1
+ *  (http://www.gnu.org/licenses/).
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ *  02110-1301  USA.
+ ********************************************************************************/
+#include "Benchmark.h"
+#include "Files.h"
+#include "Strings.h"
+
+#include <sstream>
+
+using namespace std;
+using namespace lwsdk;
+
+// Size of the file copied by the copy benchmarks
+#define COPY_FILE_LINES 20000
+
+
+/**
+ * Returns the pathname of a scratch file holding the given number of generated lines,
+ * creating it on first use.
+ */
+static string textFile( size_t lineCount )
+{
+    string pathname = Bench::tempDir() + "/text-" + to_string( lineCount ) + ".txt";
+
+    if ( !Files::exists( pathname ))
+        Strings::saveStringAsFile( Bench::generateText( lineCount ), pathname );
+
+    return pathname;
+}
+
+LWSDK_BENCHMARK( Files, copy )
+{
+    string from = textFile( COPY_FILE_LINES );
+    string to = Bench::tempDir() + "/copy.txt";
+
+    while ( state.keepRunning() )
+        Files::copy( from, to );
+
+    state.setBytesPerIteration( Files::getFileSize( from ));
+}
+
+LWSDK_BENCHMARK( Files, streamCopy )
+{
+    string text = Bench::generateText( COPY_FILE_LINES );
+
+    while ( state.keepRunning() )
+    {
+        istringstream in( text );
+        ostringstream out;
+
+        Files::streamCopy( in, out );
+        Bench::doNotOptimize( out );
+    }
+
+    state.setBytesPerIteration( text.size() );
+}
+
+LWSDK_BENCHMARK( Files, getFileAsLines )
+{
+    string pathname = textFile( 1000 );
+
+    while ( state.keepRunning() )
+        Bench::doNotOptimize( Strings::getFileAsLines( pathname ));
+
+    state.setBytesPerIteration( Files::getFileSize( pathname ));
+    state.setItemsPerIteration( 1000 );
+}
+
+LWSDK_BENCHMARK( Files, getFileAsString )
+{
+    string pathname = textFile( 1000 );
+
+    while ( state.keepRunning() )
+        Bench::doNotOptimize( Strings::getFileAsString( pathname ));
+
+    state.setBytesPerIteration( Files::getFileSize( pathname ));
+}
+
+LWSDK_BENCHMARK( Files, exists )
+{
+    string pathname = textFile( 1000 );
+
+    while ( state.keepRunning() )
+        Bench::doNotOptimize( Files::exists( pathname ));
+}
+
+LWSDK_BENCHMARK( Files, getFileSize )
+{
+    string pathname = textFile( 1000 );
+
+    while ( state.keepRunning() )
+        Bench::doNotOptimize( Files::getFileSize( pathname ));
+}
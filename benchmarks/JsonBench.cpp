@@ -0,0 +1,114 @@
+/********************************************************************************
+ *  This file is part of the lopezworks SDK utility library for C/C++ (lwsdk).
+ *
+ *  Copyright (C) 2015-2017 Edwin R. Lopez
+ *  http://www.lopezworks.info
+ *
+ *  This source code is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation LGPL v2.1
+ *  (http://www.gnu.org/licenses/).
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ *  02110-1301  USA.
+ ********************************************************************************/
+#include "Benchmark.h"
+#include "Codecs.h"
+
+using namespace std;
+using namespace lwsdk;
+
+
+/**
+ * Returns a JSON document shaped like a dashboard update: an array of records mixing
+ * numbers, strings and nested objects.
+ */
+static string generateDocument( int records )
+{
+    Json::Value doc;
+    doc[ "version" ] = 1;
+
+    Json::Value& items = doc[ "items" ];
+    string lines = Bench::generateText( records );
+    size_t pos = 0;
+
+    for ( int i = 0; i < records; i++ )
+    {
+        size_t eol = lines.find( '\n', pos );
+        Json::Value item;
+        item[ "id" ] = i;
+        item[ "value" ] = i * 0.25;
+        item[ "online" ] = (i % 3) != 0;
+        item[ "label" ] = lines.substr( pos, eol - pos );
+        item[ "pos" ][ "x" ] = i * 7;
+        item[ "pos" ][ "y" ] = -i;
+        items.push( std::move( item ));
+        pos = eol + 1;
+    }
+
+    return Json::toString( doc );
+}
+
+LWSDK_BENCHMARK( Json, parse )
+{
+    string json = generateDocument( 1000 );
+
+    while ( state.keepRunning() )
+        Bench::doNotOptimize( Json::parse( json ).hasValue() );
+
+    state.setBytesPerIteration( json.size() );
+}
+
+LWSDK_BENCHMARK( Json, write )
+{
+    string json = generateDocument( 1000 );
+    Json::Value doc = *Json::parse( json );
+    PooledBuffer out = BufferPool::acquire( json.size() );
+
+    while ( state.keepRunning() )
+    {
+        out.clear();
+        Json::write( doc, out );
+    }
+
+    state.setBytesPerIteration( json.size() );
+}
+
+LWSDK_BENCHMARK( Json, cborRoundTrip )
+{
+    string json = generateDocument( 1000 );
+    Json::Value doc = *Json::parse( json );
+    PooledBuffer out = BufferPool::acquire( json.size() );
+
+    while ( state.keepRunning() )
+    {
+        out.clear();
+        Cbor::encode( doc, out );
+        Bench::doNotOptimize( Cbor::decode( out.view() ).hasValue() );
+    }
+
+    state.setBytesPerIteration( json.size() );
+}
+
+LWSDK_BENCHMARK( Json, msgpackRoundTrip )
+{
+    string json = generateDocument( 1000 );
+    Json::Value doc = *Json::parse( json );
+    PooledBuffer out = BufferPool::acquire( json.size() );
+
+    while ( state.keepRunning() )
+    {
+        out.clear();
+        MsgPack::encode( doc, out );
+        Bench::doNotOptimize( MsgPack::decode( out.view() ).hasValue() );
+    }
+
+    state.setBytesPerIteration( json.size() );
+}
@@ -0,0 +1,98 @@
+/********************************************************************************
+ *  This file is part of the lopezworks SDK utility library for C/C++ (lwsdk).
+ *
+ *  Copyright (C) 2015-2017 Edwin R. Lopez
+ *  http://www.lopezworks.info
+ *
+ *  This source code is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation LGPL v2.1
+ *  (http://www.gnu.org/licenses/).
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ *  02110-1301  USA.
+ ********************************************************************************/
+#include "Benchmark.h"
+#include "BufferPool.h"
+#include "Metrics.h"
+#include "Trace.h"
+
+#include <vector>
+
+using namespace std;
+using namespace lwsdk;
+
+
+LWSDK_BENCHMARK( BufferPool, acquire )
+{
+    state.expectNoAllocations();
+
+    while ( state.keepRunning() )
+        Bench::doNotOptimize( BufferPool::acquire( 256 ));
+}
+
+LWSDK_BENCHMARK( BufferPool, copyOf )
+{
+    vector<char> bytes( 1024, 'x' );
+
+    state.expectNoAllocations();
+
+    while ( state.keepRunning() )
+        Bench::doNotOptimize( BufferPool::copyOf( bytes.data(), bytes.size() ));
+
+    state.setBytesPerIteration( bytes.size() );
+}
+
+LWSDK_BENCHMARK( Metrics, counterInc )
+{
+    Counter& counter = Metrics::counter( "bench", "counter_inc" );
+
+    state.expectNoAllocations();
+
+    while ( state.keepRunning() )
+        counter.inc();
+}
+
+LWSDK_BENCHMARK( Metrics, histogramRecord )
+{
+    Histogram& histogram = Metrics::histogram( "bench", "histogram_record" );
+    uint64_t v = 1;
+
+    state.expectNoAllocations();
+
+    while ( state.keepRunning() )
+        histogram.record( v++ & 0xfffff );
+}
+
+LWSDK_BENCHMARK( Trace, spanDisabled )
+{
+    Trace::stop();
+
+    state.expectNoAllocations();
+
+    while ( state.keepRunning() )
+        TraceSpan span( "bench", "disabled" );
+}
+
+LWSDK_BENCHMARK( Trace, spanEnabled )
+{
+    Trace::start();
+
+    // Thread's event buffer is created on the first event
+    { TraceSpan warmup( "bench", "warmup" ); }
+
+    state.expectNoAllocations();
+
+    while ( state.keepRunning() )
+        TraceSpan span( "bench", "enabled" );
+
+    Trace::stop();
+    Trace::clear();
+}
@@ -0,0 +1,204 @@
+/********************************************************************************
+ *  This file is part of the lopezworks SDK utility library for C/C++ (lwsdk).
+ *
+ *  Copyright (C) 2015-2017 Edwin R. Lopez
+ *  http://www.lopezworks.info
+ *
+ *  This source code is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation LGPL v2.1
+ *  (http://www.gnu.org/licenses/).
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ *  02110-1301  USA.
+ ********************************************************************************/
+#include "Benchmark.h"
+#include "Strings.h"
+
+#include <regex>
+
+using namespace std;
+using namespace lwsdk;
+
+
+LWSDK_BENCHMARK( Strings, split )
+{
+    string line = "alpha, bravo, 12345, charlie, delta, 678, echo, foxtrot";
+
+    while ( state.keepRunning() )
+        Bench::doNotOptimize( Strings::split( line, ", *" ));
+
+    state.setBytesPerIteration( line.size() );
+}
+
+LWSDK_BENCHMARK( Strings, splitPrecompiled )
+{
+    string line = "alpha, bravo, 12345, charlie, delta, 678, echo, foxtrot";
+    regex delim( ", *" );
+
+    while ( state.keepRunning() )
+        Bench::doNotOptimize( Strings::split( line, delim ));
+
+    state.setBytesPerIteration( line.size() );
+}
+
+LWSDK_BENCHMARK( Strings, splitLines )
+{
+    string text = Bench::generateText( 1000 );
+
+    while ( state.keepRunning() )
+        Bench::doNotOptimize( Strings::split( text, "\n" ));
+
+    state.setBytesPerIteration( text.size() );
+}
+
+LWSDK_BENCHMARK( Strings, replaceAll )
+{
+    string text = Bench::generateText( 20 );
+
+    while ( state.keepRunning() )
+        Bench::doNotOptimize( Strings::replaceAll( text, "[0-9]+", "#" ));
+
+    state.setBytesPerIteration( text.size() );
+}
+
+LWSDK_BENCHMARK( Strings, replaceAllNoCase )
+{
+    string text = Bench::generateText( 20 );
+
+    while ( state.keepRunning() )
+        Bench::doNotOptimize( Strings::replaceAll( text, "ALPHA|DELTA", "x", false ));
+
+    state.setBytesPerIteration( text.size() );
+}
+
+LWSDK_BENCHMARK( Strings, trim )
+{
+    string s = "   \t  some value with spaces around it \t \r\n";
+
+    while ( state.keepRunning() )
+        Bench::doNotOptimize( Strings::trim( s ));
+}
+
+LWSDK_BENCHMARK( Strings, trimNothing )
+{
+    string s = "some value without spaces around it";
+
+    while ( state.keepRunning() )
+        Bench::doNotOptimize( Strings::trim( s ));
+}
+
+LWSDK_BENCHMARK( Strings, ltrim )
+{
+    string s = "   \t  some value with leading spaces";
+
+    while ( state.keepRunning() )
+        Bench::doNotOptimize( Strings::ltrim( s ));
+}
+
+LWSDK_BENCHMARK( Strings, rtrim )
+{
+    string s = "some value with trailing spaces \t \r\n";
+
+    while ( state.keepRunning() )
+        Bench::doNotOptimize( Strings::rtrim( s ));
+}
+
+LWSDK_BENCHMARK( Strings, toLowerCase )
+{
+    string s = "Some Mixed Case VALUE Of Moderate Length";
+
+    while ( state.keepRunning() )
+        Bench::doNotOptimize( Strings::toLowerCase( s ));
+}
+
+LWSDK_BENCHMARK( Strings, startsWith )
+{
+    string s = "/dev/ttyUSB0";
+
+    state.expectNoAllocations();
+
+    while ( state.keepRunning() )
+        Bench::doNotOptimize( Strings::startsWith( s, "/dev/tty" ));
+}
+
+LWSDK_BENCHMARK( Strings, matches )
+{
+    string s = "ttyUSB12";
+
+    while ( state.keepRunning() )
+        Bench::doNotOptimize( Strings::matches( s, "tty(USB|ACM)[0-9]+" ));
+}
+
+LWSDK_BENCHMARK( Strings, parseBool )
+{
+    string s = "yes";
+
+    while ( state.keepRunning() )
+        Bench::doNotOptimize( Strings::parseBool( s ));
+}
+
+LWSDK_BENCHMARK( Strings, parseInt )
+{
+    string s = "123456";
+
+    state.expectNoAllocations();
+
+    while ( state.keepRunning() )
+        Bench::doNotOptimize( Strings::parseInt( s, 0 ));
+}
+
+LWSDK_BENCHMARK( Strings, parseIntInvalid )
+{
+    string s = "12x";
+
+    while ( state.keepRunning() )
+        Bench::doNotOptimize( Strings::parseInt( s, -1 ));
+}
+
+LWSDK_BENCHMARK( Strings, parseLong )
+{
+    string s = "-9876543210";
+
+    state.expectNoAllocations();
+
+    while ( state.keepRunning() )
+        Bench::doNotOptimize( Strings::parseLong( s, 0 ));
+}
+
+LWSDK_BENCHMARK( Strings, parseHex )
+{
+    string s = "0x7fA3c";
+
+    state.expectNoAllocations();
+
+    while ( state.keepRunning() )
+        Bench::doNotOptimize( Strings::parseHex( s, 0 ));
+}
+
+LWSDK_BENCHMARK( Strings, parseDouble )
+{
+    string s = "3.14159265e2";
+
+    state.expectNoAllocations();
+
+    while ( state.keepRunning() )
+        Bench::doNotOptimize( Strings::parseDouble( s, 0.0 ));
+}
+
+LWSDK_BENCHMARK( Strings, tryParseIntInvalid )
+{
+    string s = "not a number";
+
+    state.expectNoAllocations();
+
+    while ( state.keepRunning() )
+        Bench::doNotOptimize( Strings::tryParseInt( s ).hasValue() );
+}
@@ -0,0 +1,101 @@
+/********************************************************************************
+ *  This file is part of the lopezworks SDK utility library for C/C++ (lwsdk).
+ *
+ *  Copyright (C) 2015-2017 Edwin R. Lopez
+ *  http://www.lopezworks.info
+ *
+ *  This source code is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation LGPL v2.1
+ *  (http://www.gnu.org/licenses/).
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ *  02110-1301  USA.
+ ********************************************************************************/
+#include "Benchmark.h"
+#include "NetlinkUEvent.h"
+#include "Strings.h"
+
+using namespace std;
+using namespace lwsdk;
+
+
+/**
+ * Returns the uevents of the fixed dataset, in the kernel's format: name=value lines.
+ */
+static vector<UEvent> loadEvents()
+{
+    vector<UEvent> events;
+    string data;
+
+    for ( const string& line : Strings::getFileAsLines( Bench::dataDir() + "/uevents.txt" ))
+    {
+        if ( Strings::startsWith( line, "#" ))
+            continue;
+
+        if ( !line.empty() )
+        {
+            data += line + "\n";
+            continue;
+        }
+
+        if ( !data.empty() )
+            events.emplace_back( data );
+
+        data.clear();
+    }
+
+    if ( !data.empty() )
+        events.emplace_back( data );
+
+    return events;
+}
+
+LWSDK_BENCHMARK( UEvent, valueOf )
+{
+    vector<UEvent> events = loadEvents();
+    size_t i = 0;
+
+    while ( state.keepRunning() )
+        Bench::doNotOptimize( events[ i++ % events.size() ].valueOf( "DEVNAME" ));
+}
+
+LWSDK_BENCHMARK( UEvent, valueOfMissing )
+{
+    vector<UEvent> events = loadEvents();
+    size_t i = 0;
+
+    while ( state.keepRunning() )
+        Bench::doNotOptimize( events[ i++ % events.size() ].valueOf( "ID_SERIAL" ));
+}
+
+LWSDK_BENCHMARK( UEvent, intValueOf )
+{
+    vector<UEvent> events = loadEvents();
+    size_t i = 0;
+
+    while ( state.keepRunning() )
+        Bench::doNotOptimize( events[ i++ % events.size() ].intValueOf( "SEQNUM", -1 ));
+}
+
+LWSDK_BENCHMARK( UEvent, parseEvent )
+{
+    // What a typical uevent callback does: filter on subsystem and action, pick the device
+    vector<UEvent> events = loadEvents();
+    size_t i = 0;
+
+    while ( state.keepRunning() )
+    {
+        const UEvent& e = events[ i++ % events.size() ];
+
+        if ( e.valueOf( "SUBSYSTEM" ) == "tty" && e.valueOf( "ACTION" ) == "add" )
+            Bench::doNotOptimize( e.valueOf( "DEVNAME" ));
+    }
+}
@@ -0,0 +1,74 @@
+/********************************************************************************
+ *  This file is part of the lopezworks SDK utility library for C/C++ (lwsdk).
+ *
+ *  Copyright (C) 2015-2017 Edwin R. Lopez
+ *  http://www.lopezworks.info
+ *
+ *  This source code is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation LGPL v2.1
+ *  (http://www.gnu.org/licenses/).
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ *  02110-1301  USA.
+ ********************************************************************************/
+#include "Benchmark.h"
+#include "Utils.h"
+
+using namespace std;
+using namespace lwsdk;
+
+// Fixed timestamp, 2017-03-14T15:09:26.535Z, so results don't depend on the date
+#define EPOCH_MILLIS 1489504166535L
+
+
+LWSDK_BENCHMARK( Utils, toDateTimeFull )
+{
+    while ( state.keepRunning() )
+        Bench::doNotOptimize( Utils::toDateTimeFull( EPOCH_MILLIS ));
+}
+
+LWSDK_BENCHMARK( Utils, toDateTimeZ )
+{
+    while ( state.keepRunning() )
+        Bench::doNotOptimize( Utils::toDateTimeZ( EPOCH_MILLIS ));
+}
+
+LWSDK_BENCHMARK( Utils, toDateTime )
+{
+    while ( state.keepRunning() )
+        Bench::doNotOptimize( Utils::toDateTime( EPOCH_MILLIS ));
+}
+
+LWSDK_BENCHMARK( Utils, toDateTimeLocal )
+{
+    while ( state.keepRunning() )
+        Bench::doNotOptimize( Utils::toDateTime( EPOCH_MILLIS, false ));
+}
+
+LWSDK_BENCHMARK( Utils, toDate )
+{
+    while ( state.keepRunning() )
+        Bench::doNotOptimize( Utils::toDate( EPOCH_MILLIS ));
+}
+
+LWSDK_BENCHMARK( Utils, toTime )
+{
+    while ( state.keepRunning() )
+        Bench::doNotOptimize( Utils::toTime( EPOCH_MILLIS ));
+}
+
+LWSDK_BENCHMARK( Utils, currentTimeMillis )
+{
+    state.expectNoAllocations();
+
+    while ( state.keepRunning() )
+        Bench::doNotOptimize( Utils::currentTimeMillis() );
+}
@@ -0,0 +1,82 @@
+#!/usr/bin/env python3
+#
+# Compares two lwsdk-bench JSON result files, e.g. before and after a change:
+#
+#   ./compare.py before.json after.json [--threshold=5] [--filter=REGEX]
+#
+# Prints the change in ns/op per benchmark and exits with status 1 if any benchmark
+# got slower by more than the threshold percentage, so it can gate a CI job.
+#
+# This file is part of the lopezworks SDK utility library for C/C++ (lwsdk).
+# Copyright (C) 2015-2017 Edwin R. Lopez, LGPL v2.1 (http://www.gnu.org/licenses/).
+
+import argparse
+import json
+import re
+import sys
+
+
+def load(pathname):
+    with open(pathname) as f:
+        doc = json.load(f)
+
+    return doc.get("context", {}), {b["name"]: b for b in doc.get("benchmarks", [])}
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Compare two lwsdk-bench JSON result files")
+    parser.add_argument("before", help="baseline results")
+    parser.add_argument("after", help="results to compare against the baseline")
+    parser.add_argument("--threshold", type=float, default=5.0,
+                        help="slowdown percentage reported as a regression (default 5)")
+    parser.add_argument("--filter", default=".*", help="compare only benchmarks matching REGEX")
+    args = parser.parse_args()
+
+    ctx_before, before = load(args.before)
+    ctx_after, after = load(args.after)
+
+    # Results from different machines or build types are rarely comparable
+    for key in ("host", "cpus", "compiler", "build_type"):
+        if ctx_before.get(key) != ctx_after.get(key):
+            print("warning: %s differs: %s vs %s" % (key, ctx_before.get(key), ctx_after.get(key)),
+                  file=sys.stderr)
+
+    pattern = re.compile(args.filter)
+    regressions = 0
+
+    print("%-40s %14s %14s %9s" % ("benchmark", "before ns/op", "after ns/op", "change"))
+
+    for name in sorted(set(before) | set(after)):
+        if not pattern.search(name):
+            continue
+
+        if name not in before or name not in after:
+            print("%-40s %s" % (name, "only in " + ("after" if name in after else "before")))
+            continue
+
+        b = before[name]["ns_per_op"]
+        a = after[name]["ns_per_op"]
+        change = (a - b) * 100.0 / b if b > 0 else 0.0
+
+        # Changes within the run-to-run spread of either side are noise
+        spread = max(before[name]["ns_per_op_max"] - before[name]["ns_per_op_min"],
+                     after[name]["ns_per_op_max"] - after[name]["ns_per_op_min"])
+
+        mark = ""
+        if change > args.threshold and a - b > spread:
+            mark = "  REGRESSION"
+            regressions += 1
+        elif change < -args.threshold and b - a > spread:
+            mark = "  improved"
+
+        print("%-40s %14.1f %14.1f %+8.1f%%%s" % (name, b, a, change, mark))
+
+    if regressions:
+        print("\n%d benchmark(s) regressed by more than %.1f%%" % (regressions, args.threshold))
+        return 1
+
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -1,7 +1,8 @@
 #!/usr/bin/env bash
 
+# Extra cmake options can be given, e.g. ./build.sh -DLWSDK_ENABLE_LTO=ON -DLWSDK_MARCH=native
 mkdir build && cd build || exit
-cmake ..
+cmake -DCMAKE_BUILD_TYPE=Release "$@" ..
 make
 
 cd ..
@@ -0,0 +1,153 @@
+/********************************************************************************
+ *  This file is part of the lopezworks SDK utility library for C/C++ (lwsdk).
+ *
+ *  Copyright (C) 2015-2017 Edwin R. Lopez
+ *  http://www.lopezworks.info
+ *
+ *  This source code is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation LGPL v2.1
+ *  (http://www.gnu.org/licenses/).
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ *  02110-1301  USA.
+ ********************************************************************************/
+#ifndef ALLOC_H
+#define ALLOC_H
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include "Export.h"
+
+namespace lwsdk
+{
+    /**
+     * Functions backing the tracked allocator, malloc() and free() by default.
+     */
+    struct LWSDK_API AllocHooks
+    {
+        void *(*allocate)( size_t size );
+        void  (*release)( void *ptr );
+    };
+
+
+    /**
+     * Allocation counters of a subsystem.
+     */
+    struct LWSDK_API AllocStats
+    {
+        std::string subsystem;      // "webserver", "serialport", etc; "app" for threads not owned by the library
+        uint64_t allocations{0};    // allocations made
+        uint64_t frees{0};          // allocations released
+        uint64_t bytes{0};          // bytes allocated in total
+        int64_t  liveBytes{0};      // bytes currently allocated
+    };
+
+
+    /**
+     * Allocation tracking, available when the library is built with
+     * -DLWSDK_TRACK_ALLOCATIONS=ON. That build replaces the global operator new/delete and
+     * routes libwebsockets' allocations through the same allocator, so every allocation goes
+     * through the installed AllocHooks and is counted against the subsystem of the thread
+     * making it: library threads are attributed to their subsystem (see Threads), other
+     * threads to "app" unless inside an AllocScope. Memory is credited back to the subsystem
+     * that allocated it, whichever thread frees it.
+     *
+     * In regular builds nothing is tracked, the functions below return empty results and
+     * the scopes do nothing.
+     */
+    namespace Alloc
+    {
+        /**
+         * Test if the library was built with allocation tracking.
+         */
+        LWSDK_API bool isEnabled();
+
+        /**
+         * Replaces the functions backing the allocator, e.g. to plug in a pool or a
+         * debugging allocator. Memory is always released by the hooks that allocated it,
+         * so hooks can be changed at any time.
+         */
+        LWSDK_API void setHooks( const AllocHooks& hooks );
+
+        /**
+         * Attributes allocations made by the calling thread from now on to the given
+         * subsystem. Called by ThreadScope for library threads.
+         */
+        LWSDK_API void setThreadSubsystem( const std::string& subsystem );
+
+        /**
+         * Returns the counters of every subsystem that allocated memory.
+         */
+        LWSDK_API std::vector<AllocStats> getStats();
+
+        /**
+         * Returns the number of allocations made by the calling thread so far.
+         */
+        LWSDK_API uint64_t threadAllocations();
+
+        /**
+         * realloc() style entry point to the tracked allocator, for C libraries taking
+         * custom allocators: a null ptr allocates, a zero size frees.
+         */
+        LWSDK_API void* reallocate( void *ptr, size_t size );
+    }
+
+
+    /**
+     * Attributes allocations made by the calling thread during its lifetime to a subsystem,
+     * restoring the previous one when destroyed.
+     */
+    class LWSDK_API AllocScope
+    {
+        int previous;
+
+    public:
+        explicit AllocScope( const std::string& subsystem );
+        ~AllocScope();
+
+        AllocScope( const AllocScope& ) = delete;
+        AllocScope& operator=( const AllocScope& ) = delete;
+    };
+
+
+    /**
+     * Asserts that the calling thread does not allocate during the scope's lifetime, for
+     * steady-state paths that are meant to be allocation free:
+     *
+     *        NoAllocScope noAlloc( "flushOutgoingMessages" );
+     *
+     * With abortOnAlloc set, the first allocation prints the scope's name to stderr and
+     * aborts the process, leaving a core dump pointing at the culprit; otherwise allocations
+     * are only counted, see allocations().
+     */
+    class LWSDK_API NoAllocScope
+    {
+        uint64_t    startCount;
+        const char *previousName;     // enclosing scope, restored on destruction
+        bool        previousAbort;
+
+    public:
+        explicit NoAllocScope( const char *name, bool abortOnAlloc = true );
+        ~NoAllocScope();
+
+        /**
+         * Returns the number of allocations made by the calling thread within the scope so far.
+         */
+        uint64_t allocations() const;
+
+        NoAllocScope( const NoAllocScope& ) = delete;
+        NoAllocScope& operator=( const NoAllocScope& ) = delete;
+    };
+
+}
+#endif //ALLOC_H
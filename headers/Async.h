@@ -0,0 +1,524 @@
+/********************************************************************************
+ *  This file is part of the lopezworks SDK utility library for C/C++ (lwsdk).
+ *
+ *  Copyright (C) 2015-2017 Edwin R. Lopez
+ *  http://www.lopezworks.info
+ *
+ *  This source code is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation LGPL v2.1
+ *  (http://www.gnu.org/licenses/).
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ *  02110-1301  USA.
+ ********************************************************************************/
+#ifndef ASYNC_H
+#define ASYNC_H
+
+#if !defined(__cpp_impl_coroutine)
+    #error "Async.h requires C++20 coroutine support (-std=c++20)"
+#endif
+
+#include <deque>
+#include <mutex>
+#include <memory>
+#include <string>
+#include <cstdio>
+#include <optional>
+#include <exception>
+#include <coroutine>
+#include "Exceptions.h"
+#include "Reactor.h"
+#include "SerialPort.h"
+#include "Webserver.h"
+
+/*
+ * C++20 coroutine front-end for the library's I/O primitives. Coroutines run on a
+ * single-threaded Reactor executor: they start, and resume after every co_await, in the
+ * reactor's thread, so request flows can be written sequentially without callbacks or
+ * thread hand-offs:
+ *
+ *     Task<> echo( AsyncSerialPort& port )
+ *     {
+ *         while ( auto line = co_await port.readLine() )
+ *         {
+ *             port.getPort().write( *line + "\n" );
+ *             co_await sleepFor( 10 );
+ *         }
+ *     }
+ *
+ *     spawn( reactor, echo( port ));
+ *
+ * This header is header-only and requires C++20; the rest of the library builds as C++17.
+ */
+namespace lwsdk
+{
+    template <typename T = void> class Task;
+
+    namespace detail
+    {
+        /**
+         * Promise state shared by Task<T> and Task<void>.
+         */
+        struct TaskPromiseBase
+        {
+            std::coroutine_handle<> continuation{nullptr};   // coroutine awaiting this task
+            std::exception_ptr error{nullptr};
+            bool detached{false};                            // started by spawn(), self-destroys
+
+            struct FinalAwaiter
+            {
+                bool await_ready() noexcept { return false; }
+                void await_resume() noexcept {}
+
+                template <typename P>
+                std::coroutine_handle<> await_suspend( std::coroutine_handle<P> handle ) noexcept
+                {
+                    TaskPromiseBase& promise = handle.promise();
+
+                    // Symmetric transfer back to the awaiting coroutine, no stack growth
+                    if ( promise.continuation )
+                        return promise.continuation;
+
+                    if ( promise.detached )
+                    {
+                        if ( promise.error )
+                        {
+                            try { std::rethrow_exception( promise.error ); }
+                            catch ( const std::exception& e ) { fprintf( stderr, "Spawned task finished with errors: %s\n", e.what() ); }
+                            catch ( ... ) { fprintf( stderr, "Spawned task finished with errors\n" ); }
+                        }
+
+                        handle.destroy();
+                    }
+
+                    return std::noop_coroutine();
+                }
+            };
+
+            std::suspend_always initial_suspend() noexcept { return {}; }
+            FinalAwaiter final_suspend() noexcept { return {}; }
+            void unhandled_exception() noexcept { error = std::current_exception(); }
+        };
+
+        template <typename T> struct TaskPromise : TaskPromiseBase
+        {
+            std::optional<T> value;
+
+            Task<T> get_return_object() noexcept;
+            void return_value( T v ) { value.emplace( std::move( v )); }
+        };
+
+        template <> struct TaskPromise<void> : TaskPromiseBase
+        {
+            Task<void> get_return_object() noexcept;
+            void return_void() noexcept {}
+        };
+    }
+
+
+    /**
+     * Lazily started coroutine producing a value of type T. A task starts running when
+     * it is co_await'ed by another coroutine, or when handed over to spawn().
+     * @tparam T Type of the value returned with co_return, void by default.
+     */
+    template <typename T> class Task
+    {
+    public:
+        using promise_type = detail::TaskPromise<T>;
+
+    private:
+        std::coroutine_handle<promise_type> handle;
+
+        template <typename U> friend struct detail::TaskPromise;
+        friend void spawn( Reactor& reactor, Task<void> task );
+
+        explicit Task( std::coroutine_handle<promise_type> handle ) noexcept : handle( handle ) {}
+
+    public:
+        Task( Task&& other ) noexcept : handle( other.handle ) { other.handle = nullptr; }
+
+        Task& operator=( Task&& other ) noexcept
+        {
+            if ( this != &other )
+            {
+                if ( handle )
+                    handle.destroy();
+
+                handle = other.handle;
+                other.handle = nullptr;
+            }
+
+            return *this;
+        }
+
+        Task( const Task& ) = delete;
+        Task& operator=( const Task& ) = delete;
+
+        ~Task()
+        {
+            if ( handle )
+                handle.destroy();
+        }
+
+        bool await_ready() const noexcept { return false; }
+
+        std::coroutine_handle<> await_suspend( std::coroutine_handle<> awaiting ) noexcept
+        {
+            handle.promise().continuation = awaiting;
+            return handle;
+        }
+
+        /**
+         * Returns the task's result, re-throwing any exception escaping the task.
+         */
+        T await_resume()
+        {
+            if ( handle.promise().error )
+                std::rethrow_exception( handle.promise().error );
+
+            if constexpr ( !std::is_void_v<T> )
+                return std::move( *handle.promise().value );
+        }
+    };
+
+    template <typename T> Task<T> detail::TaskPromise<T>::get_return_object() noexcept
+    {
+        return Task<T>( std::coroutine_handle<TaskPromise<T>>::from_promise( *this ));
+    }
+
+    inline Task<void> detail::TaskPromise<void>::get_return_object() noexcept
+    {
+        return Task<void>( std::coroutine_handle<TaskPromise<void>>::from_promise( *this ));
+    }
+
+
+    /**
+     * Starts a top-level task in the given reactor's thread. The task owns itself and is
+     * destroyed when it finishes; exceptions escaping the task are logged.
+     * This function can be called from any thread.
+     */
+    inline void spawn( Reactor& reactor, Task<void> task )
+    {
+        std::coroutine_handle<> handle = task.handle;
+        task.handle.promise().detached = true;
+        task.handle = nullptr;
+
+        reactor.post( [handle] { handle.resume(); } );
+    }
+
+
+    /**
+     * Returns the reactor running the calling coroutine.
+     * @throw RuntimeException if called outside a reactor thread.
+     */
+    inline Reactor& currentReactor()
+    {
+        Reactor *reactor = Reactor::current();
+        if ( reactor == nullptr )
+            throw RuntimeException( "Coroutine awaiting outside of a reactor thread" );
+
+        return *reactor;
+    }
+
+
+    /**
+     * Awaitable returned by sleepFor().
+     */
+    struct SleepAwaiter
+    {
+        uint32_t delayMs;
+
+        bool await_ready() const noexcept { return false; }
+        void await_resume() const noexcept {}
+
+        void await_suspend( std::coroutine_handle<> awaiting )
+        {
+            Reactor& reactor = currentReactor();
+
+            if ( delayMs == 0 )
+                reactor.post( [awaiting] { awaiting.resume(); } );
+            else
+                reactor.runAfter( delayMs, [awaiting] { awaiting.resume(); } );
+        }
+    };
+
+    /**
+     * Suspends the calling coroutine for the given number of milliseconds, using the
+     * reactor's timer wheel. co_await sleepFor(0) yields to other ready tasks.
+     */
+    inline SleepAwaiter sleepFor( uint32_t delayMs )
+    {
+        return SleepAwaiter{ delayMs };
+    }
+
+
+    /**
+     * Asynchronous queue feeding a coroutine. Items can be offered from any thread; the
+     * consumer co_awaits take() and is resumed in its reactor's thread as soon as an item
+     * is available, without blocking the reactor in the meantime.
+     *
+     * A channel supports a single awaiting consumer at a time.
+     *
+     * @tparam T Type of the data to exchange
+     */
+    template <typename T> class Channel
+    {
+        // Shared with the pending awaiters, so a consumer resumed after the channel is
+        // destroyed still finds it
+        struct State
+        {
+            std::mutex mtx;
+            std::deque<T> items;
+            int capacity{0};
+            bool closed{false};
+            std::coroutine_handle<> waiter{nullptr};
+            Reactor *waiterReactor{nullptr};
+
+            /**
+             * Wakes the waiting consumer, if any. Must be called with the lock held, the
+             * consumer is resumed later from the reactor's task queue.
+             */
+            void wakeWaiter()
+            {
+                if ( !waiter )
+                    return;
+
+                std::coroutine_handle<> handle = waiter;
+                waiter = nullptr;
+                waiterReactor->post( [handle] { handle.resume(); } );
+            }
+        };
+
+        std::shared_ptr<State> state;
+
+    public:
+        /**
+         * Awaitable returned by take().
+         */
+        struct TakeAwaiter
+        {
+            std::shared_ptr<State> state;
+
+            bool await_ready()
+            {
+                std::lock_guard lock( state->mtx );
+                return !state->items.empty() || state->closed;
+            }
+
+            bool await_suspend( std::coroutine_handle<> awaiting )
+            {
+                Reactor& reactor = currentReactor();
+                std::lock_guard lock( state->mtx );
+
+                // Item arrived in the meantime, don't suspend
+                if ( !state->items.empty() || state->closed )
+                    return false;
+
+                state->waiter = awaiting;
+                state->waiterReactor = &reactor;
+                return true;
+            }
+
+            std::optional<T> await_resume()
+            {
+                std::lock_guard lock( state->mtx );
+
+                if ( state->items.empty() )
+                    return std::nullopt;
+
+                std::optional<T> item( std::move( state->items.front() ));
+                state->items.pop_front();
+                return item;
+            }
+        };
+
+        /**
+         * Creates a channel.
+         * @param capacity Maximum number of items the channel can hold; 0 for unbounded.
+         */
+        explicit Channel( int capacity = 0 ) : state( std::make_shared<State>() )
+        {
+            state->capacity = capacity;
+        }
+
+        Channel( const Channel& ) = delete;
+        Channel& operator=( const Channel& ) = delete;
+
+        /**
+         * Adds an item to the end of the channel and wakes the consumer.
+         * This function can be called from any thread and never blocks.
+         * @return true if the item was added, false if the channel is full or closed.
+         */
+        bool offer( T item )
+        {
+            std::lock_guard lock( state->mtx );
+
+            if ( state->closed || (state->capacity > 0 && (int) state->items.size() >= state->capacity) )
+                return false;
+
+            state->items.push_back( std::move( item ));
+            state->wakeWaiter();
+            return true;
+        }
+
+        /**
+         * Awaits the next item. The awaited value is empty once the channel has been
+         * closed and drained.
+         *
+         *        while ( auto item = co_await channel.take() )
+         *            doSomething( *item );
+         */
+        TakeAwaiter take()
+        {
+            return TakeAwaiter{ state };
+        }
+
+        /**
+         * Closes the channel: further offers are rejected and the consumer receives an
+         * empty value once the remaining items are taken.
+         */
+        void close()
+        {
+            std::lock_guard lock( state->mtx );
+            state->closed = true;
+            state->wakeWaiter();
+        }
+
+        /**
+         * Return the current number of items in the channel.
+         */
+        int size()
+        {
+            std::lock_guard lock( state->mtx );
+            return (int) state->items.size();
+        }
+    };
+
+
+    /**
+     * Coroutine adapter for a SerialPort; lines received by the port are queued until
+     * read with co_await readLine(). The adapter takes over the port's line callback.
+     */
+    class AsyncSerialPort
+    {
+        SerialPort& port;
+        std::shared_ptr<Channel<std::string>> lines;   // shared with the line callback
+
+    public:
+        /**
+         * @param port      Serial port to read lines from; must outlive the adapter.
+         * @param capacity  Maximum number of unread lines to keep, 0 for unbounded.
+         *                  Lines received while full are dropped.
+         */
+        explicit AsyncSerialPort( SerialPort& port, int capacity = 0 ) :
+                port( port ), lines( std::make_shared<Channel<std::string>>( capacity ))
+        {
+            // The callback may still be running in the reader thread after the adapter is gone
+            port.setLineCallback( [lines = lines]( const std::string&, const std::string& line ) {
+                lines->offer( line );
+            });
+        }
+
+        virtual ~AsyncSerialPort()
+        {
+            port.setLineCallback( nullptr );
+            lines->close();
+        }
+
+        /**
+         * Awaits the next line of text; the awaited value is empty after close().
+         */
+        Channel<std::string>::TakeAwaiter readLine()
+        {
+            return lines->take();
+        }
+
+        /**
+         * Stops line delivery and wakes any coroutine waiting in readLine().
+         */
+        void close()
+        {
+            lines->close();
+        }
+
+        /**
+         * Returns the underlying serial port.
+         */
+        SerialPort& getPort()
+        {
+            return port;
+        }
+    };
+
+
+    /**
+     * Coroutine adapter for the Webserver's websocket messages; incoming messages are
+     * queued until read with co_await receive(). The adapter takes over the web server's
+     * message callback, only one adapter should exist at a time. It must be created
+     * before Webserver::start(), which only starts delivering messages if a callback is
+     * set by then.
+     */
+    class AsyncWebsocket
+    {
+        std::shared_ptr<Channel<Webserver::WSMessage>> messages;   // shared with the message callback
+
+    public:
+        /**
+         * @param capacity  Maximum number of unread messages to keep, 0 for unbounded.
+         *                  Messages received while full are dropped.
+         * @throw RuntimeException if the web server is already running.
+         */
+        explicit AsyncWebsocket( int capacity = 0 ) :
+                messages( std::make_shared<Channel<Webserver::WSMessage>>( capacity ))
+        {
+            if ( Webserver::isRunning() )
+                throw RuntimeException( "AsyncWebsocket must be created before the web server is started." );
+
+            // The callback may still be running in a dispatcher thread after the adapter is gone
+            Webserver::setMessageCallback( [messages = messages]( uint32_t connectionId, const std::string& message ) {
+                messages->offer( Webserver::WSMessage( connectionId, message ));
+            });
+        }
+
+        virtual ~AsyncWebsocket()
+        {
+            Webserver::setMessageCallback( nullptr );
+            messages->close();
+        }
+
+        /**
+         * Awaits the next websocket message; the awaited value is empty after close().
+         */
+        Channel<Webserver::WSMessage>::TakeAwaiter receive()
+        {
+            return messages->take();
+        }
+
+        /**
+         * Enqueue a message for delivery, see Webserver::sendMessage().
+         */
+        bool send( const std::string& message, uint32_t destId = 0 )
+        {
+            return Webserver::sendMessage( message, destId );
+        }
+
+        /**
+         * Stops message delivery and wakes any coroutine waiting in receive().
+         */
+        void close()
+        {
+            messages->close();
+        }
+    };
+
+} // namespace lwsdk
+
+#endif //ASYNC_H
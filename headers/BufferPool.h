@@ -0,0 +1,208 @@
+/********************************************************************************
+ *  This file is part of the lopezworks SDK utility library for C/C++ (lwsdk).
+ *
+ *  Copyright (C) 2015-2017 Edwin R. Lopez
+ *  http://www.lopezworks.info
+ *
+ *  This source code is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation LGPL v2.1
+ *  (http://www.gnu.org/licenses/).
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ *  02110-1301  USA.
+ ********************************************************************************/
+#ifndef BUFFERPOOL_H
+#define BUFFERPOOL_H
+
+#include <string>
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+#include <string_view>
+#include "Export.h"
+
+namespace lwsdk
+{
+    /**
+     * Memory block handed out by the buffer pool, the data bytes follow the header.
+     */
+    struct LWSDK_API BufferBlock
+    {
+        std::atomic<int> refs{1};
+        uint32_t capacity{0};   // usable data bytes
+        uint32_t length{0};     // data bytes in use
+        int      sizeClass{-1}; // pool size class, -1 if the block is too large to be pooled
+
+        char* data() { return reinterpret_cast<char*>( this + 1 ); }
+    };
+
+
+    class PooledBuffer;
+
+    namespace BufferPool
+    {
+        LWSDK_API PooledBuffer acquire( size_t capacity );
+    }
+
+
+    /**
+     * Reference-counted handle to a byte buffer drawn from the BufferPool. Copies share the
+     * same buffer; the buffer goes back to the pool when the last handle is destroyed, in
+     * whichever thread that happens.
+     *
+     * Handles can be passed between threads freely, but the buffer contents are not
+     * synchronized: fill the buffer first, then share it read-only.
+     */
+    class LWSDK_API PooledBuffer
+    {
+        BufferBlock *block{nullptr};
+
+        void grow( size_t minCapacity );
+
+        friend PooledBuffer BufferPool::acquire( size_t capacity );
+        explicit PooledBuffer( BufferBlock *block ) noexcept : block( block ) {}
+
+    public:
+        PooledBuffer() noexcept = default;
+        PooledBuffer( const PooledBuffer& other ) noexcept;
+        PooledBuffer( PooledBuffer&& other ) noexcept;
+        PooledBuffer& operator=( const PooledBuffer& other ) noexcept;
+        PooledBuffer& operator=( PooledBuffer&& other ) noexcept;
+        ~PooledBuffer();
+
+        /**
+         * Returns a pointer to the buffer data, null if the handle is empty.
+         */
+        char* data() { return block ? block->data() : nullptr; }
+        const char* data() const { return block ? block->data() : nullptr; }
+
+        /**
+         * Returns the number of data bytes in use.
+         */
+        size_t size() const { return block ? block->length : 0; }
+
+        /**
+         * Returns the number of bytes the buffer can hold without being reallocated.
+         */
+        size_t capacity() const { return block ? block->capacity : 0; }
+
+        /**
+         * Test if the buffer holds no data.
+         */
+        bool empty() const { return size() == 0; }
+
+        /**
+         * Test if the handle refers to a buffer (which may hold no data).
+         */
+        explicit operator bool() const { return block != nullptr; }
+
+        /**
+         * Returns the number of handles sharing this buffer, 0 for an empty handle.
+         */
+        int useCount() const { return block ? block->refs.load( std::memory_order_relaxed ) : 0; }
+
+        /**
+         * Sets the data size to 0, keeping the buffer.
+         */
+        void clear() { if ( block ) block->length = 0; }
+
+        /**
+         * Sets the data size, growing the buffer if needed. New bytes are left uninitialized.
+         */
+        void resize( size_t len );
+
+        /**
+         * Appends bytes at the end of the data, growing the buffer if needed.
+         */
+        void append( const void *bytes, size_t len );
+
+        /**
+         * Replaces the data with the given bytes.
+         */
+        void assign( const void *bytes, size_t len ) { clear(); append( bytes, len ); }
+
+        /**
+         * Returns a view of the data, valid while the buffer is alive and unmodified.
+         */
+        std::string_view view() const { return { data(), size() }; }
+
+        /**
+         * Returns a string copy of the data.
+         */
+        std::string str() const { return { data(), size() }; }
+
+        /**
+         * Drops this handle's reference to the buffer, leaving the handle empty.
+         */
+        void reset();
+    };
+
+
+    /**
+     * Buffer pool statistics.
+     */
+    struct LWSDK_API BufferPoolStats
+    {
+        uint64_t acquired{0};      // buffers handed out
+        uint64_t hits{0};          // buffers recycled from a thread cache or the shared lists
+        uint64_t misses{0};        // buffers newly allocated from the heap
+        uint64_t bytesHeld{0};     // bytes held in free lists, ready to be recycled
+        uint64_t bytesInUse{0};    // bytes held by live buffers
+
+        /**
+         * Returns the fraction of acquired buffers served without a heap allocation.
+         */
+        double hitRate() const { return acquired ? (double) hits / (double) acquired : 0.0; }
+    };
+
+
+    /**
+     * Size-class buffer pool. Buffers are rounded up to a power-of-two size class
+     * (64 bytes to 64 KB) and recycled through a small per-thread cache backed by shared
+     * per-class free lists, so buffers allocated in one thread and released in another
+     * don't go back to malloc. Larger buffers are allocated and freed directly.
+     */
+    namespace BufferPool
+    {
+        /**
+         * Returns an empty buffer able to hold at least the given number of bytes.
+         */
+        LWSDK_API PooledBuffer acquire( size_t capacity );
+
+        /**
+         * Returns a buffer holding a copy of the given bytes.
+         */
+        LWSDK_API PooledBuffer copyOf( const void *bytes, size_t len );
+
+        /**
+         * Returns a buffer holding a copy of the given string.
+         */
+        inline PooledBuffer copyOf( const std::string& s ) { return copyOf( s.data(), s.size() ); }
+
+        /**
+         * Limits the number of bytes kept in the shared free lists; buffers released beyond
+         * that limit are returned to the heap. Default is 16 MB.
+         */
+        LWSDK_API void setMaxBytesHeld( size_t maxBytes );
+
+        /**
+         * Frees all buffers in the shared free lists and the calling thread's cache.
+         */
+        LWSDK_API void trim();
+
+        /**
+         * Returns the pool statistics, aggregated over all threads.
+         */
+        LWSDK_API BufferPoolStats getStats();
+    }
+
+}
+#endif //BUFFERPOOL_H
@@ -0,0 +1,95 @@
+/********************************************************************************
+ *  This file is part of the lopezworks SDK utility library for C/C++ (lwsdk).
+ *
+ *  Copyright (C) 2015-2017 Edwin R. Lopez
+ *  http://www.lopezworks.info
+ *
+ *  This source code is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation LGPL v2.1
+ *  (http://www.gnu.org/licenses/).
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ *  02110-1301  USA.
+ ********************************************************************************/
+#ifndef CODECS_H
+#define CODECS_H
+
+#include <string_view>
+#include "Json.h"
+#include "Expected.h"
+#include "BufferPool.h"
+#include "Export.h"
+
+namespace lwsdk
+{
+    /**
+     * Wire encodings for Json::Value documents.
+     */
+    enum class Codec : uint8_t
+    {
+        Json,      // text, see Json.h
+        Cbor,      // RFC 8949
+        MsgPack    // https://msgpack.org
+    };
+
+    /**
+     * Appends the value in the given encoding to the buffer.
+     */
+    LWSDK_API void encode( Codec codec, const Json::Value& value, PooledBuffer& out );
+
+    /**
+     * Decodes a value in the given encoding.
+     * @return The value, or std::errc::invalid_argument if the data is malformed.
+     */
+    LWSDK_API Expected<Json::Value> decode( Codec codec, std::string_view data );
+}
+
+
+/**
+ * CBOR encoding of Json::Value documents. Byte strings are decoded as strings, tags are
+ * ignored, indefinite-length items are accepted; map keys must be text strings.
+ */
+namespace lwsdk::Cbor
+{
+    /**
+     * Appends the value encoded as CBOR to the buffer. Doubles are written as 32-bit
+     * floats when that is lossless.
+     */
+    LWSDK_API void encode( const Json::Value& value, PooledBuffer& out );
+
+    /**
+     * Decodes one CBOR data item spanning the whole input.
+     * @return The value, or std::errc::invalid_argument if the data is malformed.
+     */
+    LWSDK_API Expected<Json::Value> decode( std::string_view data );
+}
+
+
+/**
+ * MessagePack encoding of Json::Value documents. Binary items are decoded as strings;
+ * extension types are not supported. Map keys must be strings.
+ */
+namespace lwsdk::MsgPack
+{
+    /**
+     * Appends the value encoded as MessagePack to the buffer, using the smallest format
+     * for each integer, string and container length.
+     */
+    LWSDK_API void encode( const Json::Value& value, PooledBuffer& out );
+
+    /**
+     * Decodes one MessagePack object spanning the whole input.
+     * @return The value, or std::errc::invalid_argument if the data is malformed.
+     */
+    LWSDK_API Expected<Json::Value> decode( std::string_view data );
+}
+
+#endif //CODECS_H
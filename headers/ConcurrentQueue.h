@@ -29,6 +29,8 @@
 #include <optional>
 #include <utility>
 #include "Exceptions.h"
+#include "Expected.h"
+#include "Metrics.h"
 
 namespace lwsdk
 {
@@ -44,6 +46,11 @@ namespace lwsdk
         std::atomic_bool interrupted;
         int capacity;
 
+        Counter *offeredMetric{nullptr};
+        Counter *takenMetric{nullptr};
+        Counter *rejectedMetric{nullptr};
+        std::string metricsInstance;
+
     public:
         /**
          * Creates an unbounded queue that grows as needed.
@@ -59,6 +66,15 @@ namespace lwsdk
          */
         explicit ConcurrentQueue( int capacity ) noexcept;
 
+        virtual ~ConcurrentQueue();
+
+        /**
+         * Publishes the queue's activity in the Metrics registry under the "queue" subsystem:
+         * offered, taken and rejected item counters, and the current size.
+         * @param instance Name identifying this queue, e.g. "webserver_incoming".
+         */
+        void enableMetrics( const std::string& instance );
+
         /**
          * Wake all threads waiting on the queue. All sleeping threads waiting on the queue
          * will wake up via an InterruptedException. This functionality is typically used
@@ -93,6 +109,15 @@ namespace lwsdk
          */
         T take( bool remove = true );
 
+        /**
+         * Same as take() but does not throw: if interrupt() is called by another thread
+         * while waiting, an std::errc::interrupted error is returned instead.
+         *
+         * @param remove True removes the item, false leaves it in the queue.
+         * @return Item in the front of the queue (oldest), or the interrupted error.
+         */
+        Expected<T> tryTake( bool remove = true );
+
         /**
          * Returns the next item in the queue. If the queue is empty, the thread blocks
          * for the given number of *timeoutMsec* ms.
@@ -145,6 +170,15 @@ namespace lwsdk
          */
         void offer( T item );
 
+        /**
+         * Same as offer() but does not throw: if interrupt() is called by another thread
+         * while waiting for space, an std::errc::interrupted error is returned instead.
+         *
+         * @param item New value to add to the end of the queue.
+         * @return Empty result on success, or the interrupted error.
+         */
+        Expected<void> tryOffer( T item );
+
         /**
          * Puts a new item at the end of the queue. If the queue has reached its maximum capacity
          * (if any was specified), the thread blocks for the given number of timeoutMsec waiting
@@ -29,6 +29,23 @@ template <typename T> ConcurrentQueue<T>::ConcurrentQueue( int capacity ) noexce
 }
 
 
+template <typename T> ConcurrentQueue<T>::~ConcurrentQueue()
+{
+    if ( !metricsInstance.empty() )
+        Metrics::removeInstance( "queue", metricsInstance );
+}
+
+
+template <typename T> void ConcurrentQueue<T>::enableMetrics( const std::string& instance )
+{
+    offeredMetric = &Metrics::counter( "queue", "offered", instance, "Items added to the queue" );
+    takenMetric = &Metrics::counter( "queue", "taken", instance, "Items removed from the queue" );
+    rejectedMetric = &Metrics::counter( "queue", "rejected", instance, "Items not added because the queue was full" );
+    Metrics::gaugeFunction( "queue", "size", instance, [this] { return (double) size(); }, "Items in the queue" );
+    metricsInstance = instance;
+}
+
+
 template <typename T> void ConcurrentQueue<T>::interrupt()
 {
     std::lock_guard<std::mutex> lock(mtx);
@@ -53,6 +70,17 @@ template <typename T> int ConcurrentQueue<T>::size()
 
 
 template <typename T> T ConcurrentQueue<T>::take( bool remove )
+{
+    Expected<T> val = tryTake( remove );
+
+    if ( !val )
+        throw InterruptedException( "ConcurrentQueue take() interrupted." );
+
+    return std::move( *val );
+}
+
+
+template <typename T> Expected<T> ConcurrentQueue<T>::tryTake( bool remove )
 {
     std::unique_lock<std::mutex> ulock(mtx);
 
@@ -64,18 +92,21 @@ template <typename T> T ConcurrentQueue<T>::take( bool remove )
 
     // Test conditions after waking up
     if ( interrupted )
-    {
-        throw InterruptedException( "ConcurrentQueue take() interrupted." );
-    }
+        return std::errc::interrupted;
 
     // Pop value out of queue
     T val = items.front();
     if ( remove )
+    {
         items.pop_front();
 
+        if ( takenMetric )
+            takenMetric->inc();
+    }
+
     cv.notify_all();
 
-    return val;
+    return Expected<T>( std::move( val ));
 }
 
 
@@ -100,8 +131,13 @@ template<typename T> std::optional<T> ConcurrentQueue<T>::take( uint32_t timeout
     // Pop value out of queue
     T val = items.front();
     if ( remove )
+    {
         items.pop_front();
 
+        if ( takenMetric )
+            takenMetric->inc();
+    }
+
     cv.notify_all();
 
     return val;
@@ -132,8 +168,13 @@ template<typename T> T ConcurrentQueue<T>::take( uint32_t timeoutMsec, const T&
     // Pop value out of queue
     T val = items.front();
     if ( remove )
+    {
         items.pop_front();
 
+        if ( takenMetric )
+            takenMetric->inc();
+    }
+
     cv.notify_all();
 
     return val;
@@ -141,6 +182,13 @@ template<typename T> T ConcurrentQueue<T>::take( uint32_t timeoutMsec, const T&
 
 
 template <typename T> void ConcurrentQueue<T>::offer( T item )
+{
+    if ( !tryOffer( std::move( item )) )
+        throw InterruptedException( "ConcurrentQueue offer() interrupted." );
+}
+
+
+template <typename T> Expected<void> ConcurrentQueue<T>::tryOffer( T item )
 {
     std::unique_lock<std::mutex> ulock(mtx);
     interrupted = false;
@@ -153,13 +201,16 @@ template <typename T> void ConcurrentQueue<T>::offer( T item )
 
     // Test conditions after waking up
     if ( interrupted )
-    {
-        throw InterruptedException( "ConcurrentQueue offer() interrupted." );
-    }
+        return std::errc::interrupted;
 
     // Push value into queue
-    items.push_back( item );
+    items.push_back( std::move( item ));
     cv.notify_one();
+
+    if ( offeredMetric )
+        offeredMetric->inc();
+
+    return {};
 }
 
 
@@ -178,6 +229,9 @@ template <typename T> bool ConcurrentQueue<T>::offer( T item, uint32_t timeoutMs
     {
         //printf("    offer() --> %s \n", this->interrupted ? "INTERRUPTED" : "TIMEOUT" );
         //std::this_thread::yield();
+        if ( rejectedMetric )
+            rejectedMetric->inc();
+
         return false;
     }
 
@@ -186,6 +240,9 @@ template <typename T> bool ConcurrentQueue<T>::offer( T item, uint32_t timeoutMs
     items.push_back( item );
     cv.notify_one();
 
+    if ( offeredMetric )
+        offeredMetric->inc();
+
 
     return true;
 }
@@ -24,6 +24,7 @@
 
 #include <string>
 #include <utility>
+#include "Export.h"
 
 namespace lwsdk::Config
 {
@@ -32,12 +33,12 @@ namespace lwsdk::Config
     /**
      * Clear all loaded configuration and environmental values.
      */
-    void reset();
+    LWSDK_API void reset();
 
     /**
      * Clear all defined configuration options.
      */
-    void resetDefinitions();
+    LWSDK_API void resetDefinitions();
 
     /**
      * Defines optional configuration option for the application
@@ -47,7 +48,7 @@ namespace lwsdk::Config
      * @param defVal      default value if none is specified in config file or args
      * @param docstr      text description of this configuration option
      */
-    void defineConfigOption( ConfigOptionType type, const std::string &longName, const std::string &defVal, const std::string &docstr );
+    LWSDK_API void defineConfigOption( ConfigOptionType type, const std::string &longName, const std::string &defVal, const std::string &docstr );
 
 
     /**
@@ -57,7 +58,7 @@ namespace lwsdk::Config
      * @param longName    configuration long name, used in config file or args
      * @param docstr      text description of this configuration option
      */
-    void defineConfigOption( ConfigOptionType type, const std::string &longName, const std::string &docstr );
+    LWSDK_API void defineConfigOption( ConfigOptionType type, const std::string &longName, const std::string &docstr );
 
     /**
      * Defines optional configuration option for the application
@@ -68,7 +69,7 @@ namespace lwsdk::Config
      * @param defVal      default value if none is specified in config file or args
      * @param docstr      text description of this configuration option
      */
-    void defineConfigOption( ConfigOptionType type, char shortName, const std::string &longName, const std::string &defVal, const std::string &docstr );
+    LWSDK_API void defineConfigOption( ConfigOptionType type, char shortName, const std::string &longName, const std::string &defVal, const std::string &docstr );
 
     /**
      * Defines required configuration option for the application
@@ -78,13 +79,13 @@ namespace lwsdk::Config
      * @param longName    configuration long name, used in config file or args
      * @param docstr      text description of this configuration option
      */
-    void defineConfigOption( ConfigOptionType type, char shortName, const std::string &longName, const std::string &docstr );
+    LWSDK_API void defineConfigOption( ConfigOptionType type, char shortName, const std::string &longName, const std::string &docstr );
 
 
     /**
      * Load environment variables
      */
-    void loadConfigEnv( char **env );
+    LWSDK_API void loadConfigEnv( char **env );
 
     /**
      * Load configuration optionVars from the given pathname top a file.
@@ -97,7 +98,7 @@ namespace lwsdk::Config
      *
      * @throw IOException if an error occurs.
      */
-    std::string loadConfigFile( const std::string& pathname, bool useStrictCheck = false );
+    LWSDK_API std::string loadConfigFile( const std::string& pathname, bool useStrictCheck = false );
 
     /**
      * Load command line arguments
@@ -105,37 +106,37 @@ namespace lwsdk::Config
      * otherwise returns an error message. This function uses the rules provided
      * by defineConfigOption().
      */
-    std::string loadConfigArgs( int argc, char **argv, bool useStrictCheck = false );
+    LWSDK_API std::string loadConfigArgs( int argc, char **argv, bool useStrictCheck = false );
 
 
     /**
      * Return current's user name. This is derived from the $USER shell environment
      * variable.
      */
-    std::string getUser();
+    LWSDK_API std::string getUser();
 
     /**
      * Return the path to the current's user directory. This is derived from the
      * $HOME shell environment variable.
      */
-    std::string getUserHome();
+    LWSDK_API std::string getUserHome();
 
 
     /**
      * Returns the absolute path to the current program
      */
-    std::string getProgram();
+    LWSDK_API std::string getProgram();
 
     /**
      * Returns the path to the directory containing the current program
      */
-    std::string getProgramDir();
+    LWSDK_API std::string getProgramDir();
 
     /**
      * Return the number of floating arguments given to the program.
      * This excludes named arguments -x or --xyz and their respective values.
      */
-    int getArgCount();
+    LWSDK_API int getArgCount();
 
     /**
      * Return floating argument at given position. Note named arguments such as
@@ -152,7 +153,7 @@ namespace lwsdk::Config
      * @param pos A number from 0 to getArgsCount()-1. Any other value will
      *            return defVal. Pos=0 refers to the program's name.
      */
-    std::string getArg( int pos, const std::string& defVal = "" );
+    LWSDK_API std::string getArg( int pos, const std::string& defVal = "" );
 
 
     /**
@@ -160,47 +161,47 @@ namespace lwsdk::Config
      * "true", "enable[d]", "y", "yes", or "1" (case insensitive),
      * otherwise returns false.
      */
-    bool getArgBool( int pos );
+    LWSDK_API bool getArgBool( int pos );
 
     /**
      * Returns the argument at the given position converted to int. If the argument
      * cannot be converted, or the given position is out of range, default value is
      * returned.
      */
-    int getArgInt( int pos, int defVal );
+    LWSDK_API int getArgInt( int pos, int defVal );
 
     /**
      * Returns the argument at the given position converted to long. If the argument
      * cannot be converted, or the given position is out of range, default value is
      * returned.
      */
-    long getArgLong( int pos, long defVal );
+    LWSDK_API long getArgLong( int pos, long defVal );
 
     /**
      * Returns the argument at the given position converted to double. If the argument
      * cannot be converted, or the given position is out of range, default value is
      * returned.
      */
-    double getArgDouble( int pos, double defVal );
+    LWSDK_API double getArgDouble( int pos, double defVal );
 
 
     /**
      * Test if the configuration has an option with the given name.
      */
-    bool hasOption( const std::string& name );
+    LWSDK_API bool hasOption( const std::string& name );
 
     /**
      * Removes the given property name from the configuration.
      * Returns true if the property was found and removed, false if the
      * property was not found.
      */
-    bool remove( const std::string& name );
+    LWSDK_API bool remove( const std::string& name );
 
     /**
      * Returns the value for the given property name. If the property
      * value does not exist, the given default value is returned.
      */
-    std::string get( const std::string& name, const std::string& defVal = "" );
+    LWSDK_API std::string get( const std::string& name, const std::string& defVal = "" );
 
 
     /**
@@ -208,51 +209,51 @@ namespace lwsdk::Config
      * "true", "enable[d]", "y", "yes", or "1" (case insensitive),
      * otherwise returns false.
      */
-    bool getBool( const std::string& name );
+    LWSDK_API bool getBool( const std::string& name );
 
     /**
      * Returns the value for the given property name converted to int. If the property
      * value does not exist or cannot be converted, the given default value is returned.
      */
-    int getInt( const std::string& name, int defVal );
+    LWSDK_API int getInt( const std::string& name, int defVal );
 
     /**
      * Returns the value for the given property name converted to long. If the property
      * value does not exist or cannot be converted, the given default value is returned.
      */
-    long getLong( const std::string& name, long defVal );
+    LWSDK_API long getLong( const std::string& name, long defVal );
 
     /**
      * Returns the value for the given property name converted to double. If the property
      * value does not exist or cannot be converted, the given default value is returned.
      */
-    double getDouble( const std::string& name, double defVal ) ;
+    LWSDK_API double getDouble( const std::string& name, double defVal ) ;
 
 
     /**
      * Sets or overwrite the value of the given property name.
      */
-    void set( const std::string& name, const std::string& value );
+    LWSDK_API void set( const std::string& name, const std::string& value );
 
     /**
      * Sets or overwrite the value of the given property name.
      */
-    void setBool( const std::string& name, bool value );
+    LWSDK_API void setBool( const std::string& name, bool value );
 
     /**
      * Sets or overwrite the value of the given property name.
      */
-    void setInt( const std::string& name, int value );
+    LWSDK_API void setInt( const std::string& name, int value );
 
     /**
      * Sets or overwrite the value of the given property name.
      */
-    void setLong ( const std::string& name, long value );
+    LWSDK_API void setLong ( const std::string& name, long value );
 
     /**
      * Sets or overwrite the value of the given property name.
      */
-    void setDouble( const std::string& name, double value );
+    LWSDK_API void setDouble( const std::string& name, double value );
 
 
 
@@ -260,18 +261,18 @@ namespace lwsdk::Config
     /**
      * Returns all property names stored in this configuration
      */
-    std::vector<std::string> getNames( bool includeEnvVars = true );
+    LWSDK_API std::vector<std::string> getNames( bool includeEnvVars = true );
 
     /**
      * Returns the configuration variables as a multiline string
      */
-    std::string toString( bool includeEnvVars = true );
+    LWSDK_API std::string toString( bool includeEnvVars = true );
 
 
     /**
      * Returns usage help based on defined options
      */
-    std::string getOptionsHelp();
+    LWSDK_API std::string getOptionsHelp();
     
 } // ns
 
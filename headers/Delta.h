@@ -0,0 +1,75 @@
+/********************************************************************************
+ *  This file is part of the lopezworks SDK utility library for C/C++ (lwsdk).
+ *
+ *  Copyright (C) 2015-2017 Edwin R. Lopez
+ *  http://www.lopezworks.info
+ *
+ *  This source code is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation LGPL v2.1
+ *  (http://www.gnu.org/licenses/).
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ *  02110-1301  USA.
+ ********************************************************************************/
+#ifndef DELTA_H
+#define DELTA_H
+
+#include <string>
+#include <cstdint>
+#include <string_view>
+#include "BufferPool.h"
+#include "Export.h"
+
+/**
+ * Binary block-diff encoding, used to send a new version of a large document as the
+ * difference from a version the receiver already has.
+ *
+ * A delta is a sequence of operations building the target from the base; integers are
+ * 32-bit big-endian:
+ *
+ *   0x01 offset length    copy length bytes from the base, starting at offset
+ *   0x02 length bytes     insert the given bytes
+ */
+namespace lwsdk::Delta
+{
+    /**
+     * Encodes target as a delta from base, appending it to out. Unchanged runs of at
+     * least 32 bytes are found wherever they moved to in the target.
+     *
+     * @param maxSize  The encoding is abandoned once the delta grows beyond this size.
+     * @return true if the delta was appended, false if it would exceed maxSize, in which
+     *         case out holds a partial delta to be discarded.
+     */
+    LWSDK_API bool encode( std::string_view base, std::string_view target, PooledBuffer& out,
+                           size_t maxSize = SIZE_MAX );
+
+    /**
+     * Rebuilds the target from a base and a delta created by encode().
+     * @return true on success, false if the delta is malformed or does not fit the base.
+     */
+    LWSDK_API bool apply( std::string_view base, std::string_view delta, std::string& out );
+
+    /**
+     * Appends a 32-bit big-endian integer to the buffer.
+     */
+    LWSDK_API void put32( PooledBuffer& out, uint32_t n );
+
+    /**
+     * Reads a 32-bit big-endian integer.
+     */
+    inline uint32_t get32( const void *p )
+    {
+        auto *b = (const unsigned char *) p;
+        return ((uint32_t) b[0] << 24) | ((uint32_t) b[1] << 16) | ((uint32_t) b[2] << 8) | b[3];
+    }
+}
+
+#endif //DELTA_H
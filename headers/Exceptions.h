@@ -22,37 +22,151 @@
 #ifndef EXCEPTIONS_H
 #define EXCEPTIONS_H
 
+#include <cerrno>
 #include <exception>
 #include <string>
+#include <system_error>
+#include "Export.h"
 
 namespace lwsdk
 {
-    class InterruptedException : public std::exception
+    /**
+     * Source code location where an exception was thrown, captured by default arguments
+     * so the throwing code does not need to spell it out.
+     */
+    struct LWSDK_API SourceLocation
+    {
+        const char *file{""};
+        const char *function{""};
+        int         line{0};
+
+        static constexpr SourceLocation current( const char *file = __builtin_FILE(),
+                                                 const char *function = __builtin_FUNCTION(),
+                                                 int line = __builtin_LINE() ) noexcept
+        {
+            return SourceLocation{ file, function, line };
+        }
+    };
+
+
+    /**
+     * Returns the calling thread's errno value as an error code.
+     */
+    inline std::error_code errnoCode( int err = errno ) noexcept
+    {
+        return std::error_code( err, std::generic_category() );
+    }
+
+
+    /**
+     * Base of all lwsdk exceptions. An exception carries a message, an optional error code
+     * and the location it was thrown from.
+     *
+     * Exceptions created from a string literal keep just a pointer to it, so throwing them
+     * does not allocate; the full text reported by what() is formatted the first time it is
+     * requested:
+     *
+     *        throw RuntimeException( "Failed to create eventfd", errnoCode() );
+     *
+     *        what() --> "Reactor() - Failed to create eventfd: Too many open files"
+     *
+     * Exceptions created from a std::string report it as-is in what().
+     */
+    class LWSDK_API Exception : public std::exception
+    {
+        const char          *message;        // static message, or null if cause holds it
+        std::string         cause;           // dynamic message, or lazily formatted text
+        std::error_code     errorCode;
+        SourceLocation      location;
+        mutable std::string formatted;       // what() text, built on first call
+
+    public:
+        /**
+         * Creates an exception with a static message.
+         * @param message   Message with static storage duration, typically a string literal.
+         * @param errorCode Optional error code detailing the failure, e.g. errnoCode().
+         * @param location  Location the exception is thrown from, filled in by default.
+         */
+        explicit Exception( const char *message, std::error_code errorCode = {},
+                            SourceLocation location = SourceLocation::current() ) noexcept :
+                message( message ), errorCode( errorCode ), location( location ) {}
+
+        /**
+         * Creates an exception with a formatted message, reported as-is by what().
+         */
+        explicit Exception( std::string cause, SourceLocation location = SourceLocation::current() ) :
+                message( nullptr ), cause( std::move( cause )), location( location ) {}
+
+        /**
+         * Returns the exception's message, without location or error code.
+         */
+        const char *getMessage() const noexcept { return message != nullptr ? message : cause.c_str(); }
+
+        /**
+         * Returns the error code given when the exception was created, 0 if none.
+         */
+        const std::error_code& code() const noexcept { return errorCode; }
+
+        /**
+         * Returns the location the exception was thrown from.
+         */
+        const SourceLocation& where() const noexcept { return location; }
+
+        /**
+         * Returns the full exception text: for static messages, the throwing function,
+         * the message and the error code description, if any.
+         */
+        const char *what() const noexcept override
+        {
+            if ( message == nullptr )
+                return cause.c_str();
+
+            if ( !formatted.empty() )
+                return formatted.c_str();
+
+            try
+            {
+                formatted.append( location.function ).append( "() - " ).append( message );
+
+                if ( errorCode )
+                    formatted.append( ": " ).append( errorCode.message() );
+
+                return formatted.c_str();
+            }
+            catch ( ... )
+            {
+                return message;   // out of memory, no formatting
+            }
+        }
+    };
+
+
+    class LWSDK_API InterruptedException : public Exception
     {
-        std::string cause;
     public:
-        explicit InterruptedException( std::string cause = "InterruptedException" ) : cause( std::move( cause )) {}
-        virtual const char *what() const noexcept { return cause.c_str(); }
+        using Exception::Exception;
+        explicit InterruptedException( SourceLocation location = SourceLocation::current() ) noexcept :
+                Exception( "InterruptedException", {}, location ) {}
     };
 
 
 
-    class IOException : public std::exception
+    class LWSDK_API IOException : public Exception
     {
-        std::string cause;
     public:
-        explicit IOException( std::string cause = "IOException" ) : cause(std::move( cause )) {}
-        virtual const char *what() const noexcept { return cause.c_str(); }
+        using Exception::Exception;
+        explicit IOException( SourceLocation location = SourceLocation::current() ) noexcept :
+                Exception( "IOException", {}, location ) {}
     };
 
 
 
-    class RuntimeException : public std::exception
+    class LWSDK_API RuntimeException : public Exception
     {
-        std::string cause;
     public:
-        explicit RuntimeException( std::string cause = "RuntimeException" ) : cause(std::move( cause )) {}
-        virtual const char *what() const noexcept { return cause.c_str(); }
+        using Exception::Exception;
+        explicit RuntimeException( SourceLocation location = SourceLocation::current() ) noexcept :
+                Exception( "RuntimeException", {}, location ) {}
     };
 
 } // namespace lwsdk
@@ -0,0 +1,137 @@
+/********************************************************************************
+ *  This file is part of the lopezworks SDK utility library for C/C++ (lwsdk).
+ *
+ *  Copyright (C) 2015-2017 Edwin R. Lopez
+ *  http://www.lopezworks.info
+ *
+ *  This source code is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation LGPL v2.1
+ *  (http://www.gnu.org/licenses/).
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ *  02110-1301  USA.
+ ********************************************************************************/
+#ifndef EXPECTED_H
+#define EXPECTED_H
+
+#include <optional>
+#include <utility>
+#include <system_error>
+#include "Exceptions.h"
+
+namespace lwsdk
+{
+    /**
+     * Result of an operation that may fail: holds either a value or the error code
+     * explaining why there is none. Returned by the non-throwing variants of the library
+     * functions (tryTake(), tryParseInt(), tryCopy(), etc.), so failures that are part of
+     * normal operation are not paid for with an exception.
+     *
+     * Example:
+     *
+     *        auto n = Strings::tryParseInt( s );
+     *        if ( n )
+     *            doSomething( *n );
+     *        else
+     *            logw( "Invalid number: %s", n.error().message().c_str() );
+     *
+     * @tparam T Type of the value; use Expected<void> for operations without a result.
+     */
+    template <typename T> class Expected
+    {
+        std::optional<T> val;
+        std::error_code  err;
+
+    public:
+        Expected( const T& value ) : val( value ) {}
+        Expected( T&& value ) : val( std::move( value )) {}
+
+        /**
+         * Creates a failed result. The error code must not be 0.
+         */
+        Expected( std::error_code error ) : err( error ) {}
+        Expected( std::errc error ) : err( std::make_error_code( error )) {}
+
+        /**
+         * Test if the operation succeeded.
+         */
+        bool hasValue() const noexcept { return val.has_value(); }
+        explicit operator bool() const noexcept { return val.has_value(); }
+
+        /**
+         * Returns the error code of a failed operation, a 0 error code if it succeeded.
+         */
+        const std::error_code& error() const noexcept { return err; }
+
+        /**
+         * Returns the value of a successful operation.
+         * @param location  Location reported by the exception, filled in by default.
+         * @throw RuntimeException if the operation failed.
+         */
+        T& value( SourceLocation location = SourceLocation::current() ) &
+        {
+            if ( !val )
+                throw RuntimeException( "Expected value() of a failed operation", err, location );
+
+            return *val;
+        }
+
+        const T& value( SourceLocation location = SourceLocation::current() ) const &
+        {
+            if ( !val )
+                throw RuntimeException( "Expected value() of a failed operation", err, location );
+
+            return *val;
+        }
+
+        T&& value( SourceLocation location = SourceLocation::current() ) &&
+        {
+            if ( !val )
+                throw RuntimeException( "Expected value() of a failed operation", err, location );
+
+            return std::move( *val );
+        }
+
+        /**
+         * Returns the value of a successful operation, or defVal if it failed.
+         */
+        T valueOr( T defVal ) const & { return val ? *val : std::move( defVal ); }
+        T valueOr( T defVal ) && { return val ? std::move( *val ) : std::move( defVal ); }
+
+        // Unchecked access, the operation must have succeeded
+        T& operator*() & noexcept { return *val; }
+        const T& operator*() const & noexcept { return *val; }
+        T&& operator*() && noexcept { return std::move( *val ); }
+        T* operator->() noexcept { return &*val; }
+        const T* operator->() const noexcept { return &*val; }
+    };
+
+
+    /**
+     * Result of an operation that may fail and has no value.
+     */
+    template <> class Expected<void>
+    {
+        std::error_code err;
+
+    public:
+        Expected() = default;
+        Expected( std::error_code error ) : err( error ) {}
+        Expected( std::errc error ) : err( std::make_error_code( error )) {}
+
+        bool hasValue() const noexcept { return !err; }
+        explicit operator bool() const noexcept { return !err; }
+        const std::error_code& error() const noexcept { return err; }
+    };
+
+} // namespace lwsdk
+
+#endif //EXPECTED_H
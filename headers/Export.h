@@ -0,0 +1,37 @@
+/********************************************************************************
+ *  This file is part of the lopezworks SDK utility library for C/C++ (lwsdk).
+ *
+ *  Copyright (C) 2015-2017 Edwin R. Lopez
+ *  http://www.lopezworks.info
+ *
+ *  This source code is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation LGPL v2.1
+ *  (http://www.gnu.org/licenses/).
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ *  02110-1301  USA.
+ ********************************************************************************/
+#ifndef EXPORT_H
+#define EXPORT_H
+
+/**
+ * Marks the library's public API. When lwsdk is built as a shared library, everything
+ * else is compiled with hidden visibility, so only the symbols marked with LWSDK_API are
+ * exported: calls within the library bind directly instead of through the PLT, and the
+ * dynamic symbol table stays small.
+ */
+#if defined(__GNUC__)
+    #define LWSDK_API __attribute__(( visibility( "default" ) ))
+#else
+    #define LWSDK_API
+#endif
+
+#endif //EXPORT_H
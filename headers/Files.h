@@ -23,7 +23,9 @@
 #define FILES_H
 
 #include "Strings.h"
+#include "Expected.h"
 #include <filesystem>
+#include "Export.h"
 
 namespace lwsdk::Files
 {
@@ -67,7 +69,13 @@ namespace lwsdk::Files
      * @param toPathname   Destination file or folder, overwriting existing
      * @throw IOException if the operation fails.
      */
-    void copy( const std::string& fromPathname, const std::string& toPathname );
+    LWSDK_API void copy( const std::string& fromPathname, const std::string& toPathname );
+
+    /**
+     * Same as copy() but does not throw.
+     * @return Empty result on success, the std::filesystem error code otherwise.
+     */
+    LWSDK_API Expected<void> tryCopy( const std::string& fromPathname, const std::string& toPathname );
 
     /**
      * Renames or move a file or directory as in mv.
@@ -75,7 +83,13 @@ namespace lwsdk::Files
      * @param toPathname   New name or location
      * @throw IOException if the operation fails.
      */
-    void move( const std::string& fromPathname, const std::string& toPathname );
+    LWSDK_API void move( const std::string& fromPathname, const std::string& toPathname );
+
+    /**
+     * Same as move() but does not throw.
+     * @return Empty result on success, the std::filesystem error code otherwise.
+     */
+    LWSDK_API Expected<void> tryMove( const std::string& fromPathname, const std::string& toPathname );
 
     /**
      * Alias for move. Renames or move a file or directory as in mv.
@@ -96,26 +110,44 @@ namespace lwsdk::Files
      * @return Number of files or directories removed.
      * @throw IOException if the operation fails.
      */
-    uintmax_t remove( const std::string& pathname );
+    LWSDK_API uintmax_t remove( const std::string& pathname );
+
+    /**
+     * Same as remove() but does not throw.
+     * @return Number of files or directories removed, or the std::filesystem error code.
+     */
+    LWSDK_API Expected<uintmax_t> tryRemove( const std::string& pathname );
 
     /**
      * Returns the path of the current directory
      */
-    std::string getCurrentDir(); 
+    LWSDK_API std::string getCurrentDir(); 
 
     /**
      * Change the program's current directory as in chdir.
      * @param pathname     Path to new directory
      * @throw IOException if the operation fails.
      */
-    void changeDir( const std::string& pathname );
+    LWSDK_API void changeDir( const std::string& pathname );
+
+    /**
+     * Same as changeDir() but does not throw.
+     * @return Empty result on success, the std::filesystem error code otherwise.
+     */
+    LWSDK_API Expected<void> tryChangeDir( const std::string& pathname );
 
     /**
      * Creates one or more parent/child directories as in makeDir -p.
      * @param pathname Directory structure to be created
      * @throw IOException if the operation fails.
      */
-    void makeDir( const std::string& pathname );
+    LWSDK_API void makeDir( const std::string& pathname );
+
+    /**
+     * Same as makeDir() but does not throw.
+     * @return Empty result on success, the std::filesystem error code otherwise.
+     */
+    LWSDK_API Expected<void> tryMakeDir( const std::string& pathname );
 
 
     /**
@@ -123,28 +155,28 @@ namespace lwsdk::Files
      * @param pathname Path to the file or directory to be tested.
      * @return True if the file or directory exist, false otherwise.
      */
-    bool exists( const std::string& pathname );
+    LWSDK_API bool exists( const std::string& pathname );
 
     /**
      * Test if the pathname points to a directory.
      * @param pathname Path to directory to be tested.
      * @return True if the path exist and it is a directory exist, false otherwise.
      */
-    bool isDir( const std::string& pathname );
+    LWSDK_API bool isDir( const std::string& pathname );
 
     /**
      * Test if the pathname points to a File.
      * @param pathname Path to file to be tested.
      * @return True if the path exist and it is a file exist, false otherwise.
      */
-    bool isFile( const std::string& pathname );
+    LWSDK_API bool isFile( const std::string& pathname );
 
     /**
      * Test if the pathname points to a symlink.
      * @param pathname Path to file to be tested.
      * @return True if the path exist and it is a symlink exist, false otherwise.
      */
-    bool isSymlink( const std::string& pathname );
+    LWSDK_API bool isSymlink( const std::string& pathname );
 
     /**
      * Returns the file size of the given pathname.
@@ -152,7 +184,13 @@ namespace lwsdk::Files
      * @return file size of the given pathname.
      * @throw IOException if the operation fails.
      */
-    uintmax_t getFileSize( const std::string& pathname );
+    LWSDK_API uintmax_t getFileSize( const std::string& pathname );
+
+    /**
+     * Same as getFileSize() but does not throw.
+     * @return File size of the given pathname, or the std::filesystem error code.
+     */
+    LWSDK_API Expected<uintmax_t> tryGetFileSize( const std::string& pathname );
 
     /**
      * Returns the epoch milliseconds of the file's last update.
@@ -160,7 +198,13 @@ namespace lwsdk::Files
      * @return epoch milliseconds of the file's last update.
      * @throw IOException if the operation fails.
      */
-    long getLastUpdated( const std::string& pathname );
+    LWSDK_API long getLastUpdated( const std::string& pathname );
+
+    /**
+     * Same as getLastUpdated() but does not throw.
+     * @return Epoch milliseconds of the file's last update, or the std::filesystem error code.
+     */
+    LWSDK_API Expected<long> tryGetLastUpdated( const std::string& pathname );
 
 
     /**
@@ -168,14 +212,14 @@ namespace lwsdk::Files
      * @param t  File time from a directory_entry
      * @return   Time converted to UNIX epoch milliseconds
      */
-    long fileTimeToMillis( std::filesystem::file_time_type const &fileTime );
+    LWSDK_API long fileTimeToMillis( std::filesystem::file_time_type const &fileTime );
 
 
     /**
      * Copies data from IN stream into OUT stream until the end of the IN stream
      * is reached. Throws IOException if the operation fails.
      */
-    void streamCopy( std::istream& in, std::ostream& out );
+    LWSDK_API void streamCopy( std::istream& in, std::ostream& out );
 
 } // ns
 
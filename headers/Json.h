@@ -0,0 +1,209 @@
+/********************************************************************************
+ *  This file is part of the lopezworks SDK utility library for C/C++ (lwsdk).
+ *
+ *  Copyright (C) 2015-2017 Edwin R. Lopez
+ *  http://www.lopezworks.info
+ *
+ *  This source code is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation LGPL v2.1
+ *  (http://www.gnu.org/licenses/).
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ *  02110-1301  USA.
+ ********************************************************************************/
+#ifndef JSON_H
+#define JSON_H
+
+#include <string>
+#include <vector>
+#include <variant>
+#include <utility>
+#include <cstdint>
+#include <string_view>
+#include "Expected.h"
+#include "BufferPool.h"
+#include "Export.h"
+
+namespace lwsdk::Json
+{
+    /**
+     * Type of a JSON value. Integers are kept apart from floating point numbers, so they
+     * round-trip exactly through the binary codecs in Codecs.h.
+     */
+    enum class Type { Null, Bool, Int, Double, String, Array, Object };
+
+    class Value;
+
+    /**
+     * Members of an object, in document order.
+     */
+    typedef std::vector<std::pair<std::string, Value>> Members;
+
+    /**
+     * Elements of an array.
+     */
+    typedef std::vector<Value> Elements;
+
+
+    /**
+     * JSON document node.
+     */
+    class LWSDK_API Value
+    {
+        std::variant<std::nullptr_t, bool, int64_t, double, std::string, Elements, Members> v;
+
+    public:
+        Value() : v( nullptr ) {}
+        Value( std::nullptr_t ) : v( nullptr ) {}
+        Value( bool b ) : v( b ) {}
+        Value( int n ) : v( (int64_t) n ) {}
+        Value( int64_t n ) : v( n ) {}
+        Value( uint32_t n ) : v( (int64_t) n ) {}
+        Value( double d ) : v( d ) {}
+        Value( const char *s ) : v( std::string( s )) {}
+        Value( std::string s ) : v( std::move( s )) {}
+        Value( std::string_view s ) : v( std::string( s )) {}
+        Value( Elements elements ) : v( std::move( elements )) {}
+        Value( Members members ) : v( std::move( members )) {}
+
+        /**
+         * Returns an empty array value.
+         */
+        static Value array() { return Value( Elements() ); }
+
+        /**
+         * Returns an empty object value.
+         */
+        static Value object() { return Value( Members() ); }
+
+        Type type() const { return (Type) v.index(); }
+
+        bool isNull() const   { return type() == Type::Null; }
+        bool isBool() const   { return type() == Type::Bool; }
+        bool isInt() const    { return type() == Type::Int; }
+        bool isNumber() const { return type() == Type::Int || type() == Type::Double; }
+        bool isString() const { return type() == Type::String; }
+        bool isArray() const  { return type() == Type::Array; }
+        bool isObject() const { return type() == Type::Object; }
+
+        /**
+         * Typed accessors.
+         * @throw RuntimeException if the value is of a different type; numbers convert
+         *        between integer and floating point.
+         */
+        bool asBool() const;
+        int64_t asInt() const;
+        double asDouble() const;
+        const std::string& asString() const;
+        const Elements& elements() const;
+        Elements& elements();
+        const Members& members() const;
+        Members& members();
+
+        /**
+         * Returns the number of elements or members, 0 for other types.
+         */
+        size_t size() const;
+
+        /**
+         * Returns the member with the given key, null if missing or not an object.
+         */
+        const Value* find( std::string_view key ) const;
+
+        /**
+         * Returns the member with the given key, or a null value if missing.
+         */
+        const Value& operator[]( std::string_view key ) const;
+
+        /**
+         * Returns the member with the given key, adding it if missing. A null value
+         * becomes an object first.
+         * @throw RuntimeException if the value is not an object.
+         */
+        Value& operator[]( std::string_view key );
+
+        /**
+         * Returns the element at the given index.
+         * @throw RuntimeException if the value is not an array or the index is out of range.
+         */
+        const Value& operator[]( size_t index ) const;
+        Value& operator[]( size_t index );
+
+        /**
+         * Appends an element. A null value becomes an array first.
+         * @throw RuntimeException if the value is not an array.
+         */
+        Value& push( Value value );
+
+        bool operator==( const Value& other ) const { return v == other.v; }
+        bool operator!=( const Value& other ) const { return v != other.v; }
+    };
+
+
+    /**
+     * Streaming JSON writer, appends to a pooled buffer without building a document.
+     * Commas are inserted as needed:
+     *
+     *   Json::Writer w( buf );
+     *   w.beginObject().key( "id" ).value( 42 ).key( "tags" ).beginArray().value( "a" ).endArray().endObject();
+     */
+    class LWSDK_API Writer
+    {
+        PooledBuffer& out;
+        bool first{true};      // next item is the first of its container
+        bool afterKey{false};  // next item is an object member's value
+
+        void separate();
+
+    public:
+        explicit Writer( PooledBuffer& out ) : out( out ) {}
+
+        Writer& beginObject();
+        Writer& endObject();
+        Writer& beginArray();
+        Writer& endArray();
+        Writer& key( std::string_view key );
+
+        Writer& value( std::nullptr_t );
+        Writer& value( bool b );
+        Writer& value( int n ) { return value( (int64_t) n ); }
+        Writer& value( int64_t n );
+        Writer& value( double d );
+        Writer& value( const char *s ) { return value( std::string_view( s )); }
+        Writer& value( std::string_view s );
+        Writer& value( const Value& value );
+
+        /**
+         * Appends pre-encoded JSON as the next value.
+         */
+        Writer& raw( std::string_view json );
+    };
+
+
+    /**
+     * Parses a JSON document. Strings are scanned 8 bytes at a time.
+     * @return The document's root value, or std::errc::invalid_argument if the text is not
+     *         valid JSON (std::errc::value_too_large if nested deeper than 512 levels).
+     */
+    LWSDK_API Expected<Value> parse( std::string_view json );
+
+    /**
+     * Appends the value encoded as compact JSON to the buffer.
+     */
+    LWSDK_API void write( const Value& value, PooledBuffer& out );
+
+    /**
+     * Returns the value encoded as compact JSON.
+     */
+    LWSDK_API std::string toString( const Value& value );
+}
+
+#endif //JSON_H
@@ -0,0 +1,295 @@
+/********************************************************************************
+ *  This file is part of the lopezworks SDK utility library for C/C++ (lwsdk).
+ *
+ *  Copyright (C) 2015-2017 Edwin R. Lopez
+ *  http://www.lopezworks.info
+ *
+ *  This source code is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation LGPL v2.1
+ *  (http://www.gnu.org/licenses/).
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ *  02110-1301  USA.
+ ********************************************************************************/
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <string>
+#include <atomic>
+#include <memory>
+#include <vector>
+#include <cstdint>
+#include <functional>
+#include <sched.h>
+#include <time.h>
+#include "Export.h"
+
+namespace lwsdk
+{
+    namespace MetricsDetail
+    {
+        // Cache line size, to keep shards written by different CPUs apart
+        constexpr int CACHE_LINE = 64;
+
+        /**
+         * Returns the shard to use for the calling thread, the CPU it runs on.
+         */
+        inline unsigned currentShard( unsigned shardMask )
+        {
+            int cpu = sched_getcpu();
+            return (unsigned) (cpu < 0 ? 0 : cpu) & shardMask;
+        }
+
+        /**
+         * Returns the number of shards per metric: the CPU count rounded up to a power of two.
+         */
+        LWSDK_API unsigned shardCount();
+    }
+
+
+    /**
+     * Monotonic counter sharded per CPU: increments touch only the current CPU's cache line,
+     * value() adds up all shards.
+     */
+    class LWSDK_API Counter
+    {
+        struct alignas( MetricsDetail::CACHE_LINE ) Shard
+        {
+            std::atomic<uint64_t> value{0};
+        };
+
+        std::unique_ptr<Shard[]> shards;
+        unsigned shardMask;
+
+    public:
+        Counter();
+
+        /**
+         * Adds n to the counter.
+         */
+        void inc( uint64_t n = 1 )
+        {
+            shards[ MetricsDetail::currentShard( shardMask ) ].value.fetch_add( n, std::memory_order_relaxed );
+        }
+
+        /**
+         * Returns the current counter value.
+         */
+        uint64_t value() const;
+    };
+
+
+    /**
+     * Value that can go up and down: queue depth, open connections, etc.
+     */
+    class LWSDK_API Gauge
+    {
+        std::atomic<int64_t> current{0};
+
+    public:
+        void set( int64_t v ) { current.store( v, std::memory_order_relaxed ); }
+        void add( int64_t n ) { current.fetch_add( n, std::memory_order_relaxed ); }
+        void inc() { add( 1 ); }
+        void dec() { add( -1 ); }
+        int64_t value() const { return current.load( std::memory_order_relaxed ); }
+    };
+
+
+    /**
+     * Merged view of a histogram's recorded values.
+     */
+    struct LWSDK_API HistogramSnapshot
+    {
+        uint64_t count{0};
+        uint64_t sum{0};
+        uint64_t min{0};
+        uint64_t max{0};
+        std::vector<uint64_t> buckets;   // count per bucket, see Histogram::bucketLowerBound()
+
+        double mean() const { return count ? (double) sum / (double) count : 0.0; }
+
+        /**
+         * Returns the value at the given quantile (0..1), e.g. 0.99 for the 99th percentile.
+         * The result is the upper bound of the bucket holding it, so it is over-estimated by
+         * at most 1/16 (6.25%).
+         */
+        uint64_t quantile( double q ) const;
+    };
+
+
+    /**
+     * Log-linear histogram in the style of HdrHistogram: every power-of-two range is split
+     * into 16 linear sub-buckets, so recorded values keep a relative precision of 6.25%
+     * over the whole 0..2^48 range with a fixed set of 720 buckets. Values are typically
+     * latencies in nanoseconds or sizes in bytes. Shards are per CPU, like Counter.
+     */
+    class LWSDK_API Histogram
+    {
+    public:
+        static constexpr int SUB_BITS = 4;
+        static constexpr int SUB_BUCKETS = 1 << SUB_BITS;
+        static constexpr int MAX_BITS = 48;
+        static constexpr int BUCKETS = (MAX_BITS - SUB_BITS + 1) * SUB_BUCKETS;
+
+    private:
+        struct alignas( MetricsDetail::CACHE_LINE ) Shard
+        {
+            std::atomic<uint64_t> count{0};
+            std::atomic<uint64_t> sum{0};
+            std::atomic<uint64_t> buckets[ BUCKETS ]{};
+        };
+
+        std::unique_ptr<Shard[]> shards;
+        unsigned shardMask;
+
+    public:
+        Histogram();
+
+        /**
+         * Returns the bucket index for the given value.
+         */
+        static int bucketOf( uint64_t v )
+        {
+            if ( v < SUB_BUCKETS )
+                return (int) v;
+
+            int msb = 63 - __builtin_clzll( v );
+            if ( msb >= MAX_BITS )
+                return BUCKETS - 1;
+
+            int shift = msb - SUB_BITS;
+            return (shift + 1) * SUB_BUCKETS + (int) ((v >> shift) & (SUB_BUCKETS - 1));
+        }
+
+        /**
+         * Returns the smallest value falling in the given bucket.
+         */
+        static uint64_t bucketLowerBound( int bucket );
+
+        /**
+         * Returns the largest value falling in the given bucket.
+         */
+        static uint64_t bucketUpperBound( int bucket );
+
+        /**
+         * Records a value.
+         */
+        void record( uint64_t v )
+        {
+            Shard& shard = shards[ MetricsDetail::currentShard( shardMask ) ];
+            shard.buckets[ bucketOf( v ) ].fetch_add( 1, std::memory_order_relaxed );
+            shard.count.fetch_add( 1, std::memory_order_relaxed );
+            shard.sum.fetch_add( v, std::memory_order_relaxed );
+        }
+
+        /**
+         * Returns the merged contents of all shards.
+         */
+        HistogramSnapshot snapshot() const;
+    };
+
+
+    /**
+     * Records the lifetime of the scope in nanoseconds into a histogram. Does nothing if the
+     * histogram is null, so instrumentation can be compiled in and enabled on demand.
+     */
+    class LWSDK_API ScopedTimer
+    {
+        Histogram *histogram;
+        uint64_t start{0};
+
+    public:
+        static uint64_t nowNanos()
+        {
+            struct timespec ts;
+            clock_gettime( CLOCK_MONOTONIC, &ts );
+            return (uint64_t) ts.tv_sec * 1000000000ull + (uint64_t) ts.tv_nsec;
+        }
+
+        explicit ScopedTimer( Histogram *histogram ) : histogram( histogram )
+        {
+            if ( histogram != nullptr )
+                start = nowNanos();
+        }
+
+        ~ScopedTimer()
+        {
+            if ( histogram != nullptr )
+                histogram->record( nowNanos() - start );
+        }
+
+        ScopedTimer( const ScopedTimer& ) = delete;
+        ScopedTimer& operator=( const ScopedTimer& ) = delete;
+    };
+
+
+    /**
+     * Process-wide metrics registry. Metrics are identified by subsystem, name and instance,
+     * e.g. ("serialport", "rx_bytes", "/dev/ttyUSB0"), and exported as
+     * lwsdk_serialport_rx_bytes{instance="/dev/ttyUSB0"}.
+     *
+     * Registering is slow (takes a lock) and meant to be done once at setup; the returned
+     * references stay valid for the life of the process, and updating them is lock-free.
+     */
+    namespace Metrics
+    {
+        /**
+         * Returns the counter with the given identity, creating it if needed.
+         * @throw RuntimeException if a metric of another type already uses the identity.
+         */
+        LWSDK_API Counter& counter( const std::string& subsystem, const std::string& name,
+                          const std::string& instance = "", const std::string& help = "" );
+
+        /**
+         * Returns the gauge with the given identity, creating it if needed.
+         * @throw RuntimeException if a metric of another type already uses the identity.
+         */
+        LWSDK_API Gauge& gauge( const std::string& subsystem, const std::string& name,
+                      const std::string& instance = "", const std::string& help = "" );
+
+        /**
+         * Returns the histogram with the given identity, creating it if needed.
+         * @throw RuntimeException if a metric of another type already uses the identity.
+         */
+        LWSDK_API Histogram& histogram( const std::string& subsystem, const std::string& name,
+                              const std::string& instance = "", const std::string& help = "" );
+
+        /**
+         * Registers a gauge whose value is sampled by calling the given function at export
+         * time, e.g. a queue's size(). Replaces any previous sampler with the same identity.
+         * The function must stay callable until removed with removeInstance(), and must not
+         * call into the registry.
+         */
+        LWSDK_API void gaugeFunction( const std::string& subsystem, const std::string& name,
+                            const std::string& instance, const std::function<double()>& sampler,
+                            const std::string& help = "" );
+
+        /**
+         * Removes the gauge functions registered for the given subsystem instance, typically
+         * called from the instance's destructor. Counters, gauges and histograms are kept so
+         * references held elsewhere remain valid.
+         */
+        LWSDK_API void removeInstance( const std::string& subsystem, const std::string& instance );
+
+        /**
+         * Returns a snapshot of all metrics in Prometheus text exposition format.
+         * Histograms are exported as summaries with 0.5, 0.9, 0.99 and 0.999 quantiles.
+         */
+        LWSDK_API std::string toPrometheus();
+
+        /**
+         * Returns a snapshot of all metrics as a JSON array.
+         */
+        LWSDK_API std::string toJson();
+    }
+
+}
+#endif //METRICS_H
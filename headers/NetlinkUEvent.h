@@ -27,16 +27,20 @@
 #include <atomic>
 #include <functional>
 #include "Exceptions.h"
+#include "Export.h"
 
 namespace lwsdk
 {
+    class Reactor;
+    class ThreadPool;
+
     // Size of the buffer to receive uevent data from kernel
     #define NETLINK_UEVENT_BUF_SZ 4096
 
     /**
      *  Hold UEvent data send from kernel.
      */
-    struct UEvent
+    struct LWSDK_API UEvent
     {
         const std::string data;  // name=value multiline event's data
 
@@ -74,14 +78,19 @@ namespace lwsdk
      * Used to subscribe to kernel hot-plug events. Typical use include
      * detecting when USB devices are plugged/unplugged.
      */
-    class NetlinkUEvent
+    class LWSDK_API NetlinkUEvent
     {
         UEventCallback_t  uEventCallback{nullptr};
         std::atomic_bool  keepWorking{false};
         std::thread       *uEventReaderThread{nullptr};
+        Reactor           *reactor{nullptr};
+        ThreadPool        *threadPool{nullptr};
+        int               reactorSocketfd{-1};
+        int               wakefd{-1};
         char              buf[ NETLINK_UEVENT_BUF_SZ ]{0};
 
         void readerThread();
+        void readEvent( int socketfd );
 
     public:
         /**
@@ -92,8 +101,26 @@ namespace lwsdk
          */
         explicit NetlinkUEvent( const UEventCallback_t& uEventCallback );
 
+        /**
+         * Establishes a connection to the kernel's hot-plug event stream serviced by
+         * the given reactor instead of a dedicated reader thread. The callback is invoked
+         * in the reactor's thread; the reactor must outlive this object.
+         *
+         * @param uEventCallback
+         * @param reactor
+         */
+        NetlinkUEvent( const UEventCallback_t& uEventCallback, Reactor& reactor );
+
         virtual ~NetlinkUEvent();
 
+        /**
+         * Runs the user callback through the given thread pool instead of the reader
+         * thread. Note that events may then be handled concurrently and out of order.
+         * @param pool  Thread pool to use, or null to call the callback from the reader
+         *              thread (default). The pool must outlive this object.
+         */
+        void setThreadPool( ThreadPool *pool );
+
     };
 
 }
@@ -0,0 +1,178 @@
+/********************************************************************************
+ *  This file is part of the lopezworks SDK utility library for C/C++ (lwsdk).
+ *
+ *  Copyright (C) 2015-2017 Edwin R. Lopez
+ *  http://www.lopezworks.info
+ *
+ *  This source code is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation LGPL v2.1
+ *  (http://www.gnu.org/licenses/).
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ *  02110-1301  USA.
+ ********************************************************************************/
+#ifndef REACTOR_H
+#define REACTOR_H
+
+#include <map>
+#include <deque>
+#include <mutex>
+#include <memory>
+#include <thread>
+#include <atomic>
+#include <functional>
+#include <sys/epoll.h>
+#include "Timers.h"
+#include "Export.h"
+
+namespace lwsdk
+{
+    /**
+     * User callback invoked by the reactor when a watched file descriptor is ready.
+     * @param events  Ready events reported by epoll: EPOLLIN, EPOLLOUT, EPOLLHUP, EPOLLERR, etc.
+     */
+    typedef std::function<void( uint32_t events )> ReactorHandler_t;
+
+    /**
+     * User task to be executed in the reactor's thread.
+     */
+    typedef std::function<void()> ReactorTask_t;
+
+
+    /**
+     * Single-threaded event loop built on epoll, an eventfd for cross-thread wakeups and
+     * a Timers wheel for timed tasks. The SerialPort, NetlinkUEvent, Terminal and
+     * Webserver subsystems can optionally attach to a reactor instead of running their
+     * own threads, allowing a whole process to be serviced from one or two threads.
+     *
+     * All handlers, tasks and timers run in the thread calling run() (or the thread
+     * created by start()); they must not block.
+     */
+    class LWSDK_API Reactor
+    {
+        int epollfd{-1};
+        int wakefd{-1};
+
+        std::mutex mtx;
+        std::map<int, std::shared_ptr<ReactorHandler_t>> handlers;
+        std::deque<ReactorTask_t> tasks;
+        Timers timers;
+
+        std::atomic_bool keepWorking{false};
+        std::atomic<std::thread::id> loopThreadId{};
+        std::thread *reactorThread{nullptr};
+
+        void wakeup();
+        void runTasks();
+        void loop();
+
+    public:
+        /**
+         * Creates the epoll, eventfd and timer wheel instances backing the reactor.
+         * @throw RuntimeException if the kernel objects cannot be created.
+         */
+        Reactor();
+
+        virtual ~Reactor();
+
+        Reactor( const Reactor& ) = delete;
+        Reactor& operator=( const Reactor& ) = delete;
+
+        /**
+         * Adds a file descriptor to the watch list.
+         * @param fd       File descriptor to watch
+         * @param events   epoll events to watch for: EPOLLIN, EPOLLOUT, etc.
+         * @param handler  Callback invoked in the reactor thread when the fd is ready.
+         * @return true on success, false if the fd could not be added.
+         */
+        bool add( int fd, uint32_t events, const ReactorHandler_t& handler );
+
+        /**
+         * Changes the events watched on a file descriptor previously added.
+         * @return true on success, false otherwise.
+         */
+        bool modify( int fd, uint32_t events );
+
+        /**
+         * Removes a file descriptor from the watch list. The caller still owns the fd
+         * and must close it after calling this function.
+         * @return true if the fd was found and removed, false otherwise.
+         */
+        bool remove( int fd );
+
+        /**
+         * Queues a task for execution in the reactor thread and wakes the reactor up.
+         * This function can be called from any thread.
+         */
+        void post( const ReactorTask_t& task );
+
+        /**
+         * Schedules a task to run in the reactor thread after the given delay.
+         * @param delayMs   Milliseconds to wait before running the task
+         * @param task      Task to run
+         * @param periodMs  If greater than 0, the task is re-run every periodMs until cancelled.
+         * @return Timer ID, used to cancel the timer.
+         */
+        uint64_t runAfter( uint32_t delayMs, const ReactorTask_t& task, uint32_t periodMs = 0 );
+
+        /**
+         * Cancels a timer created by runAfter().
+         * @return true if the timer was found and cancelled, false otherwise.
+         */
+        bool cancel( uint64_t timerId );
+
+        /**
+         * Returns the timer wheel serviced by this reactor.
+         */
+        Timers& getTimers();
+
+        /**
+         * Runs the event loop in the calling thread until stop() is called.
+         */
+        void run();
+
+        /**
+         * Waits up to timeoutMsec for events and dispatches them.
+         * @param timeoutMsec Maximum time to wait; 0 polls, -1 waits indefinitely.
+         * @return Number of file descriptor events dispatched, -1 on error.
+         */
+        int runOnce( int timeoutMsec );
+
+        /**
+         * Runs the event loop in a new thread. Does nothing if the reactor is already running.
+         */
+        void start();
+
+        /**
+         * Signals the event loop to exit; if the loop was started with start(),
+         * waits for its thread to finish, unless called from the loop's own thread.
+         */
+        void stop();
+
+        /**
+         * Test if the event loop is running.
+         */
+        bool isRunning();
+
+        /**
+         * Test if the calling thread is the one running the event loop.
+         */
+        bool isReactorThread();
+
+        /**
+         * Returns the reactor dispatching handlers, tasks and timers in the calling thread,
+         * or null if the calling thread is not running a reactor.
+         */
+        static Reactor* current();
+    };
+
+}
+#endif //REACTOR_H
@@ -27,11 +27,17 @@
 #include <thread>
 #include <functional>
 #include <atomic>
+#include <memory>
 
 #include <termios.h>  // for baud rate constants B115200, B921600, etc..
+#include "Export.h"
 
 namespace lwsdk
 {
+    class Reactor;
+    class ThreadPool;
+    class Counter;
+
     /**
      * User callback to receive serial port open/close events.
      * @param portName    Port name the text line originates from
@@ -61,9 +67,12 @@ namespace lwsdk
             SPDataCallback_t;
 
 
-    class SerialPort
+    class LWSDK_API SerialPort
     {
+        struct CallbackQueue;
+
         int portfd{-1};
+        int wakefd{-1};
         int baudRate{115200};
         bool useParity{false};
         bool use2StopBits{false};
@@ -79,13 +88,34 @@ namespace lwsdk
         std::atomic_bool  keepWorking{false};
         std::atomic_bool  isConnected{false};
         std::thread *portReaderThread{nullptr};
+        Reactor *reactor{nullptr};
+        ThreadPool *threadPool{nullptr};
+        Counter *rxBytesMetric{nullptr};
+        Counter *txBytesMetric{nullptr};
+        Counter *rxLinesMetric{nullptr};
+        std::shared_ptr<CallbackQueue> callbackQueue;  // pool callbacks pending, in order
+        std::string line;
         //std::mutex mtx;
         //std::stringstream inputStream;
-        void readerThread();
+        void readerThread( const std::string& threadName );
+        void readerEvent( uint32_t events );
+        void wakeup();
+        void processInput( const char *buf, size_t len );
+        void deliver( std::function<void()> task );
+        static void drainCallbacks( const std::shared_ptr<CallbackQueue>& queue );
+        bool isPortRemoved();
+        bool closePort();
         
     public:
         SerialPort();
 
+        /**
+         * Creates a serial port serviced by the given reactor instead of a dedicated
+         * reader thread. All callbacks are invoked in the reactor's thread; the reactor
+         * must outlive the serial port.
+         */
+        explicit SerialPort( Reactor& reactor );
+
         virtual ~SerialPort();
 
         /**
@@ -158,7 +188,18 @@ namespace lwsdk
         void setLineCallback( const SPLineCallback_t& lineCallback );
 
         /**
-         * Opens the serial port with the current configuration.
+         * Runs the user data and line callbacks through the given thread pool instead of
+         * the reader thread. Callbacks still run one at a time, in the order the data was
+         * received.
+         * @param pool  Thread pool to use, or null to call the callbacks from the reader
+         *              thread (default). The pool must outlive the serial port.
+         */
+        void setThreadPool( ThreadPool *pool );
+
+        /**
+         * Opens the serial port with the current configuration. The port's traffic is
+         * published in the Metrics registry under the "serialport" subsystem, using the
+         * port name as instance.
          * @return true on success, false otherwise; use getError() to determine the cause.
          */
         bool open();
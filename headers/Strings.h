@@ -26,29 +26,32 @@
 #include <vector>
 #include <regex>
 #include <string>
+#include <string_view>
+#include "Expected.h"
+#include "Export.h"
 
 namespace lwsdk::Strings
 {
     /**
      * Lowercases s string
      */
-    std::string toLowerCase( const std::string &s );
+    LWSDK_API std::string toLowerCase( const std::string &s );
 
     /**
      * Uppercases a string
      */
-    std::string toUpperCase( const std::string &s );
+    LWSDK_API std::string toUpperCase( const std::string &s );
 
     /**
      * Return the given multi-line string indented by N number of spaces
      */
-    std::string indent( const std::string& s, int n );
+    LWSDK_API std::string indent( const std::string& s, int n );
 
 
     /**
      * Return the given string repeated back to back N number of times.
      */
-    std::string repeat( const std::string& s, int n );
+    LWSDK_API std::string repeat( const std::string& s, int n );
 
 
     /**
@@ -56,122 +59,159 @@ namespace lwsdk::Strings
      * Throws IOException if the operation fails.
      * Lines larger than 8192 characters will be truncated.
      */
-    std::vector<std::string> getFileAsLines( const std::string& pathname );
+    LWSDK_API std::vector<std::string> getFileAsLines( const std::string& pathname );
 
 
     /**
      * Reads a whole text file and returns it as a multi-line string.
      * Throws IOException if the operation fails.
      */
-    std::string getFileAsString( const std::string& pathname );
+    LWSDK_API std::string getFileAsString( const std::string& pathname );
 
 
     /**
      * Saves the given string s to a file pointed by pathname.
      * Throws IOException if the operation fails.
      */
-    void saveStringAsFile( const std::string& s, const std::string& pathname );
+    LWSDK_API void saveStringAsFile( const std::string& s, const std::string& pathname );
 
     /**
      * Returns true is the given string is either "true", "enable[d]", "y", "yes",
      * or "1" (case insensitive), otherwise returns false.
      * Any leading/trailing spaces are ignored.
      */
-    bool parseBool( const std::string& s );
+    LWSDK_API bool parseBool( const std::string& s );
 
     /**
      * Converts the given string to int, returns defVal if the conversion fails.
      * Attempts to convert values up to the first non-valid character found.
      */
-    int parseInt( const std::string& s, const int& defVal );
+    LWSDK_API int parseInt( const std::string& s, const int& defVal );
 
     /**
      * Converts the given string to long, returns defVal if the conversion fails.
      * Attempts to convert values up to the first non-valid character found.
      */
-    long parseLong( const std::string& s, const long& defVal );
+    LWSDK_API long parseLong( const std::string& s, const long& defVal );
 
     /**
      * Converts the given hex string to long, returns defVal if the conversion fails.
      * Attempts to convert values up to the first non-valid character found.
      * If present, the 0x prefix is ignored.
      */
-    long parseHex( const std::string& s, const long& defVal );
+    LWSDK_API long parseHex( const std::string& s, const long& defVal );
 
     /**
      * Converts the given string to double, returns defVal if the conversion fails.
      * Attempts to convert values up to the first non-valid character found.
      */
-    double parseDouble( const std::string& s, const double& defVal );
+    LWSDK_API double parseDouble( const std::string& s, const double& defVal );
+
+    /**
+     * Converts the given string to int, following the same rules as parseInt() but
+     * without a default value. No exceptions are thrown or caught in the process.
+     * @return The converted value, or an std::errc::invalid_argument error if the string
+     *         holds no number, std::errc::result_out_of_range if it does not fit an int.
+     */
+    LWSDK_API Expected<int> tryParseInt( const std::string& s );
+
+    /**
+     * Converts the given string to long, as tryParseInt() does.
+     */
+    LWSDK_API Expected<long> tryParseLong( const std::string& s );
+
+    /**
+     * Converts the given hex string to long, as tryParseInt() does. If present, the
+     * 0x prefix is ignored.
+     */
+    LWSDK_API Expected<long> tryParseHex( const std::string& s );
+
+    /**
+     * Converts the given string to double, as tryParseInt() does.
+     */
+    LWSDK_API Expected<double> tryParseDouble( const std::string& s );
 
     /**
      * Returns true if the given string starts with the given prefix
      */
-    bool startsWith( const std::string& s, const std::string& prefix );
+    constexpr bool startsWith( std::string_view s, std::string_view prefix ) noexcept
+    {
+        return s.size() >= prefix.size() && s.compare( 0, prefix.size(), prefix ) == 0;
+    }
 
     /**
      * Returns true if the given string ends with the given suffix
      */
-    bool endsWith( const std::string& s, const std::string& suffix );
+    constexpr bool endsWith( std::string_view s, std::string_view suffix ) noexcept
+    {
+        return s.size() >= suffix.size() && s.compare( s.size() - suffix.size(), suffix.size(), suffix ) == 0;
+    }
 
     /**
      * Do a find and replace in the given string and returns the result
      * The replacement string accepts $1, $2, etc.. for captured groups in find string
      */
-    std::string replaceAll( const std::string& s, const std::string& sFindRegex, const std::string& sReplace, bool isCaseSensitive = true );
+    LWSDK_API std::string replaceAll( const std::string& s, const std::string& sFindRegex, const std::string& sReplace, bool isCaseSensitive = true );
 
     /**
      * Returns the first substring matching the provided regular expression; or a blank
      * string if no match is found.
      */
-    std::string findMatch( const std::string& s, const std::string& sRegex, bool isCaseSensitive = true );
+    LWSDK_API std::string findMatch( const std::string& s, const std::string& sRegex, bool isCaseSensitive = true );
 
     /**
      * Returns true if the given string matches the provided regular expression
      */
-    bool matches( const std::string& s, const std::string& sRegex, bool isCaseSensitive = true );
+    LWSDK_API bool matches( const std::string& s, const std::string& sRegex, bool isCaseSensitive = true );
 
     /**
      * Returns true if the given string contains a substring matching the provided
      * regular expression.
      */
-    bool contains( const std::string& s, const std::string& sRegex, bool isCaseSensitive = true );
+    LWSDK_API bool contains( const std::string& s, const std::string& sRegex, bool isCaseSensitive = true );
 
     /**
      * Splits a string by the given regex delimiter expression.
      */
-    std::vector<std::string> split( const std::string& s, const std::regex& delimRegex );
+    LWSDK_API std::vector<std::string> split( const std::string& s, const std::regex& delimRegex );
 
     /**
      * Splits a string by the given regex delimiter expression.
      */
-    std::vector<std::string> split( const std::string& s, const std::string& delimRegex );
+    LWSDK_API std::vector<std::string> split( const std::string& s, const std::string& delimRegex );
 
     /*
      * Return substrings matching the given regex expression.
      */
-    std::vector<std::string> findMatches( const std::string& s, const std::string& matchRegex );
+    LWSDK_API std::vector<std::string> findMatches( const std::string& s, const std::string& matchRegex );
 
     /**
      * Trim blank spaces at the begin of the string
      */
-    std::string ltrim( const std::string &s );
+    LWSDK_API std::string ltrim( const std::string &s );
 
     /**
      * Trim blank spaces at the end of the string
      */
-    std::string rtrim( const std::string &s );
+    LWSDK_API std::string rtrim( const std::string &s );
 
     /**
      * Trim blank spaces at each end of the string
      */
-    std::string trim( const std::string &s );
+    LWSDK_API std::string trim( const std::string &s );
 
     /**
      * Return true if the given string is empty or only
      * contains blank spaces [' ' \t \n \r \f \v ].
      */
-    bool isEmpty( const std::string &s );
+    constexpr bool isEmpty( std::string_view s ) noexcept
+    {
+        for ( char c : s )
+            if ( c != ' ' && (c < '\t' || c > '\r') )
+                return false;
+
+        return true;
+    }
 
 
 }
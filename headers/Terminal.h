@@ -22,13 +22,42 @@
 #ifndef TERMINAL_H
 #define TERMINAL_H
 
+#include <functional>
+#include "Export.h"
+
+namespace lwsdk
+{
+    class Reactor;
+}
 
 namespace lwsdk::Terminal
 {
+    /**
+     * User callback to receive key strokes.
+     * @param key  Character read from the terminal
+     */
+    typedef std::function<void( char key )> KeyCallback_t;
+
     /**
      * Returns true if a key has been pressed, false otherwise
      */
-    bool kbhit();
+    LWSDK_API bool kbhit();
+
+    /**
+     * Watches the terminal's standard input with the given reactor and delivers key
+     * strokes to the user callback in the reactor's thread, as an alternative to
+     * polling kbhit().
+     *
+     * @param reactor      Reactor servicing the standard input
+     * @param keyCallback  Pointer to user-defined function
+     * @return true on success, false if stdin could not be added to the reactor.
+     */
+    LWSDK_API bool attach( Reactor& reactor, const KeyCallback_t& keyCallback );
+
+    /**
+     * Stops watching the terminal's standard input with the given reactor.
+     */
+    LWSDK_API void detach( Reactor& reactor );
 
 
 } // ns
@@ -0,0 +1,132 @@
+/********************************************************************************
+ *  This file is part of the lopezworks SDK utility library for C/C++ (lwsdk).
+ *
+ *  Copyright (C) 2015-2017 Edwin R. Lopez
+ *  http://www.lopezworks.info
+ *
+ *  This source code is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation LGPL v2.1
+ *  (http://www.gnu.org/licenses/).
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ *  02110-1301  USA.
+ ********************************************************************************/
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+
+#include <deque>
+#include <mutex>
+#include <vector>
+#include <memory>
+#include <thread>
+#include <atomic>
+#include <functional>
+#include <condition_variable>
+#include "Export.h"
+
+namespace lwsdk
+{
+    /**
+     * Task to be executed by a thread pool worker.
+     */
+    typedef std::function<void()> PoolTask_t;
+
+    /**
+     * Task priorities; higher priority tasks are always picked up first, from any worker.
+     */
+    enum TaskPriority { PRIORITY_HIGH, PRIORITY_NORMAL, PRIORITY_LOW };
+
+
+    /**
+     * Work-stealing thread pool. Each worker owns a deque per priority; tasks submitted
+     * from a worker go to its own deque and are run LIFO for cache locality, while idle
+     * workers steal the oldest tasks from their peers. Tasks submitted from other threads
+     * go to a shared queue and are run FIFO, so they cannot be starved by newer ones.
+     *
+     * Tasks submitted to the pool may run concurrently and in any order.
+     */
+    class LWSDK_API ThreadPool
+    {
+        struct Worker
+        {
+            std::mutex mtx;
+            std::deque<PoolTask_t> tasks[ PRIORITY_LOW + 1 ];
+            std::thread *thread{nullptr};
+            uint32_t picks{0};                               // tasks picked, see runNext()
+        };
+
+        std::vector<std::unique_ptr<Worker>> workers;
+        std::mutex injectedMtx;
+        std::deque<PoolTask_t> injected[ PRIORITY_LOW + 1 ];  // tasks submitted from outside the pool, oldest first
+        std::vector<int> cpus;
+        std::mutex mtx;
+        std::condition_variable cv;
+        std::condition_variable drainedCv;
+        std::atomic_int  pending{0};
+        std::atomic_bool keepWorking{false};
+
+        void workerThread( int index );
+        bool takeInjected( int priority, PoolTask_t& task );
+        bool runNext( int index );
+
+    public:
+        /**
+         * Creates the pool and starts its worker threads.
+         *
+         * @param threadCount  Number of workers; 0 uses one worker per CPU core.
+         * @param cpus         Optional CPU ids to pin the workers to; worker N is pinned to
+         *                     cpus[N % cpus.size()]. Empty to let the workers float.
+         */
+        explicit ThreadPool( int threadCount = 0, const std::vector<int>& cpus = {} );
+
+        /**
+         * Runs any remaining tasks and stops the workers.
+         */
+        virtual ~ThreadPool();
+
+        /**
+         * Stops accepting new tasks and waits up to timeoutMsec for the queued tasks to run;
+         * tasks still queued after that are discarded. Then waits for the workers to finish
+         * the tasks they are running and stops them. Does nothing if already shut down.
+         * Must not be called from one of the pool's tasks, which would wait on itself; such
+         * calls are refused.
+         *
+         * @param timeoutMsec Maximum number of milliseconds to wait for queued tasks.
+         * @return true if all tasks ran, false if some were discarded or the call was refused.
+         */
+        bool shutdown( uint32_t timeoutMsec );
+
+        ThreadPool( const ThreadPool& ) = delete;
+        ThreadPool& operator=( const ThreadPool& ) = delete;
+
+        /**
+         * Queues a task for execution. This function can be called from any thread,
+         * including from within a running task.
+         *
+         * @param task      Task to run
+         * @param priority  Task priority
+         * @return true if the task was queued, false if the pool is shutting down.
+         */
+        bool submit( const PoolTask_t& task, TaskPriority priority = PRIORITY_NORMAL );
+
+        /**
+         * Returns the number of worker threads.
+         */
+        int getThreadCount();
+
+        /**
+         * Returns the number of tasks waiting to be run.
+         */
+        int getPendingCount();
+    };
+
+}
+#endif //THREADPOOL_H
@@ -0,0 +1,120 @@
+/********************************************************************************
+ *  This file is part of the lopezworks SDK utility library for C/C++ (lwsdk).
+ *
+ *  Copyright (C) 2015-2017 Edwin R. Lopez
+ *  http://www.lopezworks.info
+ *
+ *  This source code is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation LGPL v2.1
+ *  (http://www.gnu.org/licenses/).
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ *  02110-1301  USA.
+ ********************************************************************************/
+#ifndef THREADS_H
+#define THREADS_H
+
+#include <string>
+#include <vector>
+#include "Export.h"
+
+namespace lwsdk
+{
+    /**
+     * Attributes applied to a library thread when it starts.
+     */
+    struct LWSDK_API ThreadAttributes
+    {
+        std::string      name;              // thread name shown by top/perf, truncated to 15 chars; blank keeps the default
+        std::vector<int> cpus;              // CPUs the thread may run on, empty for no restriction
+        int              fifoPriority{0};   // 1..99 runs the thread as SCHED_FIFO (needs CAP_SYS_NICE), 0 keeps the default policy
+        int              numaNode{-1};      // NUMA node to run on and prefer memory from, -1 for none
+    };
+
+
+    /**
+     * Information about a running library thread.
+     */
+    struct LWSDK_API ThreadInfo
+    {
+        std::string      subsystem;         // subsystem owning the thread: "webserver", "serialport", etc.
+        std::string      name;              // thread name
+        long             tid{0};            // kernel thread ID
+        std::vector<int> cpus;              // CPUs the thread may run on
+        int              fifoPriority{0};   // SCHED_FIFO priority, 0 if not real-time
+        double           cpuSeconds{0};     // CPU time consumed since the thread started
+        double           cpuPercent{0};     // average CPU usage since the thread started, 100 = one full core
+    };
+
+
+    /**
+     * Scheduling and naming controls for the threads created by the library.
+     *
+     * Attributes are configured per subsystem and applied by each thread as it starts, so
+     * they must be set before starting the subsystem. Subsystems and their threads:
+     *
+     *     "webserver"              Webserver service thread
+     *     "webserver.dispatcher"   Webserver message dispatcher thread
+     *     "serialport"             SerialPort reader threads
+     *     "uevent"                 NetlinkUEvent reader thread
+     *     "reactor"                Reactor thread created by Reactor::start()
+     *     "threadpool"             ThreadPool workers
+     *     "timers"                 Timers thread created by Timers::start()
+     *
+     * A dotted subsystem falls back to its parent's attributes if it has none of its own.
+     */
+    namespace Threads
+    {
+        /**
+         * Sets the attributes applied to the threads the given subsystem creates from now on.
+         */
+        LWSDK_API void setAttributes( const std::string& subsystem, const ThreadAttributes& attributes );
+
+        /**
+         * Returns the attributes configured for the given subsystem, or its parent's.
+         */
+        LWSDK_API ThreadAttributes getAttributes( const std::string& subsystem );
+
+        /**
+         * Applies attributes to the calling thread.
+         * @return true if all attributes were applied, false if any failed (e.g. missing
+         *         privileges for SCHED_FIFO); failures are logged.
+         */
+        LWSDK_API bool apply( const ThreadAttributes& attributes );
+
+        /**
+         * Returns the library threads currently running.
+         */
+        LWSDK_API std::vector<ThreadInfo> list();
+    }
+
+
+    /**
+     * Registers the calling thread as a library thread for its lifetime, applying the
+     * subsystem's configured attributes and naming it in the exported trace. Used at the
+     * top of every library thread function.
+     */
+    class LWSDK_API ThreadScope
+    {
+    public:
+        /**
+         * @param subsystem    Subsystem owning the thread, see Threads.
+         * @param defaultName  Thread name used if the subsystem's attributes don't set one.
+         */
+        ThreadScope( const std::string& subsystem, const std::string& defaultName );
+        ~ThreadScope();
+
+        ThreadScope( const ThreadScope& ) = delete;
+        ThreadScope& operator=( const ThreadScope& ) = delete;
+    };
+
+}
+#endif //THREADS_H
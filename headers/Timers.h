@@ -0,0 +1,155 @@
+/********************************************************************************
+ *  This file is part of the lopezworks SDK utility library for C/C++ (lwsdk).
+ *
+ *  Copyright (C) 2015-2017 Edwin R. Lopez
+ *  http://www.lopezworks.info
+ *
+ *  This source code is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation LGPL v2.1
+ *  (http://www.gnu.org/licenses/).
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ *  02110-1301  USA.
+ ********************************************************************************/
+#ifndef TIMERS_H
+#define TIMERS_H
+
+#include <mutex>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <functional>
+#include <unordered_map>
+#include "Export.h"
+
+namespace lwsdk
+{
+    /**
+     * Task run when a timer expires.
+     */
+    typedef std::function<void()> TimerTask_t;
+
+
+    /**
+     * Timer service based on a hierarchical timing wheel with 1 ms ticks, driven by a single
+     * timerfd. Scheduling and cancelling timers are O(1), so many thousands of timers
+     * (idle timeouts, request timeouts, debounce windows) can be kept at negligible cost.
+     *
+     * The expired timers run in the thread calling process(); that is the thread started by
+     * start(), or the reactor's thread when the timerfd returned by getFd() is watched by a
+     * Reactor (see Reactor::runAfter()).
+     */
+    class LWSDK_API Timers
+    {
+        struct TimerNode
+        {
+            uint64_t   id{0};
+            uint64_t   expires{0};     // tick at which the timer expires
+            uint32_t   periodMs{0};
+            bool       cancelled{false};
+            TimerTask_t task;
+            TimerNode  *prev{nullptr};     // for the slot head, the tail of the slot
+            TimerNode  *next{nullptr};
+            TimerNode  **slot{nullptr};   // wheel slot holding the node, null while unlinked
+        };
+
+        // Wheel geometry: level 0 has 256 1-ms slots, each upper level 64 slots of the
+        // previous level's range; 5 levels cover 2^32 ms (~49 days)
+        static const int ROOT_BITS = 8;
+        static const int LEVEL_BITS = 6;
+        static const int LEVELS = 5;
+        static const int ROOT_SIZE = 1 << ROOT_BITS;
+        static const int LEVEL_SIZE = 1 << LEVEL_BITS;
+
+        int timerfd{-1};
+        int wakefd{-1};
+
+        std::mutex mtx;
+        TimerNode *root[ ROOT_SIZE ]{};
+        TimerNode *levels[ LEVELS - 1 ][ LEVEL_SIZE ]{};
+        std::unordered_map<uint64_t, TimerNode*> nodes;  // active timers indexed by ID
+        std::vector<TimerNode*> freeNodes;               // recycled nodes, to avoid malloc churn
+        uint64_t currentTick{0};
+        uint64_t armedTick{0};
+        uint64_t timerIdSeq{1};
+        long     baseMillis{0};
+
+        std::atomic_bool keepWorking{false};
+        std::thread *timersThread{nullptr};
+
+        uint64_t now();
+        TimerNode*& slotFor( TimerNode *node );
+        void link( TimerNode *node );
+        void unlink( TimerNode *node );
+        void cascade( int level );
+        uint64_t nextTick();
+        void arm();
+        void timersThreadLoop();
+
+    public:
+        /**
+         * Creates the timerfd backing the timer wheel.
+         * @throw RuntimeException if the timerfd cannot be created.
+         */
+        Timers();
+
+        virtual ~Timers();
+
+        Timers( const Timers& ) = delete;
+        Timers& operator=( const Timers& ) = delete;
+
+        /**
+         * Schedules a task to run after the given delay. This function can be called from
+         * any thread, including from within a timer task.
+         *
+         * @param delayMs   Milliseconds to wait before running the task
+         * @param task      Task to run
+         * @param periodMs  If greater than 0, the task is re-run every periodMs until cancelled.
+         * @return Timer ID, used to cancel the timer.
+         */
+        uint64_t schedule( uint32_t delayMs, const TimerTask_t& task, uint32_t periodMs = 0 );
+
+        /**
+         * Cancels a timer. Cancelling a timer from within its own task stops it from repeating.
+         * @return true if the timer was found and cancelled, false otherwise.
+         */
+        bool cancel( uint64_t timerId );
+
+        /**
+         * Returns the number of active timers.
+         */
+        int size();
+
+        /**
+         * Returns the timerfd driving the wheel. It becomes readable when process() has
+         * timers to run.
+         */
+        int getFd();
+
+        /**
+         * Runs all expired timers in the calling thread and re-arms the timerfd.
+         */
+        void process();
+
+        /**
+         * Runs the timers in a new thread. Not needed when the timerfd is serviced by
+         * a reactor. Does nothing if already started.
+         */
+        void start();
+
+        /**
+         * Stops the thread started by start(), if any.
+         */
+        void stop();
+    };
+
+}
+#endif //TIMERS_H
@@ -0,0 +1,158 @@
+/********************************************************************************
+ *  This file is part of the lopezworks SDK utility library for C/C++ (lwsdk).
+ *
+ *  Copyright (C) 2015-2017 Edwin R. Lopez
+ *  http://www.lopezworks.info
+ *
+ *  This source code is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation LGPL v2.1
+ *  (http://www.gnu.org/licenses/).
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ *  02110-1301  USA.
+ ********************************************************************************/
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <string>
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+#include "Export.h"
+
+namespace lwsdk
+{
+    /**
+     * In-process tracing. Spans and instant events are recorded into per-thread ring
+     * buffers (the oldest events are overwritten when full) and exported on demand as
+     * Chrome trace JSON, which both chrome://tracing and the Perfetto UI open.
+     *
+     * Flow IDs link spans across threads and queues: a span started with a flow ID makes
+     * it the thread's current flow, so work triggered from within the span (for instance
+     * Webserver::sendMessage() called from a SerialPort line callback) carries the same ID
+     * and is drawn as one arrow-connected chain in the trace viewer.
+     *
+     * Category and event names must be string literals (or otherwise outlive the trace);
+     * they are stored as pointers so recording never allocates. When tracing is stopped,
+     * spans cost a single relaxed load.
+     */
+    namespace Trace
+    {
+        namespace Detail
+        {
+            LWSDK_API inline std::atomic_bool enabled{false};
+            LWSDK_API inline thread_local uint64_t currentFlow = 0;
+
+            LWSDK_API void record( char phase, const char *category, const char *name,
+                         uint64_t ts, uint64_t dur, uint64_t flowId );
+        }
+
+        /**
+         * Starts recording events.
+         * @param eventsPerThread Ring buffer capacity of each thread, in events.
+         */
+        LWSDK_API void start( size_t eventsPerThread = 65536 );
+
+        /**
+         * Stops recording events; recorded events are kept until clear() or start().
+         */
+        LWSDK_API void stop();
+
+        /**
+         * Test if events are being recorded.
+         */
+        inline bool isEnabled() { return Detail::enabled.load( std::memory_order_relaxed ); }
+
+        /**
+         * Discards all recorded events.
+         */
+        LWSDK_API void clear();
+
+        /**
+         * Returns CLOCK_MONOTONIC time in nanoseconds, the trace's time base.
+         */
+        LWSDK_API uint64_t nowNanos();
+
+        /**
+         * Returns a new flow ID, or 0 if tracing is stopped.
+         */
+        LWSDK_API uint64_t newFlowId();
+
+        /**
+         * Returns the flow ID of the innermost span with a flow running in the calling
+         * thread, 0 if none.
+         */
+        inline uint64_t currentFlow() { return Detail::currentFlow; }
+
+        /**
+         * Records an instant event.
+         */
+        LWSDK_API void instant( const char *category, const char *name, uint64_t flowId = 0 );
+
+        /**
+         * Names the calling thread in the exported trace.
+         */
+        LWSDK_API void setThreadName( const std::string& name );
+
+        /**
+         * Returns all recorded events in Chrome trace JSON format.
+         */
+        LWSDK_API std::string toChromeJson();
+
+        /**
+         * Writes the recorded events in Chrome trace JSON format to the given file.
+         * @return true on success, false if the file could not be written.
+         */
+        LWSDK_API bool dump( const std::string& path );
+    }
+
+
+    /**
+     * Records the scope it lives in as a span. A span given a flow ID becomes the calling
+     * thread's current flow until it ends; otherwise it inherits the current flow.
+     *
+     *       TraceSpan span( "serialport", "line", Trace::newFlowId() );
+     */
+    class LWSDK_API TraceSpan
+    {
+        const char *category;
+        const char *name;
+        uint64_t flowId{0};
+        uint64_t previousFlow{0};
+        uint64_t start{0};
+
+    public:
+        TraceSpan( const char *category, const char *name, uint64_t flowId = 0 ) : category( category ), name( name )
+        {
+            if ( !Trace::isEnabled() )
+                return;
+
+            previousFlow = Trace::Detail::currentFlow;
+            this->flowId = flowId != 0 ? flowId : previousFlow;
+            Trace::Detail::currentFlow = this->flowId;
+            start = Trace::nowNanos();
+        }
+
+        ~TraceSpan()
+        {
+            if ( start == 0 )
+                return;
+
+            Trace::Detail::record( 'X', category, name, start, Trace::nowNanos() - start, flowId );
+            Trace::Detail::currentFlow = previousFlow;
+        }
+
+        TraceSpan( const TraceSpan& ) = delete;
+        TraceSpan& operator=( const TraceSpan& ) = delete;
+    };
+
+}
+#endif //TRACE_H
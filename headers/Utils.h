@@ -24,118 +24,132 @@
 
 
 #include <string>
+#include <chrono>
+#include "Export.h"
 
 namespace lwsdk::Utils
 {
     /**
      * Returns the computer's local time zone string formatted as: 'MDT'
      */
-    std::string localTimeZone();
+    LWSDK_API std::string localTimeZone();
 
 
     /**
      * Returns a date time sting for the given epoch milliseconds
      * formatted as: 'Mon Sep 04 00:25:05 2023 MDT'
      */
-    std::string toDateTimeFull( long epochMillis, bool useUTC = true );
+    LWSDK_API std::string toDateTimeFull( long epochMillis, bool useUTC = true );
 
 
     /**
      * Returns a date time sting for the given epoch milliseconds
      * formatted as: 'Mon Sep 04 12:25:05 AM 2023 MDT'
      */
-    std::string toDateTimeFull12( long epochMillis, bool useUTC = true );
+    LWSDK_API std::string toDateTimeFull12( long epochMillis, bool useUTC = true );
 
 
     /**
      * Returns a date time sting for the given epoch milliseconds
      * formatted as: '2023-09-04 00:25:05 MDT'
      */
-    std::string toDateTimeZ( long epochMillis, bool useUTC = true );
+    LWSDK_API std::string toDateTimeZ( long epochMillis, bool useUTC = true );
 
 
     /**
      * Returns a date time sting for the given epoch milliseconds
      * formatted as:  '2023-09-04 12:25:05 AM MDT'
      */
-    std::string toDateTimeZ12( long epochMillis, bool useUTC = true );
+    LWSDK_API std::string toDateTimeZ12( long epochMillis, bool useUTC = true );
 
 
     /**
      * Returns a date time sting for the given epoch milliseconds
      * formatted as: '2023-09-04 00:25:05'
      */
-    std::string toDateTime( long epochMillis, bool useUTC = true );
+    LWSDK_API std::string toDateTime( long epochMillis, bool useUTC = true );
 
 
     /**
      * Returns a date time sting for the given epoch milliseconds
      * formatted as:  '2023-09-04 12:25:05 AM'
      */
-    std::string toDateTime12( long epochMillis, bool useUTC = true );
+    LWSDK_API std::string toDateTime12( long epochMillis, bool useUTC = true );
 
 
     /**
      * Returns a date sting for the given epoch milliseconds
      * formatted as: '2023-09-04'
      */
-    std::string toDate( long epochMillis, bool useUTC = true );
+    LWSDK_API std::string toDate( long epochMillis, bool useUTC = true );
 
 
     /**
      * Returns a date sting for the given epoch milliseconds
      * formatted as: '09/04/2023'
      */
-    std::string toDateUS( long epochMillis, bool useUTC = true );
+    LWSDK_API std::string toDateUS( long epochMillis, bool useUTC = true );
 
 
     /**
      * Returns a time sting for the given epoch milliseconds
      * formatted as: '00:25:05'
      */
-    std::string toTime( long epochMillis, bool useUTC = true );
+    LWSDK_API std::string toTime( long epochMillis, bool useUTC = true );
 
 
     /**
      * Returns a date time sting for the given epoch milliseconds
      * formatted as: '12:25:05 AM'
      */
-    std::string toTime12( long epochMillis, bool useUTC = true );
+    LWSDK_API std::string toTime12( long epochMillis, bool useUTC = true );
 
 
     /**
      * Get the current system clock time in microseconds.
      * @return he current system clock time in microseconds.
      */
-    long currentTimeUsec();
+    inline long currentTimeUsec()
+    {
+        using namespace std::chrono;
+        return (long) duration_cast<microseconds>( system_clock::now().time_since_epoch() ).count();
+    }
 
 
     /**
      * Get the current UNIX epoch time in milliseconds.
      * @return the epoch time in milliseconds.
      */
-    long currentTimeMillis();
+    inline long currentTimeMillis()
+    {
+        using namespace std::chrono;
+        return (long) duration_cast<milliseconds>( system_clock::now().time_since_epoch() ).count();
+    }
 
 
     /**
      * Get the current UNIX epoch time in seconds.
      * @return the epoch time in seconds.
      */
-    long currentTimeSeconds();
+    inline long currentTimeSeconds()
+    {
+        using namespace std::chrono;
+        return (long) duration_cast<seconds>( system_clock::now().time_since_epoch() ).count();
+    }
 
     /**
      * Executes a command in the shell as '/bin/sh -c' and return the command output
      * @param cmd  A shell command.
      * @return A string containing the command output.
      */
-    std::string shellExec( const std::string& cmd );
+    LWSDK_API std::string shellExec( const std::string& cmd );
 
     /**
      * Dumps the data at the given memory location to the console.
      * @param  address   Memory address to dump
      * @param  size      Number of bytes to dump
      */
-    void memdump( const void *address, uint32_t size );
+    LWSDK_API void memdump( const void *address, uint32_t size );
 
 }
 
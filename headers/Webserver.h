@@ -24,13 +24,21 @@
 
 #include <string>
 #include <functional>
+#include "Json.h"
+#include "Export.h"
+
+namespace lwsdk
+{
+    class Reactor;
+    class ThreadPool;
+}
 
 namespace lwsdk::Webserver
 {
     /**
      * Holds information about a websocket message
      */
-    struct WSMessage
+    struct LWSDK_API WSMessage
     {
         uint32_t    connectionId;  // ID of the connection the message is associated with
         std::string msg;           // message contents
@@ -39,6 +47,61 @@ namespace lwsdk::Webserver
                connectionId( connectionId ), msg(std::move( msg )) {}
     };
     
+    /**
+     * Optional server features, see setOptions().
+     */
+    struct LWSDK_API ServerOptions
+    {
+        // Offer HTTP/2 through ALPN on the https port, so browsers fetch the static content
+        // over one multiplexed connection; websocket clients then also connect over that
+        // connection (RFC 8441) if they support it. Plain http stays HTTP/1.1. Requires
+        // libwebsockets built with LWS_WITH_HTTP2.
+        bool http2{false};
+
+        // Number of lws contexts serving the http/https ports, each with its own service
+        // thread, outgoing queue and connections. Instances bind the same ports with
+        // SO_REUSEPORT and the kernel spreads new connections among them; sendMessage()
+        // broadcasts reach the clients of every instance. Not supported with setReactor().
+        int instances{1};
+
+        // URL path serving a Server-Sent Events (text/event-stream) stream, e.g. "/events",
+        // blank to disable. Each open stream is a connection like a websocket one: it
+        // receives sendMessage() broadcasts and messages sent to its ID, one event per
+        // message with every line of the message as a "data:" field. Streams are one way,
+        // a lighter option for clients that never send, and share HTTP/2 connections.
+        std::string ssePath;
+
+        // Number of recent broadcast messages replayed to every new connection ahead of
+        // newer messages, so late joiners get the current state without the application
+        // resending it; 0 disables, up to 256. Replayed messages share the broadcast buffers.
+        int replayFrames{0};
+
+        // If set, replay keeps the latest broadcast message of each key returned by this
+        // function instead of the last N messages, up to replayFrames keys. Messages with
+        // a blank key are not replayed. Called from sendMessage().
+        std::function<std::string( const std::string& message )> replayKey;
+
+        // Batching window for clients connected with the "ws0-delta" subprotocol, in
+        // microseconds; 0 disables. Messages queued for such a client within the window
+        // are packed into one binary frame, up to batchMaxBytes, saving a frame, a write
+        // and a deflate flush per message. See js/lwsdk-client.js for the envelope.
+        // Batching is ws0-delta only: clients of the other subprotocols are not expected
+        // to understand the envelope and always get one frame per message.
+        uint32_t batchDelayUs{0};
+        uint32_t batchMaxBytes{16384};
+
+        // Inbound limits per websocket connection, 0 for none. Messages and bytes are
+        // metered by token buckets holding one second worth of their rate, and at most
+        // rxQueueShare messages of a connection may wait in the incoming queue. A client
+        // over its limits is paused with lws flow control, so it is pushed back by its
+        // socket buffers, and resumed once under them. With any limit set, a message
+        // arriving while the incoming queue is full pauses its client instead of being
+        // dropped.
+        uint32_t rxMessagesPerSec{0};
+        uint32_t rxBytesPerSec{0};
+        int rxQueueShare{0};
+    };
+
     /**
      * User callback to receive web socket messages
      * @param connectionId ID of the connection the message was received from
@@ -47,14 +110,46 @@ namespace lwsdk::Webserver
     typedef std::function<void( uint32_t connectionId, const std::string& message )>
             MessageCallback_t;
 
+    /**
+     * User callback to receive web socket messages decoded as documents, see setValueCallback().
+     * @param connectionId ID of the connection the message was received from
+     * @param value        The decoded message
+     */
+    typedef std::function<void( uint32_t connectionId, const Json::Value& value )>
+            ValueCallback_t;
+
 
     /**
      * Registers an user callback function to receive incoming websocket messages.
+     * Must be set before start(): messages are only delivered to callbacks if one is
+     * set when the server starts.
      * @param msgCallback Pointer to user defined function. May be set to null to
      *                    remove any previously set function.
      *
      */
-    void setMessageCallback( const MessageCallback_t&  msgCallback );
+    LWSDK_API void setMessageCallback( const MessageCallback_t&  msgCallback );
+
+    /**
+     * Registers an user callback function to receive incoming websocket messages decoded
+     * as documents. Binary messages from clients connected with the "ws0-cbor" or
+     * "ws0-msgpack" subprotocol are decoded as CBOR or MessagePack, all others as JSON,
+     * straight from the receive buffer. Messages that do not decode are passed to the
+     * message callback if set, dropped otherwise.
+     *
+     * @param valueCallback Pointer to user defined function. May be set to null to
+     *                      remove any previously set function.
+     */
+    LWSDK_API void setValueCallback( const ValueCallback_t& valueCallback );
+
+    /**
+     * Dispatches incoming messages to the user callback through the given thread pool,
+     * so that CPU-heavy message handling can use all cores. Note that messages may then
+     * be handled concurrently and out of order.
+     *
+     * @param pool  Thread pool to use, or null to call the message callback from the
+     *              dispatcher thread (default). The pool must outlive the web server.
+     */
+    LWSDK_API void setThreadPool( ThreadPool *pool );
 
     /**
      * Configure the web server. This function must be called before starting the web server.
@@ -69,7 +164,7 @@ namespace lwsdk::Webserver
      * @throw RuntimeException if the given configuration is invalid or the web server is currently
      *        running.
      */
-    void setConfig( std::string hostname, std::string webDir, int port = -1);
+    LWSDK_API void setConfig( std::string hostname, std::string webDir, int port = -1);
 
 
     /**
@@ -86,48 +181,95 @@ namespace lwsdk::Webserver
      * @throw RuntimeException if the given configuration is invalid or the web server is currently
      *        running.
      */
-    void setConfigSSL( int portTls, std::string sslCertPath, std::string sslKeyPath );
+    LWSDK_API void setConfigSSL( int portTls, std::string sslCertPath, std::string sslKeyPath );
+
+    /**
+     * Listen on a Unix domain socket in addition to the http/https ports, so local clients
+     * skip the TCP loopback stack. The socket serves the same web content and websocket
+     * protocol as the ports, and its clients share the same message queues. It can also
+     * be the only listener, in which case setConfig() may be called with port -1.
+     *
+     * @param socketPath  Path of the socket file, a stale socket there is replaced; a path
+     *                    starting with '@' uses the Linux abstract namespace instead. Set to
+     *                    blank to disable.
+     *
+     * @throw RuntimeException if the path is too long or the web server is currently running.
+     */
+    LWSDK_API void setConfigUnix( const std::string& socketPath );
+
+    /**
+     * Sets optional server features. This function must be called before starting the web server.
+     *
+     * @throw RuntimeException if the web server is currently running, lws lacks support
+     *        for a requested feature, the number of instances or replay frames is out of
+     *        range, the batch size is too small, the queue share is negative, or the event
+     *        stream path is invalid.
+     */
+    LWSDK_API void setOptions( const ServerOptions& options );
+
+    /**
+     * Returns the current optional server features.
+     */
+    LWSDK_API ServerOptions getOptions();
+
+    /**
+     * Services the web server from the given reactor instead of a dedicated server thread.
+     * lws' sockets are watched by the reactor through lws' external poll support, which
+     * requires libwebsockets 4.x to be built with LWS_WITH_EXTERNAL_POLL. The reactor
+     * must outlive the web server.
+     *
+     * @param reactor  Reactor to use, or null to go back to the dedicated server thread.
+     *
+     * @throw RuntimeException if the web server is currently running, or lws does not
+     *        support external polling.
+     */
+    LWSDK_API void setReactor( Reactor *reactor );
 
     /**
      * Returns a multiline string with the current configuration.
      */
-    std::string getConfig();
+    LWSDK_API std::string getConfig();
 
     /**
      * Returns the currently configured hostname
      */
-    std::string getHostname();
+    LWSDK_API std::string getHostname();
 
     /**
      * Returns the currently configured web directory
      */
-    std::string getWebDir();
+    LWSDK_API std::string getWebDir();
 
     /**
      * Returns the currently configured http port
      */
-    int getPort();
+    LWSDK_API int getPort();
 
     /**
      * Returns the currently configured https port
      */
-    int getSSLPort();
+    LWSDK_API int getSSLPort();
+
+    /**
+     * Returns the currently configured Unix domain socket path, blank if none
+     */
+    LWSDK_API std::string getUnixSocketPath();
 
     /**
      * Returns the currently configured SSL cert file path
      */
-    std::string getSSLCertPath();
+    LWSDK_API std::string getSSLCertPath();
 
     /**
      * Returns the currently configured SSL key file path
      */
-    std::string getSSLKeyPath();
+    LWSDK_API std::string getSSLKeyPath();
 
 
     /**
      * Test if the web server is running.
      */
-    bool isRunning();
+    LWSDK_API bool isRunning();
 
     /**
      * Starts the web server with the current configuration.
@@ -135,18 +277,29 @@ namespace lwsdk::Webserver
      *
      * @throw RuntimeException if the current configuration is invalid.
      */
-    void start();
+    LWSDK_API void start();
 
     /**
      * Stops the web server. If the server is not running, this function
      * does nothing.
      */
-    void stop();
+    LWSDK_API void stop();
+
+    /**
+     * Stops the web server gracefully: waits up to timeoutMsec for the incoming messages
+     * to be handled and the outgoing messages to be written out to their clients, then
+     * stops the server. Messages still pending when the time is up are discarded.
+     * If the server is not running, this function does nothing.
+     *
+     * @param timeoutMsec Maximum number of milliseconds to wait for the queues to drain.
+     * @return true if all messages were delivered, false if some were discarded.
+     */
+    LWSDK_API bool shutdown( uint32_t timeoutMsec );
 
     /**
-     * Return the number of connected web socket clients.
+     * Return the number of connected web socket and event stream clients.
      */
-    int getClientCount();
+    LWSDK_API int getClientCount();
 
     /**
      * Enqueue a message for delivery.
@@ -157,13 +310,43 @@ namespace lwsdk::Webserver
      * @return true if the message was enqueued for delivery, false if the outgoing
      *         queue is full and no more messages can be accepted at this time.
      */
-    bool sendMessage( const std::string& message, uint32_t destId = 0 );
+    LWSDK_API bool sendMessage( const std::string& message, uint32_t destId = 0 );
+
+    /**
+     * Broadcasts a new version of a large, slowly changing state document, such as a
+     * dashboard snapshot. Clients connected with the "ws0-delta" subprotocol receive a
+     * binary frame with the difference from the last version they acknowledged, or the
+     * whole snapshot when that is not smaller; they receive the latest snapshot as soon as
+     * they connect, too. Other clients receive the snapshot like sendMessage() would send it.
+     * See js/lwsdk-client.js for a browser client.
+     *
+     * @param snapshot The snapshot contents.
+     * @return true if the snapshot was enqueued for delivery, false if the outgoing
+     *         queue is full and no more messages can be accepted at this time.
+     */
+    LWSDK_API bool sendSnapshot( const std::string& snapshot );
+
+    /**
+     * Enqueue a document for delivery, encoded for each client: a binary CBOR or
+     * MessagePack message for clients connected with the "ws0-cbor" or "ws0-msgpack"
+     * subprotocol, JSON text for all others. Each encoding is done once and shared by all
+     * the clients using it: in the calling thread for the codecs with clients connected,
+     * otherwise on delivery to the first such client connecting later, including replays.
+     *
+     * @param value   The document to send.
+     * @param destId  If different than 0, the document is delivered only to the
+     *                web connection identified by the given ID, otherwise
+     *                delivered to all active web clients.
+     * @return true if the document was enqueued for delivery, false if the outgoing
+     *         queue is full and no more messages can be accepted at this time.
+     */
+    LWSDK_API bool sendValue( const Json::Value& value, uint32_t destId = 0 );
 
     /**
      * Retrieve a message from the incoming queue, waiting up to a maximum of timeoutMsec
      * if not message is available.
      *
-     * NOTE: If a MessageCallback has been specified, this function always returns an
+     * NOTE: If a MessageCallback or ValueCallback has been specified, this function always returns an
      *       empty value. Incoming messages are delivered via callback function only.
      *
      * Example for processing returned optional value:
@@ -177,7 +360,7 @@ namespace lwsdk::Webserver
      * @return A new message if any is available, otherwise an empty value if the operation
      *         timed out.
      */
-    std::optional<WSMessage> receiveMessage( uint32_t timeoutMsec );
+    LWSDK_API std::optional<WSMessage> receiveMessage( uint32_t timeoutMsec );
 
 
 } // namespace
@@ -0,0 +1,231 @@
+/********************************************************************************
+ *  This file is part of the lopezworks SDK utility library for C/C++ (lwsdk).
+ *
+ *  Copyright (C) 2015-2017 Edwin R. Lopez
+ *  http://www.lopezworks.info
+ *
+ *  This source code is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation LGPL v2.1
+ *  (http://www.gnu.org/licenses/).
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ *  02110-1301  USA.
+ ********************************************************************************/
+#ifndef WEBSOCKETCLIENT_H
+#define WEBSOCKETCLIENT_H
+
+#include <deque>
+#include <mutex>
+#include <memory>
+#include <string>
+#include <thread>
+#include <atomic>
+#include <functional>
+#include "BufferPool.h"
+#include "Json.h"
+#include "Export.h"
+
+namespace lwsdk
+{
+    class Reactor;
+    class Counter;
+
+    /**
+     * User callback to receive the messages sent by the server.
+     * @param message  The message contents
+     */
+    typedef std::function<void( const std::string& message )>
+            WSClientMessageCallback_t;
+
+    /**
+     * User callback to receive connection state changes.
+     * @param connected  true when the connection is established, false when it is lost
+     */
+    typedef std::function<void( bool connected )>
+            WSClientStatusCallback_t;
+
+
+    /**
+     * Optional client features.
+     */
+    struct LWSDK_API ClientOptions
+    {
+        // Websocket subprotocol requested from the server, e.g. "ws0"; blank for none.
+        // With "ws0-cbor" or "ws0-msgpack", sendValue() sends binary CBOR or MessagePack.
+        std::string protocol;
+
+        // Origin header, blank to use the server's host name
+        std::string origin;
+
+        // Reconnect backoff: the delay doubles on every failed attempt, from reconnectMinMs
+        // up to reconnectMaxMs, and each delay is randomized by up to half its length so
+        // that many clients restarted together do not reconnect in lockstep
+        uint32_t reconnectMinMs{250};
+        uint32_t reconnectMaxMs{30000};
+
+        // Maximum number of messages waiting to be sent, either because the connection is
+        // busy or because it is down
+        int sendQueueSize{1024};
+
+        // Accept self-signed server certificates and certificates for other host names,
+        // for wss:// URLs; for testing only
+        bool allowSelfSigned{false};
+    };
+
+
+    /**
+     * Websocket client connecting out to a ws:// or wss:// URL, built on libwebsockets
+     * like the Webserver and serviced the same way: by a thread of its own, or by a
+     * Reactor shared with the web server and other subsystems.
+     *
+     * The client stays connected until stop() is called, reconnecting with backoff
+     * whenever the connection fails or is lost. Messages sent while disconnected wait in
+     * a bounded queue and go out once the connection is back; a message interrupted by a
+     * disconnect is sent again in full. Queued messages are written back to back for as
+     * long as the socket takes them, instead of one write per writable event.
+     *
+     * The message and status callbacks run in the thread servicing the client; they must
+     * not block.
+     */
+    class LWSDK_API WebsocketClient
+    {
+        struct Session;                             // lws state, see WebsocketClient.cpp
+
+        struct OutMessage
+        {
+            PooledBuffer data;
+            bool binary;
+        };
+
+        std::string url;
+        std::string address;
+        std::string path;
+        int port{80};
+        bool ssl{false};
+        ClientOptions options;
+
+        WSClientMessageCallback_t messageCallback{nullptr};
+        WSClientStatusCallback_t  statusCallback{nullptr};
+
+        std::mutex mtx;                             // guards sendQueue
+        std::deque<OutMessage> sendQueue;           // messages not yet written out, oldest first
+
+        std::unique_ptr<Session> session;
+        std::atomic_bool keepWorking{false};
+        std::atomic_bool connected{false};
+        std::atomic_bool writeRequested{false};
+        std::shared_ptr<std::atomic_bool> alive;    // cleared on destruction, checked by the reactor tasks posted
+        std::thread *serviceThread{nullptr};
+        Reactor *reactor{nullptr};
+        uint64_t serviceTimerId{0};
+
+        Counter *txMessagesMetric{nullptr};
+        Counter *txBytesMetric{nullptr};
+        Counter *txDroppedMetric{nullptr};
+        Counter *rxMessagesMetric{nullptr};
+        Counter *rxBytesMetric{nullptr};
+        Counter *reconnectsMetric{nullptr};
+
+        void parseUrl();
+        void createContext();
+        void destroyContext();
+        void connect();
+        void scheduleReconnect();
+        void wakeup();
+        void writeQueued();
+        void serviceThreadLoop();
+
+        friend struct WebsocketClientCallbacks;
+
+    public:
+        /**
+         * Creates a client for the given URL, serviced by a thread of its own.
+         * @param url      Server URL: ws://host[:port][/path] or wss://host[:port][/path]
+         * @param options  Optional features
+         * @throw RuntimeException if the URL is invalid.
+         */
+        explicit WebsocketClient( const std::string& url, const ClientOptions& options = {} );
+
+        /**
+         * Creates a client serviced by the given reactor instead of a dedicated thread. All
+         * callbacks are invoked in the reactor's thread; the reactor must outlive the client.
+         * @throw RuntimeException if the URL is invalid, or libwebsockets was built without
+         *        LWS_WITH_EXTERNAL_POLL.
+         */
+        WebsocketClient( Reactor& reactor, const std::string& url, const ClientOptions& options = {} );
+
+        virtual ~WebsocketClient();
+
+        WebsocketClient( const WebsocketClient& ) = delete;
+        WebsocketClient& operator=( const WebsocketClient& ) = delete;
+
+        /**
+         * Set user-defined callback to receive the server's messages. Must be called
+         * before start().
+         * @param messageCallback  Pointer to user-defined function. Set to null
+         *                         to remove any previously set callback.
+         */
+        void setMessageCallback( const WSClientMessageCallback_t& messageCallback );
+
+        /**
+         * Set user-defined callback to receive connection state changes. Must be called
+         * before start().
+         * @param statusCallback  Pointer to user-defined function. Set to null
+         *                        to remove any previously set callback.
+         */
+        void setStatusCallback( const WSClientStatusCallback_t& statusCallback );
+
+        /**
+         * Starts connecting to the server. Does nothing if already started.
+         * The client's traffic is published in the Metrics registry under the "wsclient"
+         * subsystem, using the URL as instance.
+         */
+        void start();
+
+        /**
+         * Closes the connection and stops reconnecting. Messages still queued are kept
+         * for the next start().
+         */
+        void stop();
+
+        /**
+         * Queues a message for sending. This function can be called from any thread.
+         * @param message  The message contents
+         * @param binary   Send as a binary websocket message, otherwise as text
+         * @return true if the message was queued, false if the send queue is full.
+         */
+        bool send( const std::string& message, bool binary = false );
+
+        /**
+         * Queues a document for sending, encoded as CBOR or MessagePack if the client
+         * requested the "ws0-cbor" or "ws0-msgpack" subprotocol, as JSON otherwise.
+         * @return true if the document was queued, false if the send queue is full.
+         */
+        bool sendValue( const Json::Value& value );
+
+        /**
+         * Test if the client is connected to the server.
+         */
+        bool isConnected();
+
+        /**
+         * Returns the number of messages waiting to be sent.
+         */
+        int getQueueSize();
+
+        /**
+         * Returns the server URL.
+         */
+        std::string getUrl();
+    };
+
+}
+#endif //WEBSOCKETCLIENT_H
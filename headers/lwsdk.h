@@ -24,7 +24,9 @@
 
 
 #include "Logger.h"
+#include "Export.h"
 #include "Exceptions.h"
+#include "Expected.h"
 #include "Utils.h"
 #include "ConcurrentQueue.h"
 #include "Strings.h"
@@ -34,6 +36,22 @@
 #include "SerialPort.h"
 #include "NetlinkUEvent.h"
 #include "Webserver.h"
+#include "WebsocketClient.h"
+#include "Reactor.h"
+#include "ThreadPool.h"
+#include "Timers.h"
+#include "BufferPool.h"
+#include "Metrics.h"
+#include "Trace.h"
+#include "Threads.h"
+#include "Alloc.h"
+#include "Delta.h"
+#include "Json.h"
+#include "Codecs.h"
+
+#if defined(__cpp_impl_coroutine)
+    #include "Async.h"
+#endif
 
 
 #endif //LWSDK_H
@@ -0,0 +1,232 @@
+/********************************************************************************
+ *  This file is part of the lopezworks SDK utility library for C/C++ (lwsdk).
+ *
+ *  Copyright (C) 2015-2017 Edwin R. Lopez
+ *  http://www.lopezworks.info
+ *
+ *  This source code is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation LGPL v2.1
+ *  (http://www.gnu.org/licenses/).
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ *  02110-1301  USA.
+ ********************************************************************************/
+
+/**
+ * Browser client for the lwsdk web server (see Webserver.h).
+ *
+ *   const client = new LwsdkClient( 'wss://' + location.host, {
+ *       onMessage:  ( text ) => { ... },             // sendMessage() messages
+ *       onSnapshot: ( text, version ) => { ... },    // sendSnapshot() snapshots
+ *   });
+ *   client.send( 'hello' );
+ *
+ * The client connects with the "ws0-delta" subprotocol: snapshots arrive as full or
+ * delta-encoded binary frames, which are rebuilt here and acknowledged, so the server
+ * can keep sending deltas against the versions this client holds. Messages batched by
+ * the server (ServerOptions::batchDelayUs) are unpacked and handed to onMessage() one
+ * by one.
+ */
+(function ( global ) {
+    'use strict';
+
+    const OP_COPY = 0x01;
+    const OP_DATA = 0x02;
+    const MAX_SNAPSHOTS = 8;
+
+    const decoder = new TextDecoder();
+
+
+    /**
+     * Rebuilds a snapshot from its base and a delta, see Delta.h.
+     * @return Uint8Array with the snapshot, null if the delta is malformed.
+     */
+    function applyDelta( base, bytes, offset ) {
+        const view = new DataView( bytes.buffer, bytes.byteOffset, bytes.byteLength );
+        const parts = [];
+        let size = 0;
+        let p = offset;
+
+        while ( p < bytes.length ) {
+            const op = bytes[p++];
+
+            if ( op === OP_COPY && p + 8 <= bytes.length ) {
+                const from = view.getUint32( p );
+                const len = view.getUint32( p + 4 );
+                p += 8;
+
+                if ( from + len > base.length )
+                    return null;
+
+                parts.push( base.subarray( from, from + len ));
+                size += len;
+            }
+            else if ( op === OP_DATA && p + 4 <= bytes.length ) {
+                const len = view.getUint32( p );
+                p += 4;
+
+                if ( p + len > bytes.length )
+                    return null;
+
+                parts.push( bytes.subarray( p, p + len ));
+                size += len;
+                p += len;
+            }
+            else {
+                return null;
+            }
+        }
+
+        const out = new Uint8Array( size );
+        let pos = 0;
+        for ( const part of parts ) {
+            out.set( part, pos );
+            pos += part.length;
+        }
+
+        return out;
+    }
+
+
+    /**
+     * Unpacks a batch frame: 'B' followed by each message as a 32-bit big-endian length
+     * and its UTF-8 bytes.
+     * @return Array of message strings, null if the batch is malformed.
+     */
+    function unpackBatch( bytes ) {
+        const view = new DataView( bytes.buffer, bytes.byteOffset, bytes.byteLength );
+        const messages = [];
+        let p = 1;
+
+        while ( p + 4 <= bytes.length ) {
+            const len = view.getUint32( p );
+            p += 4;
+
+            if ( p + len > bytes.length )
+                return null;
+
+            messages.push( decoder.decode( bytes.subarray( p, p + len )));
+            p += len;
+        }
+
+        return p === bytes.length ? messages : null;
+    }
+
+
+    class LwsdkClient {
+
+        /**
+         * Opens the websocket.
+         * @param url       Server URL, e.g. 'ws://localhost:8080'
+         * @param handlers  Optional onOpen(), onClose( event ), onMessage( text ) and
+         *                  onSnapshot( text, version ) callbacks.
+         */
+        constructor( url, handlers = {} ) {
+            this.handlers = handlers;
+            this.versions = new Map();   // snapshot version -> bytes, delta bases
+            this.version = 0;            // latest snapshot version
+
+            this.ws = new WebSocket( url, 'ws0-delta' );
+            this.ws.binaryType = 'arraybuffer';
+            this.ws.onopen = () => this.handlers.onOpen && this.handlers.onOpen();
+            this.ws.onclose = ( e ) => this.handlers.onClose && this.handlers.onClose( e );
+            this.ws.onmessage = ( e ) => this.receive( e.data );
+        }
+
+        /**
+         * Sends a text message to the server.
+         */
+        send( text ) {
+            this.ws.send( text );
+        }
+
+        /**
+         * Closes the websocket.
+         */
+        close() {
+            this.ws.close();
+        }
+
+        /**
+         * Handles a message from the server.
+         */
+        receive( data ) {
+            if ( typeof data === 'string' ) {
+                this.handlers.onMessage && this.handlers.onMessage( data );
+                return;
+            }
+
+            const bytes = new Uint8Array( data );
+
+            if ( bytes[0] === 0x42 /* 'B' */ ) {
+                const messages = unpackBatch( bytes ) || [];
+                for ( const text of messages )
+                    this.handlers.onMessage && this.handlers.onMessage( text );
+            }
+            else if ( bytes.length >= 5 ) {
+                this.receiveSnapshot( bytes );
+            }
+        }
+
+        /**
+         * Rebuilds and acknowledges a snapshot frame: 'F' version payload, or
+         * 'D' version base delta.
+         */
+        receiveSnapshot( bytes ) {
+            const view = new DataView( bytes.buffer, bytes.byteOffset, bytes.byteLength );
+            const kind = String.fromCharCode( bytes[0] );
+            const version = view.getUint32( 1 );
+            let snapshot = null;
+
+            if ( kind === 'F' ) {
+                snapshot = bytes.slice( 5 );
+            }
+            else if ( kind === 'D' && bytes.length >= 9 ) {
+                const base = this.versions.get( view.getUint32( 5 ));
+                if ( base )
+                    snapshot = applyDelta( base, bytes, 9 );
+
+                // The server never goes back to older bases than this one
+                for ( const v of this.versions.keys() )
+                    if ( v < view.getUint32( 5 ))
+                        this.versions.delete( v );
+            }
+
+            if ( snapshot === null ) {
+                console.warn( 'lwsdk: cannot rebuild snapshot ' + version );
+                return;
+            }
+
+            this.versions.set( version, snapshot );
+            this.version = version;
+
+            // The server keeps no more bases than this either
+            while ( this.versions.size > MAX_SNAPSHOTS )
+                this.versions.delete( this.versions.keys().next().value );
+
+            const ack = new Uint8Array( 5 );
+            ack[0] = 'A'.charCodeAt( 0 );
+            new DataView( ack.buffer ).setUint32( 1, version );
+            this.ws.send( ack );
+
+            this.handlers.onSnapshot && this.handlers.onSnapshot( decoder.decode( snapshot ), version );
+        }
+    }
+
+    LwsdkClient.applyDelta = applyDelta;
+    LwsdkClient.unpackBatch = unpackBatch;
+
+    if ( typeof module !== 'undefined' && module.exports )
+        module.exports = LwsdkClient;
+    else
+        global.LwsdkClient = LwsdkClient;
+
+})( typeof window !== 'undefined' ? window : this );
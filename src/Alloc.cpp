@@ -0,0 +1,399 @@
+/********************************************************************************
+ *  This file is part of the lopezworks SDK utility library for C/C++ (lwsdk).
+ *
+ *  Copyright (C) 2015-2017 Edwin R. Lopez
+ *  http://www.lopezworks.info
+ *
+ *  This source code is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation LGPL v2.1
+ *  (http://www.gnu.org/licenses/).
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ *  02110-1301  USA.
+ ********************************************************************************/
+#include "Alloc.h"
+#include "Metrics.h"
+
+#include <new>
+#include <mutex>
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <unistd.h>
+
+#define LOGGER_ENABLED 0   // turn off verbose logging
+#include "Logger.h"
+
+using namespace std;
+
+namespace lwsdk
+{
+    #define MAX_SUBSYSTEMS      64
+    #define SUBSYSTEM_NAME_LEN  32
+
+    /**
+     * Counters of a subsystem. Slots live in a fixed array with fixed-size names so neither
+     * counting nor registering a subsystem allocates.
+     */
+    struct SubsystemSlot
+    {
+        char                  name[ SUBSYSTEM_NAME_LEN ];
+        atomic<uint64_t>      allocations;
+        atomic<uint64_t>      frees;
+        atomic<uint64_t>      bytes;
+        atomic<int64_t>       liveBytes;
+    };
+
+    /**
+     * Header placed before every tracked block, recording what is needed to free it and
+     * credit the right subsystem.
+     */
+    struct alignas( 16 ) BlockHeader
+    {
+        uint64_t size;
+        void     (*release)( void *ptr );  // hook that frees the block
+        uint32_t slot;                     // subsystem that allocated the block
+        uint32_t offset;                   // distance from the start of the raw allocation
+    };
+
+    // Slot 0 is "app", for threads not owned by the library
+    static SubsystemSlot slots[ MAX_SUBSYSTEMS ];
+    static atomic<int> slotCount{1};
+    static mutex slotsMutex;
+
+    static atomic<void *(*)( size_t )> allocateHook{ malloc };
+    static atomic<void (*)( void* )>   releaseHook{ free };
+
+    // Per-thread state, all trivially destructible so it stays usable while threads exit
+    static thread_local int         currentSlot = 0;
+    static thread_local uint64_t    threadCount = 0;
+    static thread_local const char *noAllocName = nullptr;
+    static thread_local bool        noAllocAbort = false;
+
+
+    /**
+     * Registers the subsystem's counters as "alloc" gauges, so they are exported along
+     * with the other metrics.
+     */
+    static void exportMetrics( int index )
+    {
+        SubsystemSlot *slot = &slots[ index ];
+        string instance = (index == 0) ? "app" : slot->name;
+
+        Metrics::gaugeFunction( "alloc", "allocations", instance, [slot] { return (double) slot->allocations.load(); } );
+        Metrics::gaugeFunction( "alloc", "frees", instance, [slot] { return (double) slot->frees.load(); } );
+        Metrics::gaugeFunction( "alloc", "bytes", instance, [slot] { return (double) slot->bytes.load(); } );
+        Metrics::gaugeFunction( "alloc", "live_bytes", instance, [slot] { return (double) slot->liveBytes.load(); } );
+    }
+
+
+    /**
+     * Returns the slot index for the given subsystem, registering it if needed; returns the
+     * "app" slot when all slots are taken.
+     */
+    static int slotFor( const string& subsystem )
+    {
+        int index;
+
+        {
+            lock_guard lock( slotsMutex );
+            int n = slotCount.load();
+
+            for ( index = 1; index < n; index++ )
+            {
+                if ( strncmp( slots[ index ].name, subsystem.c_str(), SUBSYSTEM_NAME_LEN - 1 ) == 0 )
+                    return index;
+            }
+
+            if ( n == MAX_SUBSYSTEMS )
+                return 0;
+
+            strncpy( slots[ index ].name, subsystem.c_str(), SUBSYSTEM_NAME_LEN - 1 );
+            slotCount = n + 1;
+        }
+
+        // Outside the lock, registering allocates
+        static once_flag appExported;
+        call_once( appExported, [] { exportMetrics( 0 ); } );
+        exportMetrics( index );
+
+        return index;
+    }
+
+
+    /**
+     * Reports an allocation made inside a NoAllocScope that asked to abort, without
+     * allocating, and aborts.
+     */
+    [[noreturn]] static void failNoAlloc()
+    {
+        const char *name = noAllocName;
+        noAllocName = nullptr;
+
+        static const char prefix[] = "lwsdk: allocation inside NoAllocScope \"";
+        ::write( STDERR_FILENO, prefix, sizeof( prefix ) - 1 );
+        ::write( STDERR_FILENO, name, strlen( name ));
+        ::write( STDERR_FILENO, "\"\n", 2 );
+
+        abort();
+    }
+
+
+    /**
+     * Allocates a tracked block, returns null if the allocation hook fails.
+     */
+    static void* trackedAllocate( size_t size, size_t alignment )
+    {
+        if ( noAllocName != nullptr && noAllocAbort )
+            failNoAlloc();
+
+        // malloc() style hooks return blocks suitable for any fundamental alignment
+        size_t extra = (alignment > alignof( max_align_t )) ? alignment : 0;
+        void *(*allocate)( size_t ) = allocateHook.load( memory_order_relaxed );
+
+        char *raw = (char *) allocate( size + sizeof( BlockHeader ) + extra );
+        if ( raw == nullptr )
+            return nullptr;
+
+        uintptr_t user = (uintptr_t) raw + sizeof( BlockHeader );
+        if ( extra > 0 )
+            user = (user + alignment - 1) & ~(uintptr_t) (alignment - 1);
+
+        BlockHeader *header = (BlockHeader *) user - 1;
+        header->size = size;
+        header->release = releaseHook.load( memory_order_relaxed );
+        header->slot = (uint32_t) currentSlot;
+        header->offset = (uint32_t) (user - (uintptr_t) raw);
+
+        SubsystemSlot& slot = slots[ header->slot ];
+        slot.allocations.fetch_add( 1, memory_order_relaxed );
+        slot.bytes.fetch_add( size, memory_order_relaxed );
+        slot.liveBytes.fetch_add( (int64_t) size, memory_order_relaxed );
+        threadCount++;
+
+        return (void *) user;
+    }
+
+
+    /**
+     * Frees a block returned by trackedAllocate().
+     */
+    static void trackedRelease( void *ptr )
+    {
+        if ( ptr == nullptr )
+            return;
+
+        BlockHeader *header = (BlockHeader *) ptr - 1;
+
+        SubsystemSlot& slot = slots[ header->slot ];
+        slot.frees.fetch_add( 1, memory_order_relaxed );
+        slot.liveBytes.fetch_sub( (int64_t) header->size, memory_order_relaxed );
+
+        header->release( (char *) ptr - header->offset );
+    }
+
+
+#ifdef LWSDK_TRACK_ALLOCATIONS
+
+    /**
+     * operator new semantics: retries through the new handler, throws bad_alloc if there
+     * is none.
+     */
+    static void* trackedNew( size_t size, size_t alignment )
+    {
+        if ( size == 0 )
+            size = 1;
+
+        while ( true )
+        {
+            void *ptr = trackedAllocate( size, alignment );
+            if ( ptr != nullptr )
+                return ptr;
+
+            new_handler handler = get_new_handler();
+            if ( handler == nullptr )
+                throw bad_alloc();
+
+            handler();
+        }
+    }
+
+#endif
+
+
+    bool Alloc::isEnabled()
+    {
+#ifdef LWSDK_TRACK_ALLOCATIONS
+        return true;
+#else
+        return false;
+#endif
+    }
+
+
+    void Alloc::setHooks( const AllocHooks& hooks )
+    {
+        if ( hooks.allocate == nullptr || hooks.release == nullptr )
+            return;
+
+        allocateHook = hooks.allocate;
+        releaseHook = hooks.release;
+    }
+
+
+    void Alloc::setThreadSubsystem( const string& subsystem )
+    {
+        if ( isEnabled() )
+            currentSlot = slotFor( subsystem );
+    }
+
+
+    vector<AllocStats> Alloc::getStats()
+    {
+        vector<AllocStats> stats;
+
+        if ( !isEnabled() )
+            return stats;
+
+        int n = slotCount.load();
+
+        for ( int i = 0; i < n; i++ )
+        {
+            const SubsystemSlot& slot = slots[i];
+
+            if ( slot.allocations.load() == 0 )
+                continue;
+
+            AllocStats s;
+            s.subsystem = (i == 0) ? "app" : slot.name;
+            s.allocations = slot.allocations.load();
+            s.frees = slot.frees.load();
+            s.bytes = slot.bytes.load();
+            s.liveBytes = slot.liveBytes.load();
+            stats.push_back( s );
+        }
+
+        return stats;
+    }
+
+
+    uint64_t Alloc::threadAllocations()
+    {
+        return threadCount;
+    }
+
+
+    void* Alloc::reallocate( void *ptr, size_t size )
+    {
+        if ( size == 0 )
+        {
+            trackedRelease( ptr );
+            return nullptr;
+        }
+
+        void *newPtr = trackedAllocate( size, alignof( max_align_t ));
+
+        if ( ptr != nullptr && newPtr != nullptr )
+        {
+            memcpy( newPtr, ptr, min( size, (size_t) ((BlockHeader *) ptr - 1)->size ));
+            trackedRelease( ptr );
+        }
+
+        return newPtr;
+    }
+
+
+    // Class AllocScope
+    AllocScope::AllocScope( const string& subsystem ) : previous( currentSlot )
+    {
+        Alloc::setThreadSubsystem( subsystem );
+    }
+
+
+    AllocScope::~AllocScope()
+    {
+        currentSlot = previous;
+    }
+
+
+    // Class NoAllocScope
+    NoAllocScope::NoAllocScope( const char *name, bool abortOnAlloc )
+            : startCount( threadCount ), previousName( noAllocName ), previousAbort( noAllocAbort )
+    {
+        noAllocName = name;
+        noAllocAbort = abortOnAlloc;
+    }
+
+
+    NoAllocScope::~NoAllocScope()
+    {
+        noAllocName = previousName;
+        noAllocAbort = previousAbort;
+    }
+
+
+    uint64_t NoAllocScope::allocations() const
+    {
+        return threadCount - startCount;
+    }
+
+} // ns
+
+
+#ifdef LWSDK_TRACK_ALLOCATIONS
+
+// Replacements of the global allocation functions, routing all allocations in the process
+// through the tracked allocator
+using lwsdk::trackedNew;
+using lwsdk::trackedAllocate;
+using lwsdk::trackedRelease;
+
+static const size_t DEFAULT_ALIGNMENT = alignof( max_align_t );
+
+LWSDK_API void* operator new( size_t size )                 { return trackedNew( size, DEFAULT_ALIGNMENT ); }
+LWSDK_API void* operator new[]( size_t size )               { return trackedNew( size, DEFAULT_ALIGNMENT ); }
+LWSDK_API void* operator new( size_t size, align_val_t al ) { return trackedNew( size, (size_t) al ); }
+LWSDK_API void* operator new[]( size_t size, align_val_t al ) { return trackedNew( size, (size_t) al ); }
+
+LWSDK_API void* operator new( size_t size, const nothrow_t& ) noexcept
+{
+    try { return trackedNew( size, DEFAULT_ALIGNMENT ); } catch ( ... ) { return nullptr; }
+}
+
+LWSDK_API void* operator new[]( size_t size, const nothrow_t& ) noexcept
+{
+    try { return trackedNew( size, DEFAULT_ALIGNMENT ); } catch ( ... ) { return nullptr; }
+}
+
+LWSDK_API void* operator new( size_t size, align_val_t al, const nothrow_t& ) noexcept
+{
+    try { return trackedNew( size, (size_t) al ); } catch ( ... ) { return nullptr; }
+}
+
+LWSDK_API void* operator new[]( size_t size, align_val_t al, const nothrow_t& ) noexcept
+{
+    try { return trackedNew( size, (size_t) al ); } catch ( ... ) { return nullptr; }
+}
+
+LWSDK_API void operator delete( void *ptr ) noexcept                                   { trackedRelease( ptr ); }
+LWSDK_API void operator delete[]( void *ptr ) noexcept                                 { trackedRelease( ptr ); }
+LWSDK_API void operator delete( void *ptr, size_t ) noexcept                           { trackedRelease( ptr ); }
+LWSDK_API void operator delete[]( void *ptr, size_t ) noexcept                         { trackedRelease( ptr ); }
+LWSDK_API void operator delete( void *ptr, align_val_t ) noexcept                      { trackedRelease( ptr ); }
+LWSDK_API void operator delete[]( void *ptr, align_val_t ) noexcept                    { trackedRelease( ptr ); }
+LWSDK_API void operator delete( void *ptr, size_t, align_val_t ) noexcept              { trackedRelease( ptr ); }
+LWSDK_API void operator delete[]( void *ptr, size_t, align_val_t ) noexcept            { trackedRelease( ptr ); }
+LWSDK_API void operator delete( void *ptr, const nothrow_t& ) noexcept                 { trackedRelease( ptr ); }
+LWSDK_API void operator delete[]( void *ptr, const nothrow_t& ) noexcept               { trackedRelease( ptr ); }
+LWSDK_API void operator delete( void *ptr, align_val_t, const nothrow_t& ) noexcept    { trackedRelease( ptr ); }
+LWSDK_API void operator delete[]( void *ptr, align_val_t, const nothrow_t& ) noexcept  { trackedRelease( ptr ); }
+
+#endif
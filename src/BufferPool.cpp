@@ -0,0 +1,531 @@
+/********************************************************************************
+ *  This file is part of the lopezworks SDK utility library for C/C++ (lwsdk).
+ *
+ *  Copyright (C) 2015-2017 Edwin R. Lopez
+ *  http://www.lopezworks.info
+ *
+ *  This source code is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation LGPL v2.1
+ *  (http://www.gnu.org/licenses/).
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ *  02110-1301  USA.
+ ********************************************************************************/
+#include "BufferPool.h"
+
+#include <mutex>
+#include <vector>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+
+#define LOGGER_ENABLED 0   // turn off verbose logging
+#include "Logger.h"
+
+using namespace std;
+
+namespace lwsdk
+{
+    #define MIN_CLASS_BITS   6                                  // smallest size class, 64 bytes
+    #define MAX_CLASS_BITS   16                                 // largest size class, 64 KB
+    #define SIZE_CLASSES     (MAX_CLASS_BITS - MIN_CLASS_BITS + 1)
+    #define CACHE_BYTES      (256 * 1024)                       // per-thread cache budget for each size class
+    #define CACHE_MAX_COUNT  64                                 // per-thread cache limit for small size classes
+    #define CACHE_MIN_COUNT  4                                  // per-thread cache limit for large size classes
+
+    /**
+     * Per-thread cache; counters are only written by the owner thread, read by getStats().
+     */
+    struct ThreadCache
+    {
+        vector<BufferBlock*> freeLists[ SIZE_CLASSES ];
+        atomic<uint64_t> acquired{0};
+        atomic<uint64_t> hits{0};
+        atomic<uint64_t> misses{0};
+        atomic<uint64_t> bytesHeld{0};
+        atomic<int64_t>  bytesInUse{0};    // may go negative, blocks are often released by another thread
+
+        ThreadCache();
+        ~ThreadCache();
+    };
+
+    /**
+     * Shared per-class free lists, refilled with the thread caches' overflow.
+     */
+    struct SharedPool
+    {
+        mutex mtx;
+        vector<BufferBlock*> freeLists[ SIZE_CLASSES ];
+        size_t maxBytesHeld{ 16 * 1024 * 1024 };
+
+        // Live thread caches, for stats aggregation
+        mutex cachesMutex;
+        vector<ThreadCache*> caches;
+
+        // Shared lists' bytes, plus totals of exited threads
+        atomic<uint64_t> acquired{0};
+        atomic<uint64_t> hits{0};
+        atomic<uint64_t> misses{0};
+        atomic<uint64_t> bytesHeld{0};
+        atomic<int64_t>  bytesInUse{0};
+    };
+
+    // Intentionally never deleted, thread caches may flush into it during process exit
+    static SharedPool& sharedPool()
+    {
+        static SharedPool *pool = new SharedPool();
+        return *pool;
+    }
+
+    // 0: not created yet, 1: alive, 2: destroyed (thread exiting)
+    static thread_local int threadCacheState = 0;
+    static thread_local ThreadCache threadCache;
+
+
+    /**
+     * Returns the size class able to hold the given capacity, -1 if too large to be pooled.
+     */
+    static int sizeClassOf( size_t capacity )
+    {
+        int bits = MIN_CLASS_BITS;
+
+        while ( bits <= MAX_CLASS_BITS && ((size_t) 1 << bits) < capacity )
+            bits++;
+
+        return bits <= MAX_CLASS_BITS ? bits - MIN_CLASS_BITS : -1;
+    }
+
+    static size_t classCapacity( int sizeClass )
+    {
+        return (size_t) 1 << (sizeClass + MIN_CLASS_BITS);
+    }
+
+    static size_t cacheLimit( int sizeClass )
+    {
+        size_t n = CACHE_BYTES / classCapacity( sizeClass );
+        return n < CACHE_MIN_COUNT ? CACHE_MIN_COUNT : n > CACHE_MAX_COUNT ? CACHE_MAX_COUNT : n;
+    }
+
+    template <typename T> static inline void addRelaxed( atomic<T>& counter, int64_t delta )
+    {
+        // Single writer, a plain load/store pair is enough and avoids a locked instruction
+        counter.store( counter.load( memory_order_relaxed ) + delta, memory_order_relaxed );
+    }
+
+    static ThreadCache* getThreadCache()
+    {
+        if ( threadCacheState == 2 )
+            return nullptr;
+
+        return &threadCache;
+    }
+
+
+    ThreadCache::ThreadCache()
+    {
+        SharedPool& pool = sharedPool();
+
+        threadCacheState = 1;
+
+        lock_guard lock( pool.cachesMutex );
+        pool.caches.push_back( this );
+    }
+
+
+    ThreadCache::~ThreadCache()
+    {
+        SharedPool& pool = sharedPool();
+
+        // Hand cached blocks and counters over to the shared pool; cachesMutex is held
+        // throughout so getStats() never sees them twice or not at all
+        lock_guard lock( pool.cachesMutex );
+
+        for ( auto it = pool.caches.begin(); it != pool.caches.end(); ++it )
+        {
+            if ( *it == this )
+            {
+                pool.caches.erase( it );
+                break;
+            }
+        }
+
+        {
+            lock_guard lock2( pool.mtx );
+
+            for ( int c = 0; c < SIZE_CLASSES; c++ )
+            {
+                for ( BufferBlock *block : freeLists[c] )
+                    pool.freeLists[c].push_back( block );
+            }
+
+            pool.bytesHeld += bytesHeld.load();
+        }
+
+        pool.acquired += acquired.load();
+        pool.hits += hits.load();
+        pool.misses += misses.load();
+        pool.bytesInUse += bytesInUse.load();
+
+        threadCacheState = 2;
+    }
+
+
+    /**
+     * Releases a block whose reference count dropped to 0.
+     */
+    static void releaseBlock( BufferBlock *block )
+    {
+        SharedPool& pool = sharedPool();
+        ThreadCache *cache = getThreadCache();
+        int c = block->sizeClass;
+        size_t bytes = block->capacity;
+
+        if ( cache != nullptr )
+            addRelaxed( cache->bytesInUse, -(int64_t) bytes );
+        else
+            pool.bytesInUse -= (int64_t) bytes;
+
+        if ( c < 0 )
+        {
+            block->~BufferBlock();
+            free( block );
+            return;
+        }
+
+        if ( cache != nullptr && cache->freeLists[c].size() < cacheLimit( c ) )
+        {
+            cache->freeLists[c].push_back( block );
+            addRelaxed( cache->bytesHeld, (int64_t) bytes );
+            return;
+        }
+
+        {
+            lock_guard lock( pool.mtx );
+
+            // Move half of the full thread cache to the shared list in one go
+            if ( cache != nullptr )
+            {
+                size_t half = cache->freeLists[c].size() / 2;
+                for ( size_t i = 0; i < half; i++ )
+                {
+                    pool.freeLists[c].push_back( cache->freeLists[c].back() );
+                    cache->freeLists[c].pop_back();
+                }
+
+                addRelaxed( cache->bytesHeld, -(int64_t) (half * bytes) );
+                pool.bytesHeld += half * bytes;
+
+                cache->freeLists[c].push_back( block );
+                addRelaxed( cache->bytesHeld, (int64_t) bytes );
+                block = nullptr;
+            }
+            else if ( pool.bytesHeld + bytes <= pool.maxBytesHeld )
+            {
+                pool.freeLists[c].push_back( block );
+                pool.bytesHeld += bytes;
+                block = nullptr;
+            }
+
+            // Enforce the shared pool limit
+            while ( pool.bytesHeld > pool.maxBytesHeld && !pool.freeLists[c].empty() )
+            {
+                BufferBlock *b = pool.freeLists[c].back();
+                pool.freeLists[c].pop_back();
+                pool.bytesHeld -= bytes;
+                b->~BufferBlock();
+                free( b );
+            }
+        }
+
+        if ( block != nullptr )
+        {
+            block->~BufferBlock();
+            free( block );
+        }
+    }
+
+
+    //
+    // ================================================ PooledBuffer ========================================================
+    //
+
+    PooledBuffer::PooledBuffer( const PooledBuffer& other ) noexcept : block( other.block )
+    {
+        if ( block )
+            block->refs.fetch_add( 1, memory_order_relaxed );
+    }
+
+
+    PooledBuffer::PooledBuffer( PooledBuffer&& other ) noexcept : block( other.block )
+    {
+        other.block = nullptr;
+    }
+
+
+    PooledBuffer& PooledBuffer::operator=( const PooledBuffer& other ) noexcept
+    {
+        if ( block != other.block )
+        {
+            if ( other.block )
+                other.block->refs.fetch_add( 1, memory_order_relaxed );
+
+            reset();
+            block = other.block;
+        }
+
+        return *this;
+    }
+
+
+    PooledBuffer& PooledBuffer::operator=( PooledBuffer&& other ) noexcept
+    {
+        if ( this != &other )
+        {
+            reset();
+            block = other.block;
+            other.block = nullptr;
+        }
+
+        return *this;
+    }
+
+
+    PooledBuffer::~PooledBuffer()
+    {
+        reset();
+    }
+
+
+    void PooledBuffer::reset()
+    {
+        if ( block && block->refs.fetch_sub( 1, memory_order_acq_rel ) == 1 )
+            releaseBlock( block );
+
+        block = nullptr;
+    }
+
+
+    void PooledBuffer::resize( size_t len )
+    {
+        if ( len > capacity() )
+            grow( len );
+
+        if ( block )
+            block->length = (uint32_t) len;
+    }
+
+
+    void PooledBuffer::append( const void *bytes, size_t len )
+    {
+        if ( len == 0 )
+            return;
+
+        size_t used = size();
+
+        if ( used + len > capacity() )
+            grow( used + len );
+
+        memcpy( block->data() + used, bytes, len );
+        block->length = (uint32_t) (used + len);
+    }
+
+
+    /**
+     * Moves the data to a buffer at least twice as large, or minCapacity if larger.
+     */
+    void PooledBuffer::grow( size_t minCapacity )
+    {
+        size_t newCapacity = capacity() * 2;
+        if ( newCapacity < minCapacity )
+            newCapacity = minCapacity;
+
+        PooledBuffer larger = BufferPool::acquire( newCapacity );
+
+        if ( block && block->length > 0 )
+        {
+            memcpy( larger.block->data(), block->data(), block->length );
+            larger.block->length = block->length;
+        }
+
+        *this = std::move( larger );
+    }
+
+
+    //
+    // ================================================ BufferPool ==========================================================
+    //
+
+    PooledBuffer BufferPool::acquire( size_t capacity )
+    {
+        SharedPool& pool = sharedPool();
+        ThreadCache *cache = getThreadCache();
+        int c = sizeClassOf( capacity );
+        BufferBlock *block = nullptr;
+
+        if ( cache != nullptr )
+            addRelaxed( cache->acquired, 1 );
+        else
+            pool.acquired++;
+
+        if ( c >= 0 )
+        {
+            size_t bytes = classCapacity( c );
+
+            if ( cache != nullptr && !cache->freeLists[c].empty() )
+            {
+                block = cache->freeLists[c].back();
+                cache->freeLists[c].pop_back();
+                addRelaxed( cache->bytesHeld, -(int64_t) bytes );
+            }
+            else
+            {
+                lock_guard lock( pool.mtx );
+
+                // Refill the thread cache with up to half its limit in one go
+                size_t refill = cache != nullptr ? cacheLimit( c ) / 2 : 0;
+
+                if ( !pool.freeLists[c].empty() )
+                {
+                    block = pool.freeLists[c].back();
+                    pool.freeLists[c].pop_back();
+                    pool.bytesHeld -= bytes;
+                }
+
+                while ( block != nullptr && refill-- > 0 && !pool.freeLists[c].empty() )
+                {
+                    cache->freeLists[c].push_back( pool.freeLists[c].back() );
+                    pool.freeLists[c].pop_back();
+                    pool.bytesHeld -= bytes;
+                    addRelaxed( cache->bytesHeld, (int64_t) bytes );
+                }
+            }
+
+            capacity = bytes;
+        }
+
+        if ( block != nullptr )
+        {
+            if ( cache != nullptr )
+                addRelaxed( cache->hits, 1 );
+            else
+                pool.hits++;
+
+            block->refs.store( 1, memory_order_relaxed );
+            block->length = 0;
+        }
+        else
+        {
+            if ( cache != nullptr )
+                addRelaxed( cache->misses, 1 );
+            else
+                pool.misses++;
+
+            void *mem = malloc( sizeof( BufferBlock ) + capacity );
+            if ( mem == nullptr )
+                throw std::bad_alloc();
+
+            block = new (mem) BufferBlock();
+            block->capacity = (uint32_t) capacity;
+            block->sizeClass = c;
+        }
+
+        if ( cache != nullptr )
+            addRelaxed( cache->bytesInUse, (int64_t) block->capacity );
+        else
+            pool.bytesInUse += (int64_t) block->capacity;
+
+        return PooledBuffer( block );
+    }
+
+
+    PooledBuffer BufferPool::copyOf( const void *bytes, size_t len )
+    {
+        PooledBuffer buffer = acquire( len );
+        buffer.append( bytes, len );
+        return buffer;
+    }
+
+
+    void BufferPool::setMaxBytesHeld( size_t maxBytes )
+    {
+        SharedPool& pool = sharedPool();
+        lock_guard lock( pool.mtx );
+        pool.maxBytesHeld = maxBytes;
+    }
+
+
+    void BufferPool::trim()
+    {
+        SharedPool& pool = sharedPool();
+        ThreadCache *cache = getThreadCache();
+        vector<BufferBlock*> blocks;
+
+        if ( cache != nullptr )
+        {
+            for ( auto& list : cache->freeLists )
+            {
+                blocks.insert( blocks.end(), list.begin(), list.end() );
+                list.clear();
+            }
+
+            cache->bytesHeld.store( 0, memory_order_relaxed );
+        }
+
+        {
+            lock_guard lock( pool.mtx );
+
+            for ( auto& list : pool.freeLists )
+            {
+                blocks.insert( blocks.end(), list.begin(), list.end() );
+                list.clear();
+            }
+
+            pool.bytesHeld = 0;
+        }
+
+        for ( BufferBlock *block : blocks )
+        {
+            block->~BufferBlock();
+            free( block );
+        }
+    }
+
+
+    BufferPoolStats BufferPool::getStats()
+    {
+        SharedPool& pool = sharedPool();
+        BufferPoolStats stats;
+
+        int64_t bytesInUse;
+
+        lock_guard lock( pool.cachesMutex );
+
+        stats.acquired = pool.acquired.load();
+        stats.hits = pool.hits.load();
+        stats.misses = pool.misses.load();
+        stats.bytesHeld = pool.bytesHeld.load();
+        bytesInUse = pool.bytesInUse.load();
+
+        for ( ThreadCache *cache : pool.caches )
+        {
+            stats.acquired += cache->acquired.load( memory_order_relaxed );
+            stats.hits += cache->hits.load( memory_order_relaxed );
+            stats.misses += cache->misses.load( memory_order_relaxed );
+            stats.bytesHeld += cache->bytesHeld.load( memory_order_relaxed );
+            bytesInUse += cache->bytesInUse.load( memory_order_relaxed );
+        }
+
+        stats.bytesInUse = (uint64_t) max<int64_t>( 0, bytesInUse );
+
+        return stats;
+    }
+
+} // ns
@@ -0,0 +1,674 @@
+/********************************************************************************
+ *  This file is part of the lopezworks SDK utility library for C/C++ (lwsdk).
+ *
+ *  Copyright (C) 2015-2017 Edwin R. Lopez
+ *  http://www.lopezworks.info
+ *
+ *  This source code is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation LGPL v2.1
+ *  (http://www.gnu.org/licenses/).
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ *  02110-1301  USA.
+ ********************************************************************************/
+#include "Codecs.h"
+
+#include <cmath>
+#include <cstring>
+
+#define LOGGER_ENABLED 0   // turn off verbose logging
+#include "Logger.h"
+
+using namespace std;
+
+namespace lwsdk
+{
+    #define MAX_DEPTH 512
+
+    /**
+     * Appends the low n bytes of a number, big-endian.
+     */
+    static void putBE( PooledBuffer& out, uint64_t value, int n )
+    {
+        uint8_t b[8];
+        for ( int i = n - 1; i >= 0; i--, value >>= 8 )
+            b[i] = (uint8_t) value;
+
+        out.append( b, n );
+    }
+
+
+    /**
+     * Appends a one-byte marker followed by a float or double, big-endian; the float is
+     * used when it holds the exact value.
+     */
+    static void putFloat( PooledBuffer& out, double d, uint8_t floatMarker, uint8_t doubleMarker )
+    {
+        float f = (float) d;
+
+        if ( (double) f == d || isnan( d ) )
+        {
+            uint32_t bits;
+            memcpy( &bits, &f, 4 );
+            out.append( &floatMarker, 1 );
+            putBE( out, bits, 4 );
+        }
+        else
+        {
+            uint64_t bits;
+            memcpy( &bits, &d, 8 );
+            out.append( &doubleMarker, 1 );
+            putBE( out, bits, 8 );
+        }
+    }
+
+
+    /**
+     * Bounds-checked reader over binary input.
+     */
+    struct ByteReader
+    {
+        const uint8_t *p;
+        const uint8_t *end;
+        int depth{0};
+
+        explicit ByteReader( string_view data ) :
+                p( (const uint8_t *) data.data() ), end( p + data.size() ) {}
+
+        size_t remaining() const { return end - p; }
+
+        bool readBE( int n, uint64_t& value )
+        {
+            if ( remaining() < (size_t) n )
+                return false;
+
+            value = 0;
+            for ( int i = 0; i < n; i++ )
+                value = (value << 8) | *p++;
+
+            return true;
+        }
+
+        bool readString( uint64_t len, string& s )
+        {
+            if ( len > remaining() )
+                return false;
+
+            s.append( (const char *) p, len );
+            p += len;
+            return true;
+        }
+
+        static double toFloat( uint64_t bits )
+        {
+            float f;
+            uint32_t b = (uint32_t) bits;
+            memcpy( &f, &b, 4 );
+            return f;
+        }
+
+        static double toDouble( uint64_t bits )
+        {
+            double d;
+            memcpy( &d, &bits, 8 );
+            return d;
+        }
+    };
+
+
+    void encode( Codec codec, const Json::Value& value, PooledBuffer& out )
+    {
+        switch ( codec )
+        {
+            case Codec::Json:    Json::write( value, out ); break;
+            case Codec::Cbor:    Cbor::encode( value, out ); break;
+            case Codec::MsgPack: MsgPack::encode( value, out ); break;
+        }
+    }
+
+
+    Expected<Json::Value> decode( Codec codec, string_view data )
+    {
+        switch ( codec )
+        {
+            case Codec::Cbor:    return Cbor::decode( data );
+            case Codec::MsgPack: return MsgPack::decode( data );
+            default:             return Json::parse( data );
+        }
+    }
+
+} // ns
+
+
+namespace lwsdk::Cbor
+{
+    enum Major { UINT, NEGINT, BYTES, TEXT, ARRAY, MAP, TAG, SIMPLE };
+
+    static const uint8_t BREAK = 0xFF;
+
+    /**
+     * Appends an item head: major type and argument in the shortest form.
+     */
+    static void putHead( PooledBuffer& out, int major, uint64_t arg )
+    {
+        uint8_t mt = (uint8_t) (major << 5);
+
+        if ( arg < 24 )
+        {
+            uint8_t b = mt | (uint8_t) arg;
+            out.append( &b, 1 );
+            return;
+        }
+
+        int n = arg <= 0xFF ? 1 : arg <= 0xFFFF ? 2 : arg <= 0xFFFFFFFF ? 4 : 8;
+        uint8_t b = mt | (uint8_t) (n == 1 ? 24 : n == 2 ? 25 : n == 4 ? 26 : 27);
+        out.append( &b, 1 );
+        putBE( out, arg, n );
+    }
+
+
+    void encode( const Json::Value& value, PooledBuffer& out )
+    {
+        switch ( value.type() )
+        {
+            case Json::Type::Null:
+                putHead( out, SIMPLE, 22 );
+                break;
+
+            case Json::Type::Bool:
+                putHead( out, SIMPLE, value.asBool() ? 21 : 20 );
+                break;
+
+            case Json::Type::Int:
+            {
+                int64_t n = value.asInt();
+                if ( n >= 0 )
+                    putHead( out, UINT, (uint64_t) n );
+                else
+                    putHead( out, NEGINT, (uint64_t) -(n + 1) );
+                break;
+            }
+
+            case Json::Type::Double:
+                putFloat( out, value.asDouble(), 0xFA, 0xFB );
+                break;
+
+            case Json::Type::String:
+            {
+                const string& s = value.asString();
+                putHead( out, TEXT, s.size() );
+                out.append( s.data(), s.size() );
+                break;
+            }
+
+            case Json::Type::Array:
+                putHead( out, ARRAY, value.size() );
+                for ( auto& element : value.elements() )
+                    encode( element, out );
+                break;
+
+            case Json::Type::Object:
+                putHead( out, MAP, value.size() );
+                for ( auto& member : value.members() )
+                {
+                    putHead( out, TEXT, member.first.size() );
+                    out.append( member.first.data(), member.first.size() );
+                    encode( member.second, out );
+                }
+                break;
+        }
+    }
+
+
+    /**
+     * Reads an item head. Sets info to the additional information bits, and arg to the
+     * argument; indefinite is set for additional information 31.
+     */
+    static bool readHead( ByteReader& in, int& major, int& info, uint64_t& arg, bool& indefinite )
+    {
+        if ( in.remaining() < 1 )
+            return false;
+
+        uint8_t b = *in.p++;
+        major = b >> 5;
+        info = b & 0x1F;
+        indefinite = false;
+        arg = info;
+
+        if ( info < 24 )
+            return true;
+
+        if ( info <= 27 )
+            return in.readBE( 1 << (info - 24), arg );
+
+        // 28..30 are reserved; breaks are consumed by the enclosing item
+        indefinite = (info == 31 && major >= BYTES && major <= MAP);
+        return indefinite;
+    }
+
+
+    static bool atBreak( ByteReader& in )
+    {
+        if ( in.remaining() > 0 && *in.p == BREAK )
+        {
+            in.p++;
+            return true;
+        }
+
+        return false;
+    }
+
+
+    static double halfToDouble( uint16_t h )
+    {
+        int exp = (h >> 10) & 0x1F;
+        int mant = h & 0x3FF;
+        double d;
+
+        if ( exp == 0 )
+            d = ldexp( mant, -24 );
+        else if ( exp != 31 )
+            d = ldexp( mant + 1024, exp - 25 );
+        else
+            d = mant == 0 ? INFINITY : NAN;
+
+        return (h & 0x8000) ? -d : d;
+    }
+
+
+    static bool decodeItem( ByteReader& in, Json::Value& v )
+    {
+        int major, info;
+        uint64_t arg;
+        bool indefinite;
+
+        if ( !readHead( in, major, info, arg, indefinite ) )
+            return false;
+
+        switch ( major )
+        {
+            case UINT:
+                v = arg > INT64_MAX ? Json::Value( (double) arg ) : Json::Value( (int64_t) arg );
+                return true;
+
+            case NEGINT:
+                v = arg > INT64_MAX ? Json::Value( -1.0 - (double) arg ) : Json::Value( -1 - (int64_t) arg );
+                return true;
+
+            case BYTES:
+            case TEXT:
+            {
+                string s;
+
+                if ( !indefinite )
+                {
+                    if ( !in.readString( arg, s ) )
+                        return false;
+                }
+                else
+                {
+                    // Chunks are definite-length strings of the same major type
+                    while ( !atBreak( in ) )
+                    {
+                        int chunkMajor, chunkInfo;
+                        bool chunkIndefinite;
+
+                        if ( !readHead( in, chunkMajor, chunkInfo, arg, chunkIndefinite ) ||
+                             chunkMajor != major || chunkIndefinite || !in.readString( arg, s ) )
+                            return false;
+                    }
+                }
+
+                v = Json::Value( std::move( s ));
+                return true;
+            }
+
+            case ARRAY:
+            {
+                if ( ++in.depth > MAX_DEPTH || (!indefinite && arg > in.remaining()) )
+                    return false;
+
+                v = Json::Value::array();
+                Json::Elements& elements = v.elements();
+
+                for ( uint64_t i = 0; indefinite ? !atBreak( in ) : i < arg; i++ )
+                {
+                    elements.emplace_back();
+                    if ( !decodeItem( in, elements.back() ) )
+                        return false;
+                }
+
+                in.depth--;
+                return true;
+            }
+
+            case MAP:
+            {
+                if ( ++in.depth > MAX_DEPTH || (!indefinite && arg > in.remaining() / 2) )
+                    return false;
+
+                v = Json::Value::object();
+                Json::Members& members = v.members();
+
+                for ( uint64_t i = 0; indefinite ? !atBreak( in ) : i < arg; i++ )
+                {
+                    Json::Value key;
+                    if ( !decodeItem( in, key ) || !key.isString() )
+                        return false;
+
+                    members.emplace_back( key.asString(), Json::Value() );
+                    if ( !decodeItem( in, members.back().second ) )
+                        return false;
+                }
+
+                in.depth--;
+                return true;
+            }
+
+            case TAG:
+            {
+                // Tags only annotate the item that follows
+                if ( ++in.depth > MAX_DEPTH || !decodeItem( in, v ) )
+                    return false;
+
+                in.depth--;
+                return true;
+            }
+
+            default:
+                switch ( info )
+                {
+                    case 20: v = Json::Value( false ); return true;
+                    case 21: v = Json::Value( true ); return true;
+                    case 22:
+                    case 23: v = Json::Value(); return true;
+                    case 25: v = Json::Value( halfToDouble( (uint16_t) arg )); return true;
+                    case 26: v = Json::Value( ByteReader::toFloat( arg )); return true;
+                    case 27: v = Json::Value( ByteReader::toDouble( arg )); return true;
+                    default: return false;
+                }
+        }
+    }
+
+
+    Expected<Json::Value> decode( string_view data )
+    {
+        ByteReader in( data );
+        Json::Value value;
+
+        if ( !decodeItem( in, value ) || in.remaining() > 0 )
+            return errc::invalid_argument;
+
+        return value;
+    }
+
+} // ns
+
+
+namespace lwsdk::MsgPack
+{
+    /**
+     * Appends a marker byte followed by a big-endian number of n bytes.
+     */
+    static void putMarker( PooledBuffer& out, uint8_t marker, uint64_t value, int n )
+    {
+        out.append( &marker, 1 );
+        putBE( out, value, n );
+    }
+
+
+    /**
+     * Appends a string, array or map header: the fix form for small lengths, else the
+     * 8-bit (strings only), 16-bit or 32-bit form.
+     */
+    static void putLength( PooledBuffer& out, size_t len, uint8_t fixBase, size_t fixMax,
+                           uint8_t marker8, uint8_t marker16, uint8_t marker32 )
+    {
+        if ( len <= fixMax )
+        {
+            uint8_t b = fixBase | (uint8_t) len;
+            out.append( &b, 1 );
+        }
+        else if ( marker8 != 0 && len <= 0xFF )
+            putMarker( out, marker8, len, 1 );
+        else if ( len <= 0xFFFF )
+            putMarker( out, marker16, len, 2 );
+        else
+            putMarker( out, marker32, len, 4 );
+    }
+
+
+    static void putString( PooledBuffer& out, const string& s )
+    {
+        putLength( out, s.size(), 0xA0, 31, 0xD9, 0xDA, 0xDB );
+        out.append( s.data(), s.size() );
+    }
+
+
+    void encode( const Json::Value& value, PooledBuffer& out )
+    {
+        switch ( value.type() )
+        {
+            case Json::Type::Null:
+            {
+                uint8_t b = 0xC0;
+                out.append( &b, 1 );
+                break;
+            }
+
+            case Json::Type::Bool:
+            {
+                uint8_t b = value.asBool() ? 0xC3 : 0xC2;
+                out.append( &b, 1 );
+                break;
+            }
+
+            case Json::Type::Int:
+            {
+                int64_t n = value.asInt();
+
+                if ( n >= -32 && n <= 127 )
+                {
+                    uint8_t b = (uint8_t) n;   // positive and negative fixint
+                    out.append( &b, 1 );
+                }
+                else if ( n > 0 )
+                {
+                    if ( n <= 0xFF )            putMarker( out, 0xCC, n, 1 );
+                    else if ( n <= 0xFFFF )     putMarker( out, 0xCD, n, 2 );
+                    else if ( n <= 0xFFFFFFFF ) putMarker( out, 0xCE, n, 4 );
+                    else                        putMarker( out, 0xCF, n, 8 );
+                }
+                else
+                {
+                    if ( n >= INT8_MIN )        putMarker( out, 0xD0, (uint64_t) n, 1 );
+                    else if ( n >= INT16_MIN )  putMarker( out, 0xD1, (uint64_t) n, 2 );
+                    else if ( n >= INT32_MIN )  putMarker( out, 0xD2, (uint64_t) n, 4 );
+                    else                        putMarker( out, 0xD3, (uint64_t) n, 8 );
+                }
+                break;
+            }
+
+            case Json::Type::Double:
+                putFloat( out, value.asDouble(), 0xCA, 0xCB );
+                break;
+
+            case Json::Type::String:
+                putString( out, value.asString() );
+                break;
+
+            case Json::Type::Array:
+                putLength( out, value.size(), 0x90, 15, 0, 0xDC, 0xDD );
+                for ( auto& element : value.elements() )
+                    encode( element, out );
+                break;
+
+            case Json::Type::Object:
+                putLength( out, value.size(), 0x80, 15, 0, 0xDE, 0xDF );
+                for ( auto& member : value.members() )
+                {
+                    putString( out, member.first );
+                    encode( member.second, out );
+                }
+                break;
+        }
+    }
+
+
+    static bool decodeObject( ByteReader& in, Json::Value& v );
+
+
+    static bool decodeArray( ByteReader& in, uint64_t count, Json::Value& v )
+    {
+        if ( ++in.depth > MAX_DEPTH || count > in.remaining() )
+            return false;
+
+        v = Json::Value::array();
+        Json::Elements& elements = v.elements();
+
+        for ( uint64_t i = 0; i < count; i++ )
+        {
+            elements.emplace_back();
+            if ( !decodeObject( in, elements.back() ) )
+                return false;
+        }
+
+        in.depth--;
+        return true;
+    }
+
+
+    static bool decodeMap( ByteReader& in, uint64_t count, Json::Value& v )
+    {
+        if ( ++in.depth > MAX_DEPTH || count > in.remaining() / 2 )
+            return false;
+
+        v = Json::Value::object();
+        Json::Members& members = v.members();
+
+        for ( uint64_t i = 0; i < count; i++ )
+        {
+            Json::Value key;
+            if ( !decodeObject( in, key ) || !key.isString() )
+                return false;
+
+            members.emplace_back( key.asString(), Json::Value() );
+            if ( !decodeObject( in, members.back().second ) )
+                return false;
+        }
+
+        in.depth--;
+        return true;
+    }
+
+
+    static bool decodeString( ByteReader& in, int lengthBytes, Json::Value& v )
+    {
+        uint64_t len;
+        string s;
+
+        if ( !in.readBE( lengthBytes, len ) || !in.readString( len, s ) )
+            return false;
+
+        v = Json::Value( std::move( s ));
+        return true;
+    }
+
+
+    static bool decodeObject( ByteReader& in, Json::Value& v )
+    {
+        if ( in.remaining() < 1 )
+            return false;
+
+        uint8_t b = *in.p++;
+        uint64_t n;
+
+        if ( b <= 0x7F )
+        {
+            v = Json::Value( (int64_t) b );
+            return true;
+        }
+
+        if ( b >= 0xE0 )
+        {
+            v = Json::Value( (int64_t) (int8_t) b );
+            return true;
+        }
+
+        if ( (b & 0xF0) == 0x80 )
+            return decodeMap( in, b & 0x0F, v );
+
+        if ( (b & 0xF0) == 0x90 )
+            return decodeArray( in, b & 0x0F, v );
+
+        if ( (b & 0xE0) == 0xA0 )
+        {
+            string s;
+            if ( !in.readString( b & 0x1F, s ) )
+                return false;
+
+            v = Json::Value( std::move( s ));
+            return true;
+        }
+
+        switch ( b )
+        {
+            case 0xC0: v = Json::Value(); return true;
+            case 0xC2: v = Json::Value( false ); return true;
+            case 0xC3: v = Json::Value( true ); return true;
+
+            case 0xC4: case 0xD9: return decodeString( in, 1, v );
+            case 0xC5: case 0xDA: return decodeString( in, 2, v );
+            case 0xC6: case 0xDB: return decodeString( in, 4, v );
+
+            case 0xCA:
+                if ( !in.readBE( 4, n ) ) return false;
+                v = Json::Value( ByteReader::toFloat( n ));
+                return true;
+
+            case 0xCB:
+                if ( !in.readBE( 8, n ) ) return false;
+                v = Json::Value( ByteReader::toDouble( n ));
+                return true;
+
+            case 0xCC: case 0xCD: case 0xCE: case 0xCF:
+                if ( !in.readBE( 1 << (b - 0xCC), n ) ) return false;
+                v = n > INT64_MAX ? Json::Value( (double) n ) : Json::Value( (int64_t) n );
+                return true;
+
+            case 0xD0: if ( !in.readBE( 1, n ) ) return false; v = Json::Value( (int64_t) (int8_t) n ); return true;
+            case 0xD1: if ( !in.readBE( 2, n ) ) return false; v = Json::Value( (int64_t) (int16_t) n ); return true;
+            case 0xD2: if ( !in.readBE( 4, n ) ) return false; v = Json::Value( (int64_t) (int32_t) n ); return true;
+            case 0xD3: if ( !in.readBE( 8, n ) ) return false; v = Json::Value( (int64_t) n ); return true;
+
+            case 0xDC: return in.readBE( 2, n ) && decodeArray( in, n, v );
+            case 0xDD: return in.readBE( 4, n ) && decodeArray( in, n, v );
+            case 0xDE: return in.readBE( 2, n ) && decodeMap( in, n, v );
+            case 0xDF: return in.readBE( 4, n ) && decodeMap( in, n, v );
+
+            default:
+                return false;   // 0xC1 is never used, extension types are not supported
+        }
+    }
+
+
+    Expected<Json::Value> decode( string_view data )
+    {
+        ByteReader in( data );
+        Json::Value value;
+
+        if ( !decodeObject( in, value ) || in.remaining() > 0 )
+            return errc::invalid_argument;
+
+        return value;
+    }
+
+} // ns
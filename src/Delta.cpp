@@ -0,0 +1,213 @@
+/********************************************************************************
+ *  This file is part of the lopezworks SDK utility library for C/C++ (lwsdk).
+ *
+ *  Copyright (C) 2015-2017 Edwin R. Lopez
+ *  http://www.lopezworks.info
+ *
+ *  This source code is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation LGPL v2.1
+ *  (http://www.gnu.org/licenses/).
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ *  02110-1301  USA.
+ ********************************************************************************/
+#include <vector>
+#include <cstring>
+#include "Delta.h"
+
+using namespace std;
+
+namespace lwsdk::Delta
+{
+    #define BLOCK_SIZE 32          // Size of the base blocks looked up in the target
+    #define HASH_MULT  0x01000193  // Rolling hash multiplier
+
+    enum : unsigned char { OP_COPY = 0x01, OP_DATA = 0x02 };
+
+
+    /**
+     * Hashes the BLOCK_SIZE bytes at p.
+     */
+    static uint32_t hashBlock( const unsigned char *p )
+    {
+        uint32_t h = 0;
+        for ( int i = 0; i < BLOCK_SIZE; i++ )
+            h = h * HASH_MULT + p[i];
+
+        return h;
+    }
+
+
+    /**
+     * Appends an insert operation, if there are any bytes.
+     */
+    static void putData( PooledBuffer& out, const char *bytes, size_t len )
+    {
+        if ( len == 0 )
+            return;
+
+        unsigned char op = OP_DATA;
+        out.append( &op, 1 );
+        put32( out, (uint32_t) len );
+        out.append( bytes, len );
+    }
+
+
+    void put32( PooledBuffer& out, uint32_t n )
+    {
+        unsigned char b[4] = { (unsigned char) (n >> 24), (unsigned char) (n >> 16),
+                               (unsigned char) (n >> 8),  (unsigned char) n };
+        out.append( b, 4 );
+    }
+
+
+    bool encode( string_view base, string_view target, PooledBuffer& out, size_t maxSize )
+    {
+        size_t startSize = out.size();
+        auto *bs = (const unsigned char *) base.data();
+        auto *ts = (const unsigned char *) target.data();
+        size_t n = target.size();
+
+        // Index the base's aligned blocks by hash in an open-addressing table holding
+        // offset + 1, 0 marks free slots
+        size_t blocks = base.size() / BLOCK_SIZE;
+        size_t tableSize = 16;
+        while ( tableSize < blocks * 2 )
+            tableSize <<= 1;
+
+        vector<uint32_t> hashes( tableSize );
+        vector<uint32_t> offsets( tableSize, 0 );
+
+        for ( size_t b = 0; b < blocks; b++ )
+        {
+            uint32_t h = hashBlock( bs + b * BLOCK_SIZE );
+            size_t slot = h & (tableSize - 1);
+
+            while ( offsets[slot] != 0 && hashes[slot] != h )
+                slot = (slot + 1) & (tableSize - 1);
+
+            if ( offsets[slot] == 0 )   // first block with a given hash wins
+            {
+                hashes[slot] = h;
+                offsets[slot] = (uint32_t) (b * BLOCK_SIZE + 1);
+            }
+        }
+
+        // Multiplier of the byte leaving the rolling window
+        uint32_t outMult = 1;
+        for ( int i = 1; i < BLOCK_SIZE; i++ )
+            outMult *= HASH_MULT;
+
+        size_t pos = 0;
+        size_t literal = 0;   // start of the bytes not matched yet
+        uint32_t h = (blocks > 0 && n >= BLOCK_SIZE) ? hashBlock( ts ) : 0;
+
+        while ( blocks > 0 && pos + BLOCK_SIZE <= n )
+        {
+            size_t slot = h & (tableSize - 1);
+            while ( offsets[slot] != 0 && hashes[slot] != h )
+                slot = (slot + 1) & (tableSize - 1);
+
+            if ( offsets[slot] != 0 && memcmp( bs + offsets[slot] - 1, ts + pos, BLOCK_SIZE ) == 0 )
+            {
+                size_t from = offsets[slot] - 1;
+                size_t len = BLOCK_SIZE;
+
+                // Grow the match both ways, backwards into the unmatched bytes
+                while ( from + len < base.size() && pos + len < n && bs[from + len] == ts[pos + len] )
+                    len++;
+
+                while ( pos > literal && from > 0 && bs[from - 1] == ts[pos - 1] )
+                {
+                    pos--;
+                    from--;
+                    len++;
+                }
+
+                putData( out, target.data() + literal, pos - literal );
+
+                unsigned char op = OP_COPY;
+                out.append( &op, 1 );
+                put32( out, (uint32_t) from );
+                put32( out, (uint32_t) len );
+
+                pos += len;
+                literal = pos;
+
+                if ( out.size() - startSize > maxSize )
+                    return false;
+
+                if ( pos + BLOCK_SIZE <= n )
+                    h = hashBlock( ts + pos );
+
+                continue;
+            }
+
+            if ( pos + BLOCK_SIZE >= n )
+                break;
+
+            h = (h - ts[pos] * outMult) * HASH_MULT + ts[pos + BLOCK_SIZE];
+            pos++;
+
+            // Unmatched stretches are bounded by the size limit, too
+            if ( pos - literal > maxSize )
+                return false;
+        }
+
+        putData( out, target.data() + literal, n - literal );
+
+        return out.size() - startSize <= maxSize;
+    }
+
+
+    bool apply( string_view base, string_view delta, string& out )
+    {
+        auto *p = (const unsigned char *) delta.data();
+        auto *end = p + delta.size();
+
+        out.clear();
+
+        while ( p < end )
+        {
+            unsigned char op = *p++;
+
+            if ( op == OP_COPY && end - p >= 8 )
+            {
+                uint32_t from = get32( p );
+                uint32_t len = get32( p + 4 );
+                p += 8;
+
+                if ( from > base.size() || len > base.size() - from )
+                    return false;
+
+                out.append( base.data() + from, len );
+            }
+            else if ( op == OP_DATA && end - p >= 4 )
+            {
+                uint32_t len = get32( p );
+                p += 4;
+
+                if ( len > (size_t) (end - p) )
+                    return false;
+
+                out.append( (const char *) p, len );
+                p += len;
+            }
+            else
+            {
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+} // ns
@@ -31,68 +31,111 @@ using namespace std;
 namespace lwsdk::Files
 {
     
-    void copy( const std::string& fromPathname, const std::string& toPathname )
+    Expected<void> tryCopy( const std::string& fromPathname, const std::string& toPathname )
     {
         error_code ec;
 
         fs::copy( fromPathname, toPathname, fs::copy_options::overwrite_existing | fs::copy_options::recursive, ec );
 
-        if ( ec.value() != 0 )
+        return ec;
+    }
+
+
+    void copy( const std::string& fromPathname, const std::string& toPathname )
+    {
+        auto res = tryCopy( fromPathname, toPathname );
+
+        if ( !res )
             throw IOException("copy() - Failed to copy file or directory from " +
-                              fromPathname + " to " + toPathname + " - " + ec.message() );
+                              fromPathname + " to " + toPathname + " - " + res.error().message() );
     }
 
 
-    void move( const std::string& fromPathname, const std::string& toPathname )
+    Expected<void> tryMove( const std::string& fromPathname, const std::string& toPathname )
     {
         error_code ec;
 
         fs::rename( fromPathname, toPathname, ec );
 
-        if ( ec.value() != 0 )
+        return ec;
+    }
+
+
+    void move( const std::string& fromPathname, const std::string& toPathname )
+    {
+        auto res = tryMove( fromPathname, toPathname );
+
+        if ( !res )
             throw IOException("move() - Failed to move/rename file or directory from " +
-                              fromPathname + " to " + toPathname + " - " + ec.message() );
+                              fromPathname + " to " + toPathname + " - " + res.error().message() );
     }
 
 
-    uintmax_t remove( const std::string& pathname )
+    Expected<uintmax_t> tryRemove( const std::string& pathname )
     {
         error_code ec;
 
         uintmax_t n = fs::remove_all( pathname, ec );
 
-        if ( ec.value() != 0 )
-            throw IOException("remove() - Failed to remove file or directory " + pathname + " - " + ec.message() );
+        if ( ec )
+            return ec;
 
         return n;
     }
 
 
+    uintmax_t remove( const std::string& pathname )
+    {
+        auto res = tryRemove( pathname );
+
+        if ( !res )
+            throw IOException("remove() - Failed to remove file or directory " + pathname + " - " + res.error().message() );
+
+        return *res;
+    }
+
+
     string getCurrentDir()
     {
         return filesystem::current_path();
     }
 
 
-    void changeDir( const std::string& pathname )
+    Expected<void> tryChangeDir( const std::string& pathname )
     {
         error_code ec;
 
         fs::current_path( pathname, ec );
 
-        if ( ec.value() != 0 )
-            throw IOException("chdir() - Failed to change to directory " + pathname + " - " + ec.message() );
+        return ec;
     }
 
 
-    void makeDir( const std::string& pathname )
+    void changeDir( const std::string& pathname )
+    {
+        auto res = tryChangeDir( pathname );
+
+        if ( !res )
+            throw IOException("chdir() - Failed to change to directory " + pathname + " - " + res.error().message() );
+    }
+
+
+    Expected<void> tryMakeDir( const std::string& pathname )
     {
         error_code ec;
 
         fs::create_directories( pathname, ec );
 
-        if ( ec.value() != 0 )
-            throw IOException("makeDir() - Failed to create directory " + pathname + " - " + ec.message() );
+        return ec;
+    }
+
+
+    void makeDir( const std::string& pathname )
+    {
+        auto res = tryMakeDir( pathname );
+
+        if ( !res )
+            throw IOException("makeDir() - Failed to create directory " + pathname + " - " + res.error().message() );
     }
 
 
@@ -120,32 +163,52 @@ namespace lwsdk::Files
     }
 
 
-    uintmax_t getFileSize( const std::string& pathname )
+    Expected<uintmax_t> tryGetFileSize( const std::string& pathname )
     {
         error_code ec;
 
         uintmax_t sz = fs::file_size( pathname, ec );
 
-        if ( ec.value() != 0 )
-            throw IOException( "getFileSize() - Failed to get file size " + pathname + " - " + ec.message());
+        if ( ec )
+            return ec;
 
         return sz;
     }
 
-    long getLastUpdated( const std::string& pathname )
+
+    uintmax_t getFileSize( const std::string& pathname )
+    {
+        auto res = tryGetFileSize( pathname );
+
+        if ( !res )
+            throw IOException( "getFileSize() - Failed to get file size " + pathname + " - " + res.error().message());
+
+        return *res;
+    }
+
+
+    Expected<long> tryGetLastUpdated( const std::string& pathname )
     {
         error_code ec;
 
         auto fileTs = fs::last_write_time( pathname, ec );
 
-        if ( ec.value() != 0 )
-            throw IOException("getLastUpdated() - Failed to get file time " + pathname + " - " + ec.message() );
+        if ( ec )
+            return ec;
 
         return Files::fileTimeToMillis( fileTs );
-
     }
 
 
+    long getLastUpdated( const std::string& pathname )
+    {
+        auto res = tryGetLastUpdated( pathname );
+
+        if ( !res )
+            throw IOException("getLastUpdated() - Failed to get file time " + pathname + " - " + res.error().message() );
+
+        return *res;
+    }
 
 
     long fileTimeToMillis( std::filesystem::file_time_type const &fileTime )
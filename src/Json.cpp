@@ -0,0 +1,855 @@
+/********************************************************************************
+ *  This file is part of the lopezworks SDK utility library for C/C++ (lwsdk).
+ *
+ *  Copyright (C) 2015-2017 Edwin R. Lopez
+ *  http://www.lopezworks.info
+ *
+ *  This source code is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation LGPL v2.1
+ *  (http://www.gnu.org/licenses/).
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ *  02110-1301  USA.
+ ********************************************************************************/
+#include "Json.h"
+#include "Exceptions.h"
+
+#include <cmath>
+#include <climits>
+#include <cstring>
+#include <charconv>
+
+#define LOGGER_ENABLED 0   // turn off verbose logging
+#include "Logger.h"
+
+using namespace std;
+
+namespace lwsdk::Json
+{
+    #define MAX_DEPTH 512
+
+    static const uint64_t ONES  = 0x0101010101010101ull;
+    static const uint64_t HIGHS = 0x8080808080808080ull;
+
+    /**
+     * Returns a pointer to the first byte in [p, end) that cannot be copied verbatim in a
+     * JSON string: a quote, a backslash or a control character. Checks 8 bytes per step;
+     * a word holding any of them sets the high bit of (at least) that byte.
+     */
+    static const char* scanPlain( const char *p, const char *end )
+    {
+        while ( end - p >= 8 )
+        {
+            uint64_t w;
+            memcpy( &w, p, 8 );
+
+            uint64_t q = w ^ (ONES * '"');
+            uint64_t b = w ^ (ONES * '\\');
+            uint64_t mask = ((q - ONES) & ~q) | ((b - ONES) & ~b) | ((w - ONES * 0x20) & ~w);
+
+            if ( mask & HIGHS )
+                break;
+
+            p += 8;
+        }
+
+        while ( p < end && *p != '"' && *p != '\\' && (unsigned char) *p >= 0x20 )
+            p++;
+
+        return p;
+    }
+
+
+    /**
+     * Appends a code point encoded as UTF-8.
+     */
+    static void appendUtf8( string& s, uint32_t cp )
+    {
+        if ( cp < 0x80 )
+        {
+            s += (char) cp;
+        }
+        else if ( cp < 0x800 )
+        {
+            s += (char) (0xC0 | (cp >> 6));
+            s += (char) (0x80 | (cp & 0x3F));
+        }
+        else if ( cp < 0x10000 )
+        {
+            s += (char) (0xE0 | (cp >> 12));
+            s += (char) (0x80 | ((cp >> 6) & 0x3F));
+            s += (char) (0x80 | (cp & 0x3F));
+        }
+        else
+        {
+            s += (char) (0xF0 | (cp >> 18));
+            s += (char) (0x80 | ((cp >> 12) & 0x3F));
+            s += (char) (0x80 | ((cp >> 6) & 0x3F));
+            s += (char) (0x80 | (cp & 0x3F));
+        }
+    }
+
+
+    /**
+     * Recursive descent parser over a text buffer. Parsing stops at the first error.
+     */
+    struct Parser
+    {
+        const char *p;
+        const char *end;
+        int  depth{0};
+        errc err{};
+
+        bool fail( errc e = errc::invalid_argument )
+        {
+            if ( err == errc{} )
+                err = e;
+
+            return false;
+        }
+
+        void skipSpace()
+        {
+            while ( p < end && (*p == ' ' || *p == '\n' || *p == '\r' || *p == '\t') )
+                p++;
+        }
+
+        bool literal( const char *word, size_t len )
+        {
+            if ( (size_t) (end - p) < len || memcmp( p, word, len ) != 0 )
+                return fail();
+
+            p += len;
+            return true;
+        }
+
+        bool hex4( uint32_t& cp )
+        {
+            if ( end - p < 4 )
+                return fail();
+
+            cp = 0;
+            for ( int i = 0; i < 4; i++ )
+            {
+                char c = *p++;
+                cp <<= 4;
+
+                if ( c >= '0' && c <= '9' )      cp |= c - '0';
+                else if ( c >= 'a' && c <= 'f' ) cp |= c - 'a' + 10;
+                else if ( c >= 'A' && c <= 'F' ) cp |= c - 'A' + 10;
+                else return fail();
+            }
+
+            return true;
+        }
+
+        // p is past the opening quote
+        bool parseString( string& s )
+        {
+            while ( true )
+            {
+                const char *stop = scanPlain( p, end );
+                s.append( p, stop - p );
+                p = stop;
+
+                if ( p >= end || (unsigned char) *p < 0x20 )
+                    return fail();
+
+                if ( *p++ == '"' )
+                    return true;
+
+                if ( p >= end )
+                    return fail();
+
+                switch ( *p++ )
+                {
+                    case '"':  s += '"';  break;
+                    case '\\': s += '\\'; break;
+                    case '/':  s += '/';  break;
+                    case 'b':  s += '\b'; break;
+                    case 'f':  s += '\f'; break;
+                    case 'n':  s += '\n'; break;
+                    case 'r':  s += '\r'; break;
+                    case 't':  s += '\t'; break;
+                    case 'u':
+                    {
+                        uint32_t cp;
+                        if ( !hex4( cp ) )
+                            return false;
+
+                        // Characters beyond the BMP come as a surrogate pair
+                        if ( cp >= 0xD800 && cp <= 0xDBFF )
+                        {
+                            uint32_t low;
+                            if ( end - p < 2 || p[0] != '\\' || p[1] != 'u' )
+                                return fail();
+
+                            p += 2;
+                            if ( !hex4( low ) )
+                                return false;
+
+                            if ( low < 0xDC00 || low > 0xDFFF )
+                                return fail();
+
+                            cp = 0x10000 + ((cp - 0xD800) << 10) + (low - 0xDC00);
+                        }
+                        else if ( cp >= 0xDC00 && cp <= 0xDFFF )
+                        {
+                            return fail();
+                        }
+
+                        appendUtf8( s, cp );
+                        break;
+                    }
+                    default:
+                        return fail();
+                }
+            }
+        }
+
+        bool parseNumber( Value& v )
+        {
+            const char *start = p;
+            bool integral = true;
+
+            if ( p < end && *p == '-' )
+                p++;
+
+            // No leading zeros
+            if ( p < end && *p == '0' )
+                p++;
+            else if ( p < end && *p >= '1' && *p <= '9' )
+                while ( p < end && *p >= '0' && *p <= '9' ) p++;
+            else
+                return fail();
+
+            if ( p < end && *p == '.' )
+            {
+                integral = false;
+                if ( ++p >= end || *p < '0' || *p > '9' )
+                    return fail();
+
+                while ( p < end && *p >= '0' && *p <= '9' ) p++;
+            }
+
+            if ( p < end && (*p == 'e' || *p == 'E') )
+            {
+                integral = false;
+                if ( ++p < end && (*p == '+' || *p == '-') )
+                    p++;
+
+                if ( p >= end || *p < '0' || *p > '9' )
+                    return fail();
+
+                while ( p < end && *p >= '0' && *p <= '9' ) p++;
+            }
+
+            // Integers too large for int64 are kept as double
+            if ( integral )
+            {
+                int64_t n;
+                auto r = from_chars( start, p, n );
+                if ( r.ec == errc{} )
+                {
+                    v = Value( n );
+                    return true;
+                }
+            }
+
+            double d = 0;
+            auto r = from_chars( start, p, d );
+
+            // from_chars leaves d untouched when out of range
+            if ( r.ec == errc::result_out_of_range )
+                d = outOfRange( start, p );
+            else if ( r.ec != errc{} )
+                return fail();
+
+            v = Value( d );
+            return true;
+        }
+
+        /**
+         * Returns the value of a number too large or too small for a double: +/-HUGE_VAL
+         * if its magnitude is above 1, +/-0.0 otherwise, as strtod() does.
+         */
+        static double outOfRange( const char *start, const char *stop )
+        {
+            const char *q = start;
+            bool negative = (*q == '-');
+            if ( negative )
+                q++;
+
+            // Decimal exponent of the first significant digit, before the exponent part
+            long integerDigits = 0, leadingZeros = 0;
+            bool significant = false;
+
+            for ( ; q < stop && *q >= '0' && *q <= '9'; q++ )
+            {
+                if ( *q != '0' )
+                    significant = true;
+
+                if ( significant )
+                    integerDigits++;
+            }
+
+            if ( q < stop && *q == '.' )
+            {
+                for ( q++; q < stop && *q >= '0' && *q <= '9' && !significant; q++ )
+                {
+                    if ( *q != '0' )
+                        significant = true;
+                    else
+                        leadingZeros++;
+                }
+
+                while ( q < stop && *q >= '0' && *q <= '9' ) q++;
+            }
+
+            long order = integerDigits > 0 ? integerDigits - 1 : -(leadingZeros + 1);
+            long exponent = 0;
+
+            if ( q < stop && (*q == 'e' || *q == 'E') )
+            {
+                q++;
+                bool negativeExponent = (*q == '-');
+                if ( *q == '+' || *q == '-' )
+                    q++;
+
+                // Exponents beyond long are out of range either way
+                if ( from_chars( q, stop, exponent ).ec != errc{} )
+                    exponent = LONG_MAX / 2;
+
+                if ( negativeExponent )
+                    exponent = -exponent;
+            }
+
+            double magnitude = (order + exponent > 0) ? HUGE_VAL : 0.0;
+            return negative ? -magnitude : magnitude;
+        }
+
+        bool parseValue( Value& v )
+        {
+            skipSpace();
+            if ( p >= end )
+                return fail();
+
+            switch ( *p )
+            {
+                case '{':
+                {
+                    if ( ++depth > MAX_DEPTH )
+                        return fail( errc::value_too_large );
+
+                    p++;
+                    v = Value::object();
+                    Members& members = v.members();
+
+                    skipSpace();
+                    if ( p < end && *p == '}' )
+                    {
+                        p++;
+                        depth--;
+                        return true;
+                    }
+
+                    while ( true )
+                    {
+                        skipSpace();
+                        if ( p >= end || *p++ != '"' )
+                            return fail();
+
+                        members.emplace_back();
+                        if ( !parseString( members.back().first ) )
+                            return false;
+
+                        skipSpace();
+                        if ( p >= end || *p++ != ':' )
+                            return fail();
+
+                        if ( !parseValue( members.back().second ) )
+                            return false;
+
+                        skipSpace();
+                        if ( p >= end )
+                            return fail();
+
+                        char c = *p++;
+                        if ( c == '}' )
+                            break;
+
+                        if ( c != ',' )
+                            return fail();
+                    }
+
+                    depth--;
+                    return true;
+                }
+
+                case '[':
+                {
+                    if ( ++depth > MAX_DEPTH )
+                        return fail( errc::value_too_large );
+
+                    p++;
+                    v = Value::array();
+                    Elements& elements = v.elements();
+
+                    skipSpace();
+                    if ( p < end && *p == ']' )
+                    {
+                        p++;
+                        depth--;
+                        return true;
+                    }
+
+                    while ( true )
+                    {
+                        elements.emplace_back();
+                        if ( !parseValue( elements.back() ) )
+                            return false;
+
+                        skipSpace();
+                        if ( p >= end )
+                            return fail();
+
+                        char c = *p++;
+                        if ( c == ']' )
+                            break;
+
+                        if ( c != ',' )
+                            return fail();
+                    }
+
+                    depth--;
+                    return true;
+                }
+
+                case '"':
+                {
+                    p++;
+                    string s;
+                    if ( !parseString( s ) )
+                        return false;
+
+                    v = Value( std::move( s ));
+                    return true;
+                }
+
+                case 't':
+                    v = Value( true );
+                    return literal( "true", 4 );
+
+                case 'f':
+                    v = Value( false );
+                    return literal( "false", 5 );
+
+                case 'n':
+                    v = Value();
+                    return literal( "null", 4 );
+
+                default:
+                    return parseNumber( v );
+            }
+        }
+    };
+
+
+    Expected<Value> parse( string_view json )
+    {
+        Parser parser{ json.data(), json.data() + json.size() };
+        Value root;
+
+        if ( !parser.parseValue( root ) )
+            return parser.err;
+
+        // Only whitespace may follow the root value
+        parser.skipSpace();
+        if ( parser.p != parser.end )
+            return errc::invalid_argument;
+
+        return root;
+    }
+
+
+    void write( const Value& value, PooledBuffer& out )
+    {
+        Writer( out ).value( value );
+    }
+
+
+    string toString( const Value& value )
+    {
+        PooledBuffer out = BufferPool::acquire( 256 );
+        write( value, out );
+        return out.str();
+    }
+
+
+    /****************************************************************************
+     *  Value
+     ****************************************************************************/
+
+    bool Value::asBool() const
+    {
+        if ( !isBool() )
+            throw RuntimeException( "Json value is not a bool" );
+
+        return get<bool>( v );
+    }
+
+
+    int64_t Value::asInt() const
+    {
+        if ( isInt() )
+            return get<int64_t>( v );
+
+        if ( type() == Type::Double )
+            return (int64_t) get<double>( v );
+
+        throw RuntimeException( "Json value is not a number" );
+    }
+
+
+    double Value::asDouble() const
+    {
+        if ( type() == Type::Double )
+            return get<double>( v );
+
+        if ( isInt() )
+            return (double) get<int64_t>( v );
+
+        throw RuntimeException( "Json value is not a number" );
+    }
+
+
+    const string& Value::asString() const
+    {
+        if ( !isString() )
+            throw RuntimeException( "Json value is not a string" );
+
+        return get<string>( v );
+    }
+
+
+    const Elements& Value::elements() const
+    {
+        if ( !isArray() )
+            throw RuntimeException( "Json value is not an array" );
+
+        return get<Elements>( v );
+    }
+
+
+    Elements& Value::elements()
+    {
+        if ( !isArray() )
+            throw RuntimeException( "Json value is not an array" );
+
+        return get<Elements>( v );
+    }
+
+
+    const Members& Value::members() const
+    {
+        if ( !isObject() )
+            throw RuntimeException( "Json value is not an object" );
+
+        return get<Members>( v );
+    }
+
+
+    Members& Value::members()
+    {
+        if ( !isObject() )
+            throw RuntimeException( "Json value is not an object" );
+
+        return get<Members>( v );
+    }
+
+
+    size_t Value::size() const
+    {
+        if ( isArray() )
+            return get<Elements>( v ).size();
+
+        if ( isObject() )
+            return get<Members>( v ).size();
+
+        return 0;
+    }
+
+
+    const Value* Value::find( string_view key ) const
+    {
+        if ( !isObject() )
+            return nullptr;
+
+        for ( auto& member : get<Members>( v ) )
+            if ( member.first == key )
+                return &member.second;
+
+        return nullptr;
+    }
+
+
+    const Value& Value::operator[]( string_view key ) const
+    {
+        static const Value null;
+
+        const Value *value = find( key );
+        return value ? *value : null;
+    }
+
+
+    Value& Value::operator[]( string_view key )
+    {
+        if ( isNull() )
+            v = Members();
+
+        Members& members = this->members();
+
+        for ( auto& member : members )
+            if ( member.first == key )
+                return member.second;
+
+        members.emplace_back( string( key ), Value() );
+        return members.back().second;
+    }
+
+
+    const Value& Value::operator[]( size_t index ) const
+    {
+        const Elements& elements = this->elements();
+
+        if ( index >= elements.size() )
+            throw RuntimeException( "Json array index out of range" );
+
+        return elements[ index ];
+    }
+
+
+    Value& Value::operator[]( size_t index )
+    {
+        Elements& elements = this->elements();
+
+        if ( index >= elements.size() )
+            throw RuntimeException( "Json array index out of range" );
+
+        return elements[ index ];
+    }
+
+
+    Value& Value::push( Value value )
+    {
+        if ( isNull() )
+            v = Elements();
+
+        Elements& elements = this->elements();
+        elements.push_back( std::move( value ));
+        return elements.back();
+    }
+
+
+    /****************************************************************************
+     *  Writer
+     ****************************************************************************/
+
+    /**
+     * Writes the comma before the next item, unless it is the first of its container
+     * or the value of a member.
+     */
+    void Writer::separate()
+    {
+        if ( afterKey )
+            afterKey = false;
+        else if ( !first )
+            out.append( ",", 1 );
+
+        first = false;
+    }
+
+
+    Writer& Writer::beginObject()
+    {
+        separate();
+        out.append( "{", 1 );
+        first = true;
+        return *this;
+    }
+
+
+    Writer& Writer::endObject()
+    {
+        out.append( "}", 1 );
+        first = false;
+        return *this;
+    }
+
+
+    Writer& Writer::beginArray()
+    {
+        separate();
+        out.append( "[", 1 );
+        first = true;
+        return *this;
+    }
+
+
+    Writer& Writer::endArray()
+    {
+        out.append( "]", 1 );
+        first = false;
+        return *this;
+    }
+
+
+    Writer& Writer::key( string_view key )
+    {
+        value( key );
+        out.append( ":", 1 );
+        afterKey = true;
+        return *this;
+    }
+
+
+    Writer& Writer::value( nullptr_t )
+    {
+        separate();
+        out.append( "null", 4 );
+        return *this;
+    }
+
+
+    Writer& Writer::value( bool b )
+    {
+        separate();
+        if ( b )
+            out.append( "true", 4 );
+        else
+            out.append( "false", 5 );
+
+        return *this;
+    }
+
+
+    Writer& Writer::value( int64_t n )
+    {
+        char buf[24];
+        auto r = to_chars( buf, buf + sizeof( buf ), n );
+
+        separate();
+        out.append( buf, r.ptr - buf );
+        return *this;
+    }
+
+
+    Writer& Writer::value( double d )
+    {
+        // JSON has no NaN or infinity
+        if ( !isfinite( d ))
+            return value( nullptr );
+
+        char buf[32];
+        auto r = to_chars( buf, buf + sizeof( buf ), d );
+
+        // Keep a fraction, so the value is parsed back as a double
+        if ( memchr( buf, '.', r.ptr - buf ) == nullptr && memchr( buf, 'e', r.ptr - buf ) == nullptr )
+        {
+            memcpy( r.ptr, ".0", 2 );
+            r.ptr += 2;
+        }
+
+        separate();
+        out.append( buf, r.ptr - buf );
+        return *this;
+    }
+
+
+    Writer& Writer::value( string_view s )
+    {
+        static const char HEX[] = "0123456789abcdef";
+
+        separate();
+        out.append( "\"", 1 );
+
+        const char *p = s.data();
+        const char *end = p + s.size();
+
+        while ( p < end )
+        {
+            const char *stop = scanPlain( p, end );
+            out.append( p, stop - p );
+            p = stop;
+
+            if ( p >= end )
+                break;
+
+            char c = *p++;
+            switch ( c )
+            {
+                case '"':  out.append( "\\\"", 2 ); break;
+                case '\\': out.append( "\\\\", 2 ); break;
+                case '\b': out.append( "\\b", 2 );  break;
+                case '\f': out.append( "\\f", 2 );  break;
+                case '\n': out.append( "\\n", 2 );  break;
+                case '\r': out.append( "\\r", 2 );  break;
+                case '\t': out.append( "\\t", 2 );  break;
+                default:
+                {
+                    char esc[6] = { '\\', 'u', '0', '0', HEX[ (c >> 4) & 0xF ], HEX[ c & 0xF ] };
+                    out.append( esc, 6 );
+                }
+            }
+        }
+
+        out.append( "\"", 1 );
+        return *this;
+    }
+
+
+    Writer& Writer::value( const Value& value )
+    {
+        switch ( value.type() )
+        {
+            case Type::Null:   return this->value( nullptr );
+            case Type::Bool:   return this->value( value.asBool() );
+            case Type::Int:    return this->value( value.asInt() );
+            case Type::Double: return this->value( value.asDouble() );
+            case Type::String: return this->value( string_view( value.asString() ));
+
+            case Type::Array:
+                beginArray();
+                for ( auto& element : value.elements() )
+                    this->value( element );
+
+                return endArray();
+
+            case Type::Object:
+                beginObject();
+                for ( auto& member : value.members() )
+                    key( member.first ).value( member.second );
+
+                return endObject();
+        }
+
+        return *this;
+    }
+
+
+    Writer& Writer::raw( string_view json )
+    {
+        separate();
+        out.append( json.data(), json.size() );
+        return *this;
+    }
+
+} // ns
@@ -0,0 +1,483 @@
+/********************************************************************************
+ *  This file is part of the lopezworks SDK utility library for C/C++ (lwsdk).
+ *
+ *  Copyright (C) 2015-2017 Edwin R. Lopez
+ *  http://www.lopezworks.info
+ *
+ *  This source code is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation LGPL v2.1
+ *  (http://www.gnu.org/licenses/).
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ *  02110-1301  USA.
+ ********************************************************************************/
+#include "Metrics.h"
+#include "Exceptions.h"
+
+#include <map>
+#include <mutex>
+#include <thread>
+#include <sstream>
+#include <iomanip>
+
+#define PRETTY_FUNC std::string(__PRETTY_FUNCTION__)
+
+using namespace std;
+
+namespace lwsdk
+{
+    #define MAX_HISTOGRAM_SHARDS 8    // histograms are ~6 KB per shard, cap their memory
+
+    unsigned MetricsDetail::shardCount()
+    {
+        static unsigned count = [] {
+            unsigned cpus = max( 1u, thread::hardware_concurrency() );
+            unsigned n = 1;
+
+            while ( n < cpus )
+                n <<= 1;
+
+            return n;
+        }();
+
+        return count;
+    }
+
+
+    //
+    // ================================================ Counter =============================================================
+    //
+
+    Counter::Counter()
+    {
+        unsigned n = MetricsDetail::shardCount();
+        shards.reset( new Shard[ n ] );
+        shardMask = n - 1;
+    }
+
+
+    uint64_t Counter::value() const
+    {
+        uint64_t total = 0;
+
+        for ( unsigned i = 0; i <= shardMask; i++ )
+            total += shards[i].value.load( memory_order_relaxed );
+
+        return total;
+    }
+
+
+    //
+    // ================================================ Histogram ===========================================================
+    //
+
+    Histogram::Histogram()
+    {
+        unsigned n = min( MetricsDetail::shardCount(), (unsigned) MAX_HISTOGRAM_SHARDS );
+        shards.reset( new Shard[ n ] );
+        shardMask = n - 1;
+    }
+
+
+    uint64_t Histogram::bucketLowerBound( int bucket )
+    {
+        if ( bucket < SUB_BUCKETS )
+            return (uint64_t) bucket;
+
+        int shift = bucket / SUB_BUCKETS - 1;
+        return (uint64_t) (SUB_BUCKETS + bucket % SUB_BUCKETS) << shift;
+    }
+
+
+    uint64_t Histogram::bucketUpperBound( int bucket )
+    {
+        // Values beyond the range are counted in the last bucket
+        if ( bucket >= BUCKETS - 1 )
+            return UINT64_MAX;
+
+        return bucketLowerBound( bucket + 1 ) - 1;
+    }
+
+
+    HistogramSnapshot Histogram::snapshot() const
+    {
+        HistogramSnapshot snap;
+        snap.buckets.assign( BUCKETS, 0 );
+
+        for ( unsigned s = 0; s <= shardMask; s++ )
+        {
+            snap.count += shards[s].count.load( memory_order_relaxed );
+            snap.sum += shards[s].sum.load( memory_order_relaxed );
+
+            for ( int b = 0; b < BUCKETS; b++ )
+                snap.buckets[b] += shards[s].buckets[b].load( memory_order_relaxed );
+        }
+
+        // Min and max at bucket precision
+        for ( int b = 0; b < BUCKETS; b++ )
+        {
+            if ( snap.buckets[b] > 0 )
+            {
+                snap.min = Histogram::bucketLowerBound( b );
+                break;
+            }
+        }
+
+        for ( int b = BUCKETS - 1; b >= 0; b-- )
+        {
+            if ( snap.buckets[b] > 0 )
+            {
+                snap.max = Histogram::bucketUpperBound( b );
+                break;
+            }
+        }
+
+        return snap;
+    }
+
+
+    uint64_t HistogramSnapshot::quantile( double q ) const
+    {
+        // Shards are read one by one, so buckets may add up to slightly more than count
+        uint64_t total = 0;
+        for ( uint64_t n : buckets )
+            total += n;
+
+        if ( total == 0 )
+            return 0;
+
+        q = q < 0 ? 0 : q > 1 ? 1 : q;
+        uint64_t rank = (uint64_t) (q * (double) (total - 1)) + 1;
+        uint64_t seen = 0;
+
+        for ( int b = 0; b < (int) buckets.size(); b++ )
+        {
+            seen += buckets[b];
+            if ( seen >= rank )
+                return std::min( Histogram::bucketUpperBound( b ), max );
+        }
+
+        return max;
+    }
+
+
+    //
+    // ================================================ Registry ============================================================
+    //
+
+    enum MetricType { METRIC_COUNTER, METRIC_GAUGE, METRIC_GAUGE_FUNCTION, METRIC_HISTOGRAM };
+
+    struct MetricEntry
+    {
+        MetricType type;
+        string subsystem;
+        string name;
+        string instance;
+        string help;
+
+        unique_ptr<Counter>   counter;
+        unique_ptr<Gauge>     gauge;
+        unique_ptr<Histogram> histogram;
+        function<double()>    sampler;
+    };
+
+    // Sorted by subsystem, name and instance so all instances of a metric are exported together
+    typedef tuple<string, string, string> MetricKey;
+
+    struct Registry
+    {
+        mutex mtx;
+        map<MetricKey, MetricEntry> entries;
+    };
+
+    // Function-local so metrics can be registered from other static initializers, and
+    // never deleted so static objects can still unregister during process exit
+    static Registry& registry()
+    {
+        static Registry *instance = new Registry();
+        return *instance;
+    }
+
+
+    /**
+     * Returns the registry entry for the given identity, creating it if needed. Must be
+     * called with the registry lock held.
+     */
+    static MetricEntry& entryFor( MetricType type, const string& subsystem, const string& name,
+                                  const string& instance, const string& help )
+    {
+        auto& entries = registry().entries;
+        auto it = entries.find( MetricKey( subsystem, name, instance ));
+
+        if ( it != entries.end() )
+        {
+            if ( it->second.type != type )
+                throw RuntimeException( "Metrics - " + subsystem + "." + name + " is already registered with another type." );
+
+            return it->second;
+        }
+
+        MetricEntry& entry = entries[ MetricKey( subsystem, name, instance ) ];
+        entry.type = type;
+        entry.subsystem = subsystem;
+        entry.name = name;
+        entry.instance = instance;
+        entry.help = help;
+
+        return entry;
+    }
+
+
+    Counter& Metrics::counter( const std::string& subsystem, const std::string& name,
+                               const std::string& instance, const std::string& help )
+    {
+        lock_guard lock( registry().mtx );
+
+        MetricEntry& entry = entryFor( METRIC_COUNTER, subsystem, name, instance, help );
+        if ( !entry.counter )
+            entry.counter = make_unique<Counter>();
+
+        return *entry.counter;
+    }
+
+
+    Gauge& Metrics::gauge( const std::string& subsystem, const std::string& name,
+                           const std::string& instance, const std::string& help )
+    {
+        lock_guard lock( registry().mtx );
+
+        MetricEntry& entry = entryFor( METRIC_GAUGE, subsystem, name, instance, help );
+        if ( !entry.gauge )
+            entry.gauge = make_unique<Gauge>();
+
+        return *entry.gauge;
+    }
+
+
+    Histogram& Metrics::histogram( const std::string& subsystem, const std::string& name,
+                                   const std::string& instance, const std::string& help )
+    {
+        lock_guard lock( registry().mtx );
+
+        MetricEntry& entry = entryFor( METRIC_HISTOGRAM, subsystem, name, instance, help );
+        if ( !entry.histogram )
+            entry.histogram = make_unique<Histogram>();
+
+        return *entry.histogram;
+    }
+
+
+    void Metrics::gaugeFunction( const std::string& subsystem, const std::string& name,
+                                 const std::string& instance, const std::function<double()>& sampler,
+                                 const std::string& help )
+    {
+        lock_guard lock( registry().mtx );
+
+        MetricEntry& entry = entryFor( METRIC_GAUGE_FUNCTION, subsystem, name, instance, help );
+        entry.sampler = sampler;
+    }
+
+
+    void Metrics::removeInstance( const std::string& subsystem, const std::string& instance )
+    {
+        auto& entries = registry().entries;
+        lock_guard lock( registry().mtx );
+
+        for ( auto it = entries.begin(); it != entries.end(); )
+        {
+            if ( it->second.type == METRIC_GAUGE_FUNCTION &&
+                 it->second.subsystem == subsystem && it->second.instance == instance )
+                it = entries.erase( it );
+            else
+                ++it;
+        }
+    }
+
+
+    /**
+     * Returns the metric name in Prometheus form: lwsdk_<subsystem>_<name>.
+     */
+    static string promName( const MetricEntry& entry )
+    {
+        string s = "lwsdk_" + entry.subsystem + "_" + entry.name;
+
+        for ( char& c : s )
+            if ( !isalnum( (unsigned char) c ) && c != '_' )
+                c = '_';
+
+        return s;
+    }
+
+
+    /**
+     * Escapes a string for a Prometheus label value or a JSON string; both escape \ " and \n.
+     */
+    static string escape( const string& s )
+    {
+        string out;
+        out.reserve( s.size() );
+
+        for ( char c : s )
+        {
+            if ( c == '\\' || c == '"' )
+            {
+                out += '\\';
+                out += c;
+            }
+            else if ( c == '\n' )
+            {
+                out += "\\n";
+            }
+            else if ( (unsigned char) c >= 0x20 )
+            {
+                out += c;
+            }
+        }
+
+        return out;
+    }
+
+
+    static string promLabels( const MetricEntry& entry, const string& extra = "" )
+    {
+        string labels;
+
+        if ( !entry.instance.empty() )
+            labels = "instance=\"" + escape( entry.instance ) + "\"";
+
+        if ( !extra.empty() )
+            labels += (labels.empty() ? "" : ",") + extra;
+
+        return labels.empty() ? "" : "{" + labels + "}";
+    }
+
+
+    static const double QUANTILES[] = { 0.5, 0.9, 0.99, 0.999 };
+
+
+    std::string Metrics::toPrometheus()
+    {
+        ostringstream ss;
+        string lastName;
+
+        lock_guard lock( registry().mtx );
+
+        for ( auto& it : registry().entries )
+        {
+            const MetricEntry& entry = it.second;
+            string name = promName( entry );
+
+            // HELP/TYPE once per metric family
+            if ( name != lastName )
+            {
+                static const char *types[] = { "counter", "gauge", "gauge", "summary" };
+
+                if ( !entry.help.empty() )
+                    ss << "# HELP " << name << " " << entry.help << "\n";
+
+                ss << "# TYPE " << name << " " << types[ entry.type ] << "\n";
+                lastName = name;
+            }
+
+            switch ( entry.type )
+            {
+                case METRIC_COUNTER:
+                    ss << name << promLabels( entry ) << " " << entry.counter->value() << "\n";
+                    break;
+
+                case METRIC_GAUGE:
+                    ss << name << promLabels( entry ) << " " << entry.gauge->value() << "\n";
+                    break;
+
+                case METRIC_GAUGE_FUNCTION:
+                    ss << name << promLabels( entry ) << " " << entry.sampler() << "\n";
+                    break;
+
+                case METRIC_HISTOGRAM:
+                {
+                    HistogramSnapshot snap = entry.histogram->snapshot();
+
+                    for ( double q : QUANTILES )
+                    {
+                        ostringstream label;
+                        label << "quantile=\"" << q << "\"";
+                        ss << name << promLabels( entry, label.str() ) << " " << snap.quantile( q ) << "\n";
+                    }
+
+                    ss << name << "_sum" << promLabels( entry ) << " " << snap.sum << "\n";
+                    ss << name << "_count" << promLabels( entry ) << " " << snap.count << "\n";
+                    break;
+                }
+            }
+        }
+
+        return ss.str();
+    }
+
+
+    std::string Metrics::toJson()
+    {
+        ostringstream ss;
+        bool first = true;
+
+        lock_guard lock( registry().mtx );
+
+        ss << "[";
+
+        for ( auto& it : registry().entries )
+        {
+            const MetricEntry& entry = it.second;
+            static const char *types[] = { "counter", "gauge", "gauge", "histogram" };
+
+            ss << (first ? "\n" : ",\n");
+            first = false;
+
+            ss << "  {\"subsystem\": \"" << escape( entry.subsystem ) << "\", "
+               << "\"name\": \"" << escape( entry.name ) << "\", "
+               << "\"instance\": \"" << escape( entry.instance ) << "\", "
+               << "\"type\": \"" << types[ entry.type ] << "\", ";
+
+            switch ( entry.type )
+            {
+                case METRIC_COUNTER:
+                    ss << "\"value\": " << entry.counter->value();
+                    break;
+
+                case METRIC_GAUGE:
+                    ss << "\"value\": " << entry.gauge->value();
+                    break;
+
+                case METRIC_GAUGE_FUNCTION:
+                    ss << "\"value\": " << entry.sampler();
+                    break;
+
+                case METRIC_HISTOGRAM:
+                {
+                    HistogramSnapshot snap = entry.histogram->snapshot();
+
+                    ss << "\"count\": " << snap.count << ", \"sum\": " << snap.sum
+                       << ", \"mean\": " << snap.mean() << ", \"min\": " << snap.min
+                       << ", \"max\": " << snap.max
+                       << ", \"p50\": " << snap.quantile( 0.5 ) << ", \"p90\": " << snap.quantile( 0.9 )
+                       << ", \"p99\": " << snap.quantile( 0.99 ) << ", \"p999\": " << snap.quantile( 0.999 );
+                    break;
+                }
+            }
+
+            ss << "}";
+        }
+
+        ss << (first ? "]" : "\n]") << "\n";
+
+        return ss.str();
+    }
+
+} // ns
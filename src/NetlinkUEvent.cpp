@@ -23,10 +23,18 @@
 
 #include "Utils.h"
 #include "Strings.h"
+#include "Reactor.h"
+#include "ThreadPool.h"
+#include "BufferPool.h"
+#include "Metrics.h"
+#include "Trace.h"
+#include "Threads.h"
 
 // Netlink
 #include <sys/socket.h>
 #include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <poll.h>
 #include <linux/netlink.h>
 #include <unistd.h>
 
@@ -39,6 +47,21 @@ using namespace std;
 
 namespace lwsdk
 {
+    // UEvent metrics, registered on first use
+    struct UEventMetrics
+    {
+        Counter&   events     = Metrics::counter( "uevent", "events", "", "Kernel uevents delivered" );
+        Counter&   bytes      = Metrics::counter( "uevent", "bytes", "", "Kernel uevent bytes received" );
+        Counter&   ignored    = Metrics::counter( "uevent", "ignored", "", "libudev messages ignored" );
+        Histogram& callbackNs = Metrics::histogram( "uevent", "callback_ns", "", "uevent callback duration in nanoseconds" );
+    };
+
+    static UEventMetrics& metrics()
+    {
+        static UEventMetrics instance;
+        return instance;
+    }
+
     // Struct UEvent
     std::string UEvent::valueOf( const std::string &propName ) const
     {
@@ -55,64 +78,134 @@ namespace lwsdk
     }
 
 
+    // Forwards
+    static int openSocket();
+
+
     // Class NetlinkUEvent
     NetlinkUEvent::NetlinkUEvent( const UEventCallback_t&  uEventCallback )
     {
         this->uEventCallback = uEventCallback;
 
         if ( uEventCallback == nullptr )
-            throw RuntimeException( string(__PRETTY_FUNCTION__ ) + " - uEventCallback can't be null." );
+            throw RuntimeException( "uEventCallback can't be null." );
+
+        // Start reader thread, wakefd tells it to exit
+        wakefd = eventfd( 0, EFD_NONBLOCK | EFD_CLOEXEC );
+        if ( wakefd < 0 )
+            throw RuntimeException( "Failed to create eventfd", errnoCode() );
 
-        // Start reader thread
         keepWorking = true;
         uEventReaderThread = new thread( &NetlinkUEvent::readerThread, this );
     }
 
-    
+
+    NetlinkUEvent::NetlinkUEvent( const UEventCallback_t& uEventCallback, Reactor& reactor )
+    {
+        this->uEventCallback = uEventCallback;
+
+        if ( uEventCallback == nullptr )
+            throw RuntimeException( "uEventCallback can't be null." );
+
+        reactorSocketfd = openSocket();
+        if ( reactorSocketfd < 0 )
+            throw RuntimeException( "Failed to open netlink socket." );
+
+        if ( !reactor.add( reactorSocketfd, EPOLLIN, [this]( uint32_t ) { readEvent( reactorSocketfd ); } ))
+        {
+            close( reactorSocketfd );
+            throw RuntimeException( "Failed to add netlink socket to reactor." );
+        }
+
+        this->reactor = &reactor;
+    }
+
+
     NetlinkUEvent::~NetlinkUEvent()
     {
         // End reader thread
         if ( uEventReaderThread != nullptr )
         {
+            uint64_t n = 1;
             keepWorking = false;          // signal reader thread to exit
+            write( wakefd, &n, sizeof( n ));
             uEventReaderThread->join();   // Wait thread exit
             delete uEventReaderThread;    // clean up
             uEventReaderThread = nullptr;
+
+            close( wakefd );
+            wakefd = -1;
+        }
+
+        // Detach from reactor, if any
+        if ( reactor != nullptr )
+        {
+            reactor->remove( reactorSocketfd );
+            close( reactorSocketfd );
+            reactorSocketfd = -1;
+            reactor = nullptr;
         }
 
     }
 
- 
 
-    void NetlinkUEvent::readerThread()
+    void NetlinkUEvent::setThreadPool( ThreadPool *pool )
+    {
+        this->threadPool = pool;
+    }
+
+
+    /**
+     * Opens a non-blocking netlink socket subscribed to the kernel uevent stream.
+     * @return socket fd, or -1 on error.
+     */
+    static int openSocket()
     {
         struct sockaddr_nl srcAddr{0};
         int socketfd;
         int ret;
 
-        // 1. Configure netlink socket to subscribe to kernel uevent stream
         srcAddr.nl_family = AF_NETLINK;
         srcAddr.nl_pid = getpid();
         srcAddr.nl_groups = -1;
-    
+
         socketfd = socket( AF_NETLINK, (SOCK_DGRAM | SOCK_NONBLOCK), NETLINK_KOBJECT_UEVENT );
         if ( socketfd < 0 )
         {
-            loge( "Netlink reader thread: failed to create netlink socket, could not start." );
-            return;
+            loge( "Netlink: failed to create netlink socket." );
+            return -1;
         }
-    
+
         ret = bind( socketfd, (struct sockaddr *) &srcAddr, sizeof( srcAddr ));
         if ( ret )
         {
-            loge( "Netlink reader thread: failed to bind netlink socket, could not start." );
+            loge( "Netlink: failed to bind netlink socket." );
             close( socketfd );
+            return -1;
+        }
+
+        return socketfd;
+    }
+
+ 
+
+    void NetlinkUEvent::readerThread()
+    {
+        ThreadScope scope( "uevent", "uevent" );
+        int socketfd;
+        int ret;
+
+        // 1. Configure netlink socket to subscribe to kernel uevent stream
+        socketfd = openSocket();
+        if ( socketfd < 0 )
+        {
+            loge( "Netlink reader thread: could not start." );
             return;
-        } 
+        }
 
 
         // 2. Configure epoll on the socket to allow reads with timeouts
-        #define MAX_EPOLL_EVENTS 1
+        #define MAX_EPOLL_EVENTS 2
         struct epoll_event events[MAX_EPOLL_EVENTS];
 
         // Create epoll instance
@@ -130,6 +223,14 @@ namespace lwsdk
         event.data.fd = socketfd;
 
         ret = epoll_ctl( epollfd, EPOLL_CTL_ADD, socketfd, &event);
+
+        // Add wakefd, written to by the destructor
+        if ( ret == 0 )
+        {
+            event.data.fd = wakefd;
+            ret = epoll_ctl( epollfd, EPOLL_CTL_ADD, wakefd, &event );
+        }
+
         if ( ret < 0 )
         {
             loge( "Netlink reader thread: failed to add socket to epoll instance, could not start." );
@@ -148,69 +249,108 @@ namespace lwsdk
             fflush( stdout );
             #endif
 
-            // Wait for socket data available
-            int nReady = epoll_wait( epollfd, events, MAX_EPOLL_EVENTS, 500 /*timeout ms*/ );
+            // Wait for socket data available, or wakefd signaling exit
+            int nReady = epoll_wait( epollfd, events, MAX_EPOLL_EVENTS, -1 );
 
-            if ( nReady < 0 )
+            if ( nReady < 0 && errno == EINTR )
+            {
+                continue;
+            }
+            else if ( nReady < 0 )
             {
                 loge( "Netlink reader thread: epoll_wait() error on netlink socket (errno=%i %s)",
                       errno, strerror( errno ));
                 break;
             }
-            else if ( nReady == 0 || !(events[0].events & EPOLLIN) )
+
+            for ( int i = 0; i < nReady; i++ )
             {
-                continue;
+                if ( events[i].data.fd == socketfd && (events[i].events & EPOLLIN) )
+                    readEvent( socketfd );
             }
 
-            // Read socket data
-            long len = recv( socketfd, buf, sizeof( buf ), 0 );
-            if ( len < 0 && errno != EAGAIN )
+        }   //loop
+
+           
+        // Close socket
+        close( epollfd );
+        close( socketfd );
+        
+        
+        logi( "Netlink reader thread ended." );
+
+    }
+
+
+    void NetlinkUEvent::readEvent( int socketfd )
+    {
+        // Read socket data
+        long len = recv( socketfd, buf, sizeof( buf ), 0 );
+        if ( len < 0 && errno != EAGAIN )
+        {
+            logw( "Netlink reader: read() error on netlink socket (errno=%i %s)",
+                  errno, strerror( errno ));
+
+            // Back off, unless told to exit
+            if ( reactor == nullptr )
             {
-                logw( "Netlink reader thread: read() error on netlink socket (errno=%i %s)",
-                      errno, strerror( errno ));
-                this_thread::sleep_for( chrono::seconds( 1 ));
+                struct pollfd pfd{ wakefd, POLLIN, 0 };
+                poll( &pfd, 1, 1000 );
             }
-            else if ( len > 0 )
-            {
-                logY( "------------------------ UMessage len=%ld ----------------------", len );
+        }
+        else if ( len > 0 )
+        {
+            logY( "------------------------ UMessage len=%ld ----------------------", len );
 
-                // Ignore libudev messages
-                if ( strcmp( "libudev", buf ) == 0 )
-                    continue;
+            metrics().bytes.inc( len );
 
+            // Ignore libudev messages
+            if ( strcmp( "libudev", buf ) == 0 )
+            {
+                metrics().ignored.inc();
+                return;
+            }
 
-                #if LOGGER_ENABLED
-                Utils::memdump( buf, len );
-                #endif
+            metrics().events.inc();
 
-                // Convert all null-terminatord in message to LF \n
-                for ( int i = 0; i < len; i++ )
-                    if ( buf[i] == 0 )
-                        buf[i] = '\n';
 
-                // Call user defined callback
-                try
-                {
-                    uEventCallback( UEvent( string( buf, len )));
-                }
-                catch ( const std::exception &e )
-                {
-                    loge( "User's uEventCallback() finished with errors: %s", e.what());
-                }
+            #if LOGGER_ENABLED
+            Utils::memdump( buf, len );
+            #endif
 
-            }
+            // Convert all null-terminatord in message to LF \n
+            for ( int i = 0; i < len; i++ )
+                if ( buf[i] == 0 )
+                    buf[i] = '\n';
 
+            // Call user defined callback, through the thread pool if any; the event data
+            // is carried in a pooled buffer so the UEvent is created by the worker releasing it
+            auto callback = uEventCallback;
+            uint64_t flowId = Trace::newFlowId();
 
-        }   //loop
+            if ( threadPool != nullptr )
+            {
+                PooledBuffer data = BufferPool::copyOf( buf, len );
+                if ( threadPool->submit( [callback, data, flowId] {
+                        TraceSpan span( "uevent", "event", flowId );
+                        ScopedTimer timer( &metrics().callbackNs );
+                        callback( UEvent( data.str() ));
+                     }) )
+                    return;
+            }
 
-           
-        // Close socket
-        close( epollfd );
-        close( socketfd );
-        
-        
-        logi( "Netlink reader thread ended." );
+            try
+            {
+                TraceSpan span( "uevent", "event", flowId );
+                ScopedTimer timer( &metrics().callbackNs );
+                uEventCallback( UEvent( string( buf, len )));
+            }
+            catch ( const std::exception &e )
+            {
+                loge( "User's uEventCallback() finished with errors: %s", e.what());
+            }
 
+        }
     }
 
 
@@ -0,0 +1,335 @@
+/********************************************************************************
+ *  This file is part of the lopezworks SDK utility library for C/C++ (lwsdk).
+ *
+ *  Copyright (C) 2015-2017 Edwin R. Lopez
+ *  http://www.lopezworks.info
+ *
+ *  This source code is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation LGPL v2.1
+ *  (http://www.gnu.org/licenses/).
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ *  02110-1301  USA.
+ ********************************************************************************/
+#include "Reactor.h"
+#include "Exceptions.h"
+#include "Threads.h"
+
+#include <unistd.h>
+#include <sys/eventfd.h>
+
+#define LOGGER_ENABLED 0   // turn off verbose logging
+#include "Logger.h"
+
+using namespace std;
+
+namespace lwsdk
+{
+    #define MAX_EPOLL_EVENTS 64
+
+    // Reactor dispatching events in the current thread, if any
+    static thread_local Reactor *currentReactor = nullptr;
+
+    Reactor::Reactor()
+    {
+        epollfd = epoll_create1( EPOLL_CLOEXEC );
+        if ( epollfd < 0 )
+            throw RuntimeException( "Failed to create epoll instance", errnoCode() );
+
+        wakefd = eventfd( 0, EFD_NONBLOCK | EFD_CLOEXEC );
+        if ( wakefd < 0 )
+        {
+            int err = errno;
+            ::close( epollfd );
+            throw RuntimeException( "Failed to create eventfd", errnoCode( err ));
+        }
+
+        // The wakeup fd is tagged with its own fd number, same as user fds;
+        // it is told apart in runOnce() by value.
+        struct epoll_event event{0};
+        event.events = EPOLLIN;
+        event.data.fd = wakefd;
+        epoll_ctl( epollfd, EPOLL_CTL_ADD, wakefd, &event );
+
+        // Expired timers run in the reactor thread
+        add( timers.getFd(), EPOLLIN, [this]( uint32_t ) { timers.process(); } );
+    }
+
+
+    Reactor::~Reactor()
+    {
+        stop();
+
+        ::close( wakefd );
+        ::close( epollfd );
+    }
+
+
+    bool Reactor::add( int fd, uint32_t events, const ReactorHandler_t& handler )
+    {
+        if ( fd < 0 || handler == nullptr )
+            return false;
+
+        lock_guard lock( mtx );
+
+        struct epoll_event event{0};
+        event.events = events;
+        event.data.fd = fd;
+
+        if ( epoll_ctl( epollfd, EPOLL_CTL_ADD, fd, &event ) < 0 )
+        {
+            logw( "Failed to add fd=%d to reactor (errno=%i %s)", fd, errno, strerror( errno ));
+            return false;
+        }
+
+        handlers[ fd ] = make_shared<ReactorHandler_t>( handler );
+        return true;
+    }
+
+
+    bool Reactor::modify( int fd, uint32_t events )
+    {
+        lock_guard lock( mtx );
+
+        if ( handlers.find( fd ) == handlers.end() )
+            return false;
+
+        struct epoll_event event{0};
+        event.events = events;
+        event.data.fd = fd;
+
+        return epoll_ctl( epollfd, EPOLL_CTL_MOD, fd, &event ) == 0;
+    }
+
+
+    bool Reactor::remove( int fd )
+    {
+        lock_guard lock( mtx );
+
+        if ( handlers.erase( fd ) == 0 )
+            return false;
+
+        epoll_ctl( epollfd, EPOLL_CTL_DEL, fd, nullptr );
+        return true;
+    }
+
+
+    void Reactor::post( const ReactorTask_t& task )
+    {
+        {
+            lock_guard lock( mtx );
+            tasks.push_back( task );
+        }
+
+        wakeup();
+    }
+
+
+    uint64_t Reactor::runAfter( uint32_t delayMs, const ReactorTask_t& task, uint32_t periodMs )
+    {
+        return timers.schedule( delayMs, task, periodMs );
+    }
+
+
+    bool Reactor::cancel( uint64_t timerId )
+    {
+        return timers.cancel( timerId );
+    }
+
+
+    Timers& Reactor::getTimers()
+    {
+        return timers;
+    }
+
+
+    void Reactor::run()
+    {
+        keepWorking = true;
+        loop();
+    }
+
+
+    /**
+     * Runs the event loop in the calling thread until keepWorking is cleared. Does not set
+     * keepWorking itself, so a stop() issued before a thread started by start() gets here
+     * is not undone.
+     */
+    void Reactor::loop()
+    {
+        loopThreadId = this_thread::get_id();
+
+        logi( "Reactor loop started ..." );
+
+        while ( keepWorking )
+        {
+            if ( runOnce( -1 ) < 0 )
+                break;
+        }
+
+        loopThreadId = thread::id();
+        currentReactor = nullptr;
+
+        logi( "Reactor loop ended." );
+    }
+
+
+    int Reactor::runOnce( int timeoutMsec )
+    {
+        struct epoll_event events[ MAX_EPOLL_EVENTS ];
+
+        // Only set while dispatching, restored for manual runOnce() callers
+        Reactor *previous = currentReactor;
+        currentReactor = this;
+
+        int nReady = epoll_wait( epollfd, events, MAX_EPOLL_EVENTS, timeoutMsec );
+
+        if ( nReady < 0 )
+        {
+            currentReactor = previous;
+
+            if ( errno == EINTR )
+                return 0;
+
+            loge( "Reactor epoll_wait() error (errno=%i %s)", errno, strerror( errno ));
+            return -1;
+        }
+
+        int dispatched = 0;
+
+        for ( int i = 0; i < nReady; i++ )
+        {
+            int fd = events[i].data.fd;
+
+            if ( fd == wakefd )
+            {
+                uint64_t n;
+                ::read( wakefd, &n, sizeof( n ));
+                continue;
+            }
+
+            // Copy handler out so it can remove itself (or others) while running
+            shared_ptr<ReactorHandler_t> handler;
+            {
+                lock_guard lock( mtx );
+                auto it = handlers.find( fd );
+                if ( it != handlers.end() )
+                    handler = it->second;
+            }
+
+            if ( !handler )
+                continue;
+
+            try
+            {
+                (*handler)( events[i].events );
+            }
+            catch ( const std::exception& e )
+            {
+                loge( "Reactor handler for fd=%d finished with errors: %s", fd, e.what() );
+            }
+
+            dispatched++;
+        }
+
+        runTasks();
+
+        currentReactor = previous;
+        return dispatched;
+    }
+
+
+    void Reactor::start()
+    {
+        if ( reactorThread != nullptr )
+            return;
+
+        keepWorking = true;
+        reactorThread = new thread( [this] {
+            ThreadScope scope( "reactor", "reactor" );
+            loop();
+        });
+    }
+
+
+    void Reactor::stop()
+    {
+        keepWorking = false;
+        wakeup();
+
+        // Called from a task or handler, the thread cannot join itself; the loop exits once
+        // the caller returns, and a later stop() or the destructor joins it
+        if ( isReactorThread() )
+            return;
+
+        if ( reactorThread != nullptr )
+        {
+            reactorThread->join();
+            delete reactorThread;
+            reactorThread = nullptr;
+        }
+    }
+
+
+    bool Reactor::isRunning()
+    {
+        return keepWorking;
+    }
+
+
+    bool Reactor::isReactorThread()
+    {
+        return loopThreadId.load() == this_thread::get_id();
+    }
+
+
+    Reactor* Reactor::current()
+    {
+        return currentReactor;
+    }
+
+
+    /**
+     * Wake the reactor loop if blocked in epoll_wait().
+     */
+    void Reactor::wakeup()
+    {
+        uint64_t n = 1;
+        ::write( wakefd, &n, sizeof( n ));
+    }
+
+
+    /**
+     * Runs all tasks posted so far.
+     */
+    void Reactor::runTasks()
+    {
+        deque<ReactorTask_t> pending;
+
+        {
+            lock_guard lock( mtx );
+            pending.swap( tasks );
+        }
+
+        for ( auto& task : pending )
+        {
+            try
+            {
+                task();
+            }
+            catch ( const std::exception& e )
+            {
+                loge( "Reactor task finished with errors: %s", e.what() );
+            }
+        }
+    }
+
+} // ns
@@ -25,6 +25,7 @@
 #include <mutex>
 #include <thread>
 #include <optional>
+#include <deque>
 
 
 // serial port
@@ -34,6 +35,8 @@
 #include <cstring>
 #include <cerrno>
 #include <sys/inotify.h>
+#include <sys/eventfd.h>
+#include <poll.h>
 #include <sys/stat.h>
 #include <string>
 
@@ -43,6 +46,12 @@
 #include "Exceptions.h"
 #include "Utils.h"
 #include "ConcurrentQueue.h"
+#include "Reactor.h"
+#include "ThreadPool.h"
+#include "BufferPool.h"
+#include "Metrics.h"
+#include "Trace.h"
+#include "Threads.h"
 
 #define LOGGER_ENABLED 0   // turn off verbose logging
 #include "Logger.h"
@@ -52,13 +61,35 @@ using namespace std;
 
 namespace lwsdk
 {
+    /**
+     * User callbacks waiting to run in the thread pool. At most one pool task drains
+     * the queue at a time, so the callbacks of a port never overlap or reorder.
+     */
+    struct SerialPort::CallbackQueue
+    {
+        std::mutex mtx;
+        std::deque<std::function<void()>> tasks;
+        bool draining{false};
+    };
+
 
     SerialPort::SerialPort()
     {
-        // Start reader thread
+        // The reader thread is started by the first open(), once the port name is known;
+        // it is woken up via wakefd when the port is re-opened or on exit
+        wakefd = eventfd( 0, EFD_NONBLOCK | EFD_CLOEXEC );
+        if ( wakefd < 0 )
+            throw RuntimeException( "Failed to create eventfd", errnoCode() );
+
         keepWorking = true;
         isConnected = false;
-        portReaderThread = new thread( &SerialPort::readerThread, this );
+    }
+
+    SerialPort::SerialPort( Reactor& reactor )
+    {
+        // No reader thread, the port fd is watched by the reactor while open
+        this->reactor = &reactor;
+        isConnected = false;
     }
 
     SerialPort::~SerialPort()
@@ -67,11 +98,18 @@ namespace lwsdk
         if ( portReaderThread != nullptr )
         {
             keepWorking = false;        // signal reader thread to exit
+            wakeup();
             portReaderThread->join();   // Wait thread exit
             delete portReaderThread;    // clean up
             portReaderThread = nullptr;
         }
 
+        if ( wakefd >= 0 )
+        {
+            ::close( wakefd );
+            wakefd = -1;
+        }
+
         // Close port
         close();
     }
@@ -140,6 +178,15 @@ namespace lwsdk
     }
 
 
+    void SerialPort::setThreadPool( ThreadPool *pool )
+    {
+        this->threadPool = pool;
+
+        if ( pool != nullptr && !callbackQueue )
+            callbackQueue = make_shared<CallbackQueue>();
+    }
+
+
     bool SerialPort::isOpen()
     {
         return isConnected;
@@ -189,19 +236,35 @@ namespace lwsdk
             //logi( "Wrote to %s (%d of %d) bytes", portName.c_str(), count, len );
         } // while
 
+        if ( txBytesMetric )
+            txBytesMetric->inc( count );
+
         return count;
     }
 
     
     bool SerialPort::close()
     {
-        int ret = 0;
         clearErrors();
+        return closePort();
+    }
+
+
+    /**
+     * Closes the port keeping the current error, if any, so it is still there for the
+     * status callback and getErrors() when the reader closes the port on failure.
+     */
+    bool SerialPort::closePort()
+    {
+        int ret = 0;
 
 
         // Close port
         if ( portfd > 0 )
         {
+            if ( reactor != nullptr )
+                reactor->remove( portfd );
+
             ret = ::close( portfd );
             if ( ret != 0 )
             {
@@ -232,6 +295,11 @@ namespace lwsdk
         close();
         clearErrors();
 
+        // Metrics are kept per port name, so they survive re-opening the port
+        rxBytesMetric = &Metrics::counter( "serialport", "rx_bytes", portName, "Bytes received" );
+        txBytesMetric = &Metrics::counter( "serialport", "tx_bytes", portName, "Bytes sent" );
+        rxLinesMetric = &Metrics::counter( "serialport", "rx_lines", portName, "Text lines received" );
+
         // Open port
         portfd = ::open( portName.c_str(), O_RDWR );
 
@@ -339,9 +407,27 @@ namespace lwsdk
             return false;
         }
 
-        // Tell reader thread port is ready
+        // Hand port over to the reactor, if any
+        if ( reactor != nullptr &&
+             !reactor->add( portfd, EPOLLIN, [this]( uint32_t events ) { readerEvent( events ); } ))
+        {
+            close();
+
+            snprintf( lastError, sizeof( lastError ), "Failed to add %s to reactor", portName.c_str() );
+            logw( "%s", lastError );
+
+            return false;
+        }
+
+        // Tell reader thread port is ready, starting it named after the port on first use
         isConnected = true;
 
+        if ( reactor == nullptr && portReaderThread == nullptr )
+            portReaderThread = new thread( &SerialPort::readerThread, this,
+                                           "sp:" + portName.substr( portName.rfind( '/' ) + 1 ));
+        else
+            wakeup();
+
         logi( "Opened serial port %s", portName.c_str());
 
         // Notify user callback if any
@@ -353,13 +439,12 @@ namespace lwsdk
 
     }
 
-    void SerialPort::readerThread()
+    void SerialPort::readerThread( const std::string& threadName )
     {
+        ThreadScope scope( "serialport", threadName );
         bool lastConnectionState = true;
-        struct stat st{};
         char buf[255];
-        size_t len;
-        string line;
+        long len;
 
 
         logi( "Reader thread started on serial port %s", portName.c_str());
@@ -378,10 +463,31 @@ namespace lwsdk
                        isConnected ? "ACTIVE" : "STANDBY" );
             }
 
-            // If not connected, do short sleeps while standing by for port getting open
+            // Wait for port data, or for wakefd to signal the port got open or the thread
+            // must exit. The timeout is only used to poll for a removed device.
+            struct pollfd fds[2] = { { wakefd, POLLIN, 0 }, { isConnected ? portfd : -1, POLLIN, 0 } };
+
+            if ( poll( fds, 2, 500 ) < 0 && errno != EINTR )
+            {
+                loge( "Reader thread poll() error on %s (errno=%i %s)", portName.c_str(), errno, strerror( errno ));
+                break;
+            }
+
+            if ( fds[0].revents & POLLIN )
+            {
+                uint64_t n;
+                ::read( wakefd, &n, sizeof( n ));
+                continue;
+            }
+
             if ( !isConnected )
+                continue;
+
+            if ( !(fds[1].revents & (POLLIN | POLLHUP | POLLERR)) )
             {
-                std::this_thread::sleep_for( chrono::milliseconds(500) );
+                if ( isPortRemoved() )
+                    closePort();
+
                 continue;
             }
 
@@ -390,84 +496,246 @@ namespace lwsdk
             fflush( stdout );
             #endif
 
-            len = read( portfd, buf, sizeof(buf) ); // blocks until VTIME timeout
+            len = read( portfd, buf, sizeof(buf) ); // data is available, does not wait for VTIME
 
-            if ( len < 0 || errno != 0 )
+            if ( len < 0 && errno != EAGAIN && errno != EINTR )
             {
                 snprintf( lastError, sizeof( lastError ), "Failed to read from %s - errno=%i, %s",
                           portName.c_str(), errno, strerror(errno));
 
                 logw( "%s", lastError );
 
-                close();
+                closePort();
             }
             else if (len > 0)
             {
-                // call user defined data callback -- if any
-                if ( dataCallback )
+                processInput( buf, len );
+            }
+            else if ( fds[1].revents & (POLLHUP | POLLERR) )
+            {
+                // The tty hung up but its node is still there; poll() would keep returning
+                // right away with nothing to read, so close and go to standby
+                snprintf( lastError, sizeof( lastError ), "Serial port %s hung up", portName.c_str() );
+                logw( "%s", lastError );
+
+                closePort();
+            }
+            else if ( isPortRemoved() )
+            {
+                closePort();
+            }
+
+        }
+
+
+        logi( "Reader thread ended on serial port %s", portName.c_str());
+
+    }
+
+
+    /**
+     * Wake the reader thread if blocked waiting for data.
+     */
+    void SerialPort::wakeup()
+    {
+        uint64_t n = 1;
+
+        if ( wakefd >= 0 )
+            ::write( wakefd, &n, sizeof( n ));
+    }
+
+
+    void SerialPort::readerEvent( uint32_t events )
+    {
+        char buf[255];
+
+        if ( portfd < 0 )
+            return;
+
+        // Data is available, so this read() does not wait for VTIME
+        long len = read( portfd, buf, sizeof(buf) );
+
+        if ( len > 0 )
+        {
+            processInput( buf, len );
+        }
+        else if ( len < 0 && errno != EAGAIN )
+        {
+            snprintf( lastError, sizeof( lastError ), "Failed to read from %s - errno=%i, %s",
+                      portName.c_str(), errno, strerror(errno));
+
+            logw( "%s", lastError );
+
+            closePort();
+        }
+        else if ( (events & (EPOLLHUP | EPOLLERR)) || isPortRemoved() )
+        {
+            closePort();
+        }
+    }
+
+
+    /**
+     * Test if the /dev/ttyXXXX device was removed, this is likely to occur when the
+     * USB-to-serial cable is unplugged.
+     */
+    bool SerialPort::isPortRemoved()
+    {
+        struct stat st{};
+
+        // A read() returning 0 means either a timeout occurred or the device was
+        // removed; check the stat.st_nlink to see if it is still >= 1
+        fstat( portfd, &st );
+
+        if ( st.st_nlink == 0 )
+        {
+            snprintf( lastError, sizeof( lastError ), "No longer detecting serial port %s",
+                      portName.c_str() );
+
+            logw( "%s", lastError );
+
+            return true;
+        }
+
+        return false;
+    }
+
+
+    /**
+     * Delivers received data to the user callbacks.
+     */
+    void SerialPort::processInput( const char *buf, size_t len )
+    {
+        TraceSpan span( "serialport", "input" );
+
+        if ( rxBytesMetric )
+            rxBytesMetric->inc( len );
+
+        // call user defined data callback -- if any
+        if ( dataCallback && threadPool != nullptr )
+        {
+            PooledBuffer data = BufferPool::copyOf( buf, len );
+            auto callback = dataCallback;
+            auto name = portName;
+
+            deliver( [callback, name, data] { callback( name, data.data(), (uint32_t) data.size() ); } );
+        }
+        else if ( dataCallback )
+        {
+            try
+            {
+                dataCallback( portName, buf, len );
+            }
+            catch ( const std::exception& e )
+            {
+                loge( "User's dataCallback() finished with errors: %s", e.what() );
+            }
+        }
+
+        #if LOGGER_ENABLED
+        Utils::memdump( buf, len );
+        #endif
+
+        // call user defined line callback -- if any
+        if ( lineCallback )
+        {
+
+            line.append( buf, len );
+            string s;
+
+            while ( !(s = Strings::findMatch(line,"[^\r\n]*(\r\n|\r|\n)")).empty() )
+            {
+                try
                 {
-                    try
+                    line.erase(0, s.length() );
+                    s = Strings::replaceAll(s, "[\r\n]+$", "");
+
+                    if ( rxLinesMetric )
+                        rxLinesMetric->inc();
+
+                    auto callback = lineCallback;
+                    auto name = portName;
+                    uint64_t flowId = Trace::newFlowId();
+
+                    // Each line starts a trace flow, followed into whatever the callback triggers
+                    if ( threadPool != nullptr )
                     {
-                        dataCallback( portName, buf, len );
+                        deliver( [callback, name, s, flowId] {
+                            TraceSpan lineSpan( "serialport", "line", flowId );
+                            callback( name, s );
+                        });
                     }
-                    catch ( const std::exception& e )
+                    else
                     {
-                        loge( "User's dataCallback() finished with errors: %s", e.what() );
+                        TraceSpan lineSpan( "serialport", "line", flowId );
+                        lineCallback( portName, s );
                     }
                 }
-
-                #if LOGGER_ENABLED
-                Utils::memdump( buf, len );
-                #endif
-
-                // call user defined line callback -- if any
-                if ( lineCallback )
+                catch ( const std::exception& e )
                 {
+                    loge( "User's dataCallback() finished with errors: %s", e.what() );
+                }
+            } //while
+        }
+    }
 
-                    line.append( buf, len );
-                    string s;
-
-                    while ( !(s = Strings::findMatch(line,"[^\r\n]*(\r\n|\r|\n)")).empty() )
-                    {      
-                        try
-                        {
-                            line.erase(0, s.length() );
-                            s = Strings::replaceAll(s, "[\r\n]+$", "");
-                            lineCallback( portName, s );
-                        }
-                        catch ( const std::exception& e )
-                        {
-                            loge( "User's dataCallback() finished with errors: %s", e.what() );
-                        }
-                    } //while
-                } 
 
 
-            }
-            else
-            {
-                // here len=0 means either a read() timeout occurred
-                // or that the /dev/ttyXXXX device was removed
-                // Check the stat.st_nlink to see if it is still >= 1
-                fstat( portfd, &st );
+    /**
+     * Queues a user callback for the thread pool. A drain task is submitted only if none
+     * is already running; if the pool rejects it, the queue is drained inline instead.
+     */
+    void SerialPort::deliver( std::function<void()> task )
+    {
+        auto queue = callbackQueue;
 
-                if ( st.st_nlink == 0 )
-                {
-                    // This is likely to occur when the USB-to-serial cable is unplugged
-                    snprintf( lastError, sizeof( lastError ), "No longer detecting serial port %s",
-                              portName.c_str() );
+        {
+            lock_guard<mutex> lock( queue->mtx );
 
-                    logw( "%s", lastError );
+            queue->tasks.push_back( std::move( task ) );
 
-                    close();
-                }
-            }
+            if ( queue->draining )
+                return;
 
+            queue->draining = true;
         }
 
+        if ( !threadPool->submit( [queue] { drainCallbacks( queue ); } ) )
+            drainCallbacks( queue );
+    }
 
-        logi( "Reader thread ended on serial port %s", portName.c_str());
 
+    /**
+     * Runs the queued callbacks in order until the queue is empty.
+     */
+    void SerialPort::drainCallbacks( const shared_ptr<CallbackQueue>& queue )
+    {
+        while ( true )
+        {
+            std::function<void()> task;
+
+            {
+                lock_guard<mutex> lock( queue->mtx );
+
+                if ( queue->tasks.empty() )
+                {
+                    queue->draining = false;
+                    return;
+                }
+
+                task = std::move( queue->tasks.front() );
+                queue->tasks.pop_front();
+            }
+
+            try
+            {
+                task();
+            }
+            catch ( const std::exception& e )
+            {
+                loge( "User's callback finished with errors: %s", e.what() );
+            }
+        }
     }
 
 
@@ -21,6 +21,9 @@
  ********************************************************************************/
 #include <algorithm>
 #include <fstream>
+#include <climits>
+#include <cerrno>
+#include <cstdlib>
 #include "Strings.h"
 #include "Files.h"
 #include "Exceptions.h"
@@ -183,55 +186,93 @@ namespace lwsdk::Strings
     }
 
 
-    int parseInt( const string& s, const int& defVal )
+    /**
+     * Converts the given string with strtol(), the function behind stol(), reporting
+     * failures as error codes instead of exceptions.
+     */
+    static Expected<long> toLong( const string& s, int base )
     {
-        try { return stoi( s ); } catch (...) { return defVal; }
+        const char *begin = s.c_str();
+        char *end;
+
+        errno = 0;
+        long val = strtol( begin, &end, base );
+
+        if ( end == begin )
+            return errc::invalid_argument;
+
+        if ( errno == ERANGE )
+            return errc::result_out_of_range;
+
+        return val;
     }
 
 
-    long parseLong( const string& s, const long& defVal )
+    Expected<int> tryParseInt( const string& s )
     {
-        try { return stol( s ); } catch (...) { return defVal; }
+        Expected<long> val = toLong( s, 10 );
+
+        if ( !val )
+            return val.error();
+
+        if ( *val < INT_MIN || *val > INT_MAX )
+            return errc::result_out_of_range;
+
+        return (int) *val;
     }
 
 
-    double parseDouble( const string& s, const double& defVal )
+    Expected<long> tryParseLong( const string& s )
     {
-        try { return stod( s ); } catch (...) { return defVal; }
+        return toLong( s, 10 );
     }
 
 
-    long parseHex( const string& s, const long& defVal )
+    Expected<long> tryParseHex( const string& s )
     {
-        try { return stol( s, 0, 16 ); } catch (...) { return defVal; }
+        return toLong( s, 16 );
     }
 
 
-    bool startsWith( const string& s, const string& prefix )
+    Expected<double> tryParseDouble( const string& s )
     {
-        if ( prefix.length() > s.length() )
-            return false;
+        const char *begin = s.c_str();
+        char *end;
+
+        errno = 0;
+        double val = strtod( begin, &end );
+
+        if ( end == begin )
+            return errc::invalid_argument;
+
+        if ( errno == ERANGE )
+            return errc::result_out_of_range;
+
+        return val;
+    }
 
-        size_t n = 0;
-        while ( n < prefix.length() && s[n] == prefix[n] )
-            n++;
 
-        return n == prefix.length();
+    int parseInt( const string& s, const int& defVal )
+    {
+        return tryParseInt( s ).valueOr( defVal );
     }
 
 
-    bool endsWith( const string& s, const string& suffix )
+    long parseLong( const string& s, const long& defVal )
     {
-        if ( suffix.length() > s.length() )
-            return false;
+        return tryParseLong( s ).valueOr( defVal );
+    }
 
-        size_t n = s.length() - suffix.length();
-        size_t i = 0;
 
-        while ( n < s.length() && s[n] == suffix[i++] )
-            n++;
+    double parseDouble( const string& s, const double& defVal )
+    {
+        return tryParseDouble( s ).valueOr( defVal );
+    }
 
-        return n == s.length();
+
+    long parseHex( const string& s, const long& defVal )
+    {
+        return tryParseHex( s ).valueOr( defVal );
     }
 
 
@@ -353,10 +394,4 @@ namespace lwsdk::Strings
         return { diff < 0 ? EMPTY_STRING : string( firstNonSpacePos, lastNonSpacePos ) };
     }
 
-
-    bool isEmpty( const string &s )
-    {
-        return trim(s).empty();
-    }
-
 }
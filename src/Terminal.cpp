@@ -20,10 +20,12 @@
  *  02110-1301  USA.
  ********************************************************************************/
 #include "Terminal.h"
+#include "Reactor.h"
 
 #include <ctime>
 #include <cstdio>
 #include <cstdlib>
+#include <cerrno>
 #include <unistd.h>
 #include <termios.h>
 
@@ -66,7 +68,10 @@ namespace lwsdk::Terminal
     }
 
 
-    bool kbhit()
+    /**
+     * Turn off canonical mode once, restoring it when the program exits.
+     */
+    static void init()
     {
         static int inited = 0;
         if ( !inited )
@@ -75,6 +80,12 @@ namespace lwsdk::Terminal
             inited = 1;
             atexit( reset );
         }
+    }
+
+
+    bool kbhit()
+    {
+        init();
 
         struct timeval tv{};
         fd_set fds;
@@ -88,4 +99,34 @@ namespace lwsdk::Terminal
         return FD_ISSET( STDIN_FILENO, &fds ) != 0;
     }
 
+
+    bool attach( Reactor& reactor, const KeyCallback_t& keyCallback )
+    {
+        if ( keyCallback == nullptr )
+            return false;
+
+        init();
+
+        return reactor.add( STDIN_FILENO, EPOLLIN, [keyCallback, &reactor]( uint32_t ) {
+            char keys[32];
+            long n = read( STDIN_FILENO, keys, sizeof( keys ));
+
+            // stdin closed or failed, stop watching it or EPOLLIN would fire forever
+            if ( n == 0 || (n < 0 && errno != EAGAIN && errno != EINTR) )
+            {
+                reactor.remove( STDIN_FILENO );
+                return;
+            }
+
+            for ( long i = 0; i < n; i++ )
+                keyCallback( keys[i] );
+        });
+    }
+
+
+    void detach( Reactor& reactor )
+    {
+        reactor.remove( STDIN_FILENO );
+    }
+
 } //ns
\ No newline at end of file
@@ -0,0 +1,302 @@
+/********************************************************************************
+ *  This file is part of the lopezworks SDK utility library for C/C++ (lwsdk).
+ *
+ *  Copyright (C) 2015-2017 Edwin R. Lopez
+ *  http://www.lopezworks.info
+ *
+ *  This source code is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation LGPL v2.1
+ *  (http://www.gnu.org/licenses/).
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ *  02110-1301  USA.
+ ********************************************************************************/
+#include "ThreadPool.h"
+#include "Threads.h"
+
+#include <chrono>
+#include <pthread.h>
+#include <sched.h>
+
+#define LOGGER_ENABLED 0   // turn off verbose logging
+#include "Logger.h"
+
+using namespace std;
+
+namespace lwsdk
+{
+    // Identifies the pool and worker index of the current thread, if any, so tasks
+    // submitted from within a task go to the submitting worker's own deque.
+    static thread_local ThreadPool *currentPool = nullptr;
+    static thread_local int currentWorker = -1;
+
+
+    ThreadPool::ThreadPool( int threadCount, const std::vector<int>& cpus )
+    {
+        if ( threadCount <= 0 )
+            threadCount = (int) max( 1u, thread::hardware_concurrency() );
+
+        this->cpus = cpus;
+        keepWorking = true;
+
+        for ( int i = 0; i < threadCount; i++ )
+            workers.emplace_back( make_unique<Worker>() );
+
+        // Start threads only after all workers exist, since they steal from each other
+        for ( int i = 0; i < threadCount; i++ )
+            workers[i]->thread = new thread( &ThreadPool::workerThread, this, i );
+    }
+
+
+    ThreadPool::~ThreadPool()
+    {
+        shutdown( UINT32_MAX );
+    }
+
+
+    bool ThreadPool::shutdown( uint32_t timeoutMsec )
+    {
+        if ( workers.empty() || workers[0]->thread == nullptr )
+            return true;
+
+        // A worker cannot join itself
+        if ( currentPool == this )
+        {
+            loge( "Thread pool cannot be shut down from one of its own tasks" );
+            return false;
+        }
+
+        auto deadline = chrono::steady_clock::now() + chrono::milliseconds( timeoutMsec );
+        int discarded = 0;
+
+        {
+            unique_lock<mutex> ulock( mtx );
+            keepWorking = false;
+            cv.notify_all();
+
+            // Workers signal when the last queued task was picked up
+            if ( !drainedCv.wait_until( ulock, deadline, [this] { return pending <= 0; } ) )
+            {
+                for ( auto& worker : workers )
+                {
+                    lock_guard lock( worker->mtx );
+
+                    for ( auto& tasks : worker->tasks )
+                    {
+                        discarded += (int) tasks.size();
+                        pending -= (int) tasks.size();
+                        tasks.clear();
+                    }
+                }
+
+                {
+                    lock_guard lock( injectedMtx );
+
+                    for ( auto& tasks : injected )
+                    {
+                        discarded += (int) tasks.size();
+                        pending -= (int) tasks.size();
+                        tasks.clear();
+                    }
+                }
+
+                logw( "Thread pool discarded %d tasks on shutdown", discarded );
+                cv.notify_all();
+            }
+        }
+
+        for ( auto& worker : workers )
+        {
+            worker->thread->join();
+            delete worker->thread;
+            worker->thread = nullptr;
+        }
+
+        return discarded == 0;
+    }
+
+
+    bool ThreadPool::submit( const PoolTask_t& task, TaskPriority priority )
+    {
+        // While shutting down, only tasks spawned by running tasks are accepted
+        if ( task == nullptr || (!keepWorking && currentPool != this) )
+            return false;
+
+        // Tasks spawned by a worker stay local, others go to the shared queue
+        if ( currentPool == this )
+        {
+            Worker& worker = *workers[ currentWorker ];
+            lock_guard lock( worker.mtx );
+            worker.tasks[ priority ].push_back( task );
+        }
+        else
+        {
+            lock_guard lock( injectedMtx );
+            injected[ priority ].push_back( task );
+        }
+
+        {
+            lock_guard lock( mtx );
+            pending++;
+        }
+
+        cv.notify_one();
+
+        return true;
+    }
+
+
+    int ThreadPool::getThreadCount()
+    {
+        return (int) workers.size();
+    }
+
+
+    int ThreadPool::getPendingCount()
+    {
+        return max( 0, pending.load() );
+    }
+
+
+    /**
+     * Takes the oldest task of the given priority from the shared queue, if any.
+     */
+    bool ThreadPool::takeInjected( int priority, PoolTask_t& task )
+    {
+        lock_guard lock( injectedMtx );
+
+        if ( injected[ priority ].empty() )
+            return false;
+
+        task = std::move( injected[ priority ].front() );
+        injected[ priority ].pop_front();
+        return true;
+    }
+
+
+    /**
+     * Picks the next task, highest priority first: newest from the worker's own deque,
+     * otherwise oldest from the shared queue, otherwise oldest from any other worker's
+     * deque. Every INJECTED_CHECK_PERIOD picks the shared queue goes first, so tasks
+     * spawning tasks cannot starve it. Runs the task and returns true; returns false if
+     * no task was found.
+     */
+    bool ThreadPool::runNext( int index )
+    {
+        static const uint32_t INJECTED_CHECK_PERIOD = 61;
+
+        PoolTask_t task;
+        int n = (int) workers.size();
+        Worker& self = *workers[ index ];
+        bool injectedFirst = (++self.picks % INJECTED_CHECK_PERIOD) == 0;
+
+        for ( int p = PRIORITY_HIGH; p <= PRIORITY_LOW && !task; p++ )
+        {
+            if ( injectedFirst && takeInjected( p, task ))
+                break;
+
+            {
+                lock_guard lock( self.mtx );
+
+                if ( !self.tasks[p].empty() )
+                {
+                    task = std::move( self.tasks[p].back() );
+                    self.tasks[p].pop_back();
+                    break;
+                }
+            }
+
+            if ( takeInjected( p, task ))
+                break;
+
+            // Steal, starting from the next worker to spread contention
+            for ( int i = 1; i < n; i++ )
+            {
+                Worker& victim = *workers[ (index + i) % n ];
+                lock_guard lock( victim.mtx );
+
+                if ( !victim.tasks[p].empty() )
+                {
+                    task = std::move( victim.tasks[p].front() );
+                    victim.tasks[p].pop_front();
+                    break;
+                }
+            }
+        }
+
+        if ( !task )
+            return false;
+
+        // Let shutdown() know the queues are drained
+        if ( --pending <= 0 && !keepWorking )
+        {
+            lock_guard lock( mtx );
+            drainedCv.notify_all();
+        }
+
+        try
+        {
+            task();
+        }
+        catch ( const std::exception& e )
+        {
+            loge( "Thread pool task finished with errors: %s", e.what() );
+        }
+
+        return true;
+    }
+
+
+    /**
+     * Worker thread loop, runs tasks until the pool is destroyed and no tasks are left.
+     */
+    void ThreadPool::workerThread( int index )
+    {
+        ThreadScope scope( "threadpool", "pool-" + to_string( index ));
+
+        currentPool = this;
+        currentWorker = index;
+
+        // Pin worker to its CPU, if requested; overrides the subsystem's CPU set
+        if ( !cpus.empty() )
+        {
+            cpu_set_t cpuset;
+            CPU_ZERO( &cpuset );
+            CPU_SET( cpus[ index % cpus.size() ], &cpuset );
+
+            if ( pthread_setaffinity_np( pthread_self(), sizeof( cpuset ), &cpuset ) != 0 )
+                logw( "Thread pool worker %d could not be pinned to cpu %d", index, cpus[ index % cpus.size() ] );
+        }
+
+        logi( "Thread pool worker %d started ...", index );
+
+        while ( true )
+        {
+            if ( runNext( index ) )
+                continue;
+
+            unique_lock<mutex> ulock( mtx );
+
+            // tip: when receiving notification, cv.wait() unblocks when the lambda expression yields true
+            cv.wait( ulock, [this] { return pending > 0 || !keepWorking; } );
+
+            // Exit once shut down and drained
+            if ( !keepWorking && pending <= 0 )
+                break;
+        }
+
+        currentPool = nullptr;
+        currentWorker = -1;
+
+        logi( "Thread pool worker %d ended.", index );
+    }
+
+} // ns
@@ -0,0 +1,276 @@
+/********************************************************************************
+ *  This file is part of the lopezworks SDK utility library for C/C++ (lwsdk).
+ *
+ *  Copyright (C) 2015-2017 Edwin R. Lopez
+ *  http://www.lopezworks.info
+ *
+ *  This source code is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation LGPL v2.1
+ *  (http://www.gnu.org/licenses/).
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ *  02110-1301  USA.
+ ********************************************************************************/
+#include "Threads.h"
+#include "Strings.h"
+#include "Alloc.h"
+#include "Trace.h"
+
+#include <map>
+#include <mutex>
+#include <chrono>
+#include <fstream>
+#include <algorithm>
+#include <pthread.h>
+#include <sched.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/mempolicy.h>
+
+#define LOGGER_ENABLED 0   // turn off verbose logging
+#include "Logger.h"
+
+using namespace std;
+
+namespace lwsdk
+{
+    struct RunningThread
+    {
+        string    subsystem;
+        string    name;
+        long      tid;
+        pthread_t handle;
+        chrono::steady_clock::time_point started;
+    };
+
+    static mutex threadsMutex;
+    static map<string, ThreadAttributes> subsystemAttributes;
+    static map<long, RunningThread> runningThreads;     // indexed by tid
+
+
+    /**
+     * Returns the CPUs of a NUMA node, as listed in /sys/devices/system/node/nodeN/cpulist,
+     * e.g. "0-3,8-11".
+     */
+    static vector<int> numaNodeCpus( int node )
+    {
+        vector<int> cpus;
+        ifstream in( "/sys/devices/system/node/node" + to_string( node ) + "/cpulist" );
+        string cpulist;
+
+        if ( !getline( in, cpulist ))
+            return cpus;
+
+        for ( auto& range : Strings::split( Strings::trim( cpulist ), "," ))
+        {
+            auto bounds = Strings::split( range, "-" );
+            if ( bounds.empty() || bounds[0].empty() )
+                continue;
+
+            int first = stoi( bounds[0] );
+            int last = bounds.size() > 1 ? stoi( bounds[1] ) : first;
+
+            for ( int cpu = first; cpu <= last; cpu++ )
+                cpus.push_back( cpu );
+        }
+
+        return cpus;
+    }
+
+
+    void Threads::setAttributes( const std::string& subsystem, const ThreadAttributes& attributes )
+    {
+        lock_guard lock( threadsMutex );
+        subsystemAttributes[ subsystem ] = attributes;
+    }
+
+
+    ThreadAttributes Threads::getAttributes( const std::string& subsystem )
+    {
+        lock_guard lock( threadsMutex );
+        string key = subsystem;
+
+        while ( true )
+        {
+            auto it = subsystemAttributes.find( key );
+            if ( it != subsystemAttributes.end() )
+                return it->second;
+
+            size_t dot = key.rfind( '.' );
+            if ( dot == string::npos )
+                return ThreadAttributes();
+
+            key = key.substr( 0, dot );
+        }
+    }
+
+
+    bool Threads::apply( const ThreadAttributes& attributes )
+    {
+        bool ok = true;
+        pthread_t self = pthread_self();
+
+        if ( !attributes.name.empty() )
+        {
+            // Kernel thread names are limited to 15 chars
+            if ( pthread_setname_np( self, attributes.name.substr( 0, 15 ).c_str() ) != 0 )
+            {
+                logw( "Could not set thread name '%s'", attributes.name.c_str() );
+                ok = false;
+            }
+        }
+
+        // CPU set, restricted to the NUMA node's CPUs if one is given
+        vector<int> cpus = attributes.cpus;
+
+        if ( attributes.numaNode >= 0 )
+        {
+            vector<int> nodeCpus = numaNodeCpus( attributes.numaNode );
+
+            if ( nodeCpus.empty() )
+            {
+                logw( "NUMA node %d not found", attributes.numaNode );
+                ok = false;
+            }
+            else if ( cpus.empty() )
+            {
+                cpus = nodeCpus;
+            }
+            else
+            {
+                vector<int> both;
+                for ( int cpu : cpus )
+                    if ( find( nodeCpus.begin(), nodeCpus.end(), cpu ) != nodeCpus.end() )
+                        both.push_back( cpu );
+
+                cpus = both.empty() ? cpus : both;
+            }
+
+            // Prefer memory from the node; no libnuma dependency, use the raw syscall
+            if ( !nodeCpus.empty() && attributes.numaNode < (int) (8 * sizeof( unsigned long )) )
+            {
+                unsigned long nodemask = 1ul << attributes.numaNode;
+
+                if ( syscall( SYS_set_mempolicy, MPOL_PREFERRED, &nodemask, 8 * sizeof( nodemask )) != 0 )
+                {
+                    logw( "Could not set memory policy for NUMA node %d (errno=%i %s)",
+                          attributes.numaNode, errno, strerror( errno ));
+                    ok = false;
+                }
+            }
+        }
+
+        if ( !cpus.empty() )
+        {
+            cpu_set_t cpuset;
+            CPU_ZERO( &cpuset );
+
+            for ( int cpu : cpus )
+                if ( cpu >= 0 && cpu < CPU_SETSIZE )
+                    CPU_SET( cpu, &cpuset );
+
+            if ( pthread_setaffinity_np( self, sizeof( cpuset ), &cpuset ) != 0 )
+            {
+                logw( "Could not set thread CPU affinity" );
+                ok = false;
+            }
+        }
+
+        if ( attributes.fifoPriority > 0 )
+        {
+            struct sched_param param{};
+            param.sched_priority = min( attributes.fifoPriority, sched_get_priority_max( SCHED_FIFO ));
+
+            int err = pthread_setschedparam( self, SCHED_FIFO, &param );
+            if ( err != 0 )
+            {
+                loge( "Could not set SCHED_FIFO priority %d (errno=%i %s)", param.sched_priority, err, strerror( err ));
+                ok = false;
+            }
+        }
+
+        return ok;
+    }
+
+
+    std::vector<ThreadInfo> Threads::list()
+    {
+        vector<ThreadInfo> infos;
+        auto now = chrono::steady_clock::now();
+
+        lock_guard lock( threadsMutex );
+
+        for ( auto& it : runningThreads )
+        {
+            const RunningThread& t = it.second;
+            ThreadInfo info;
+
+            info.subsystem = t.subsystem;
+            info.name = t.name;
+            info.tid = t.tid;
+
+            cpu_set_t cpuset;
+            CPU_ZERO( &cpuset );
+            if ( pthread_getaffinity_np( t.handle, sizeof( cpuset ), &cpuset ) == 0 )
+            {
+                for ( int cpu = 0; cpu < CPU_SETSIZE; cpu++ )
+                    if ( CPU_ISSET( cpu, &cpuset ))
+                        info.cpus.push_back( cpu );
+            }
+
+            int policy;
+            struct sched_param param{};
+            if ( pthread_getschedparam( t.handle, &policy, &param ) == 0 && policy == SCHED_FIFO )
+                info.fifoPriority = param.sched_priority;
+
+            // Threads stay registered until their function returns, so the handle is valid
+            clockid_t clock;
+            struct timespec ts{};
+            if ( pthread_getcpuclockid( t.handle, &clock ) == 0 && clock_gettime( clock, &ts ) == 0 )
+                info.cpuSeconds = (double) ts.tv_sec + (double) ts.tv_nsec / 1e9;
+
+            double elapsed = chrono::duration<double>( now - t.started ).count();
+            info.cpuPercent = elapsed > 0 ? 100.0 * info.cpuSeconds / elapsed : 0.0;
+
+            infos.push_back( info );
+        }
+
+        return infos;
+    }
+
+
+    ThreadScope::ThreadScope( const std::string& subsystem, const std::string& defaultName )
+    {
+        ThreadAttributes attributes = Threads::getAttributes( subsystem );
+
+        if ( attributes.name.empty() )
+            attributes.name = defaultName;
+
+        Threads::apply( attributes );
+        Alloc::setThreadSubsystem( subsystem );
+        Trace::setThreadName( attributes.name );
+
+        RunningThread t{ subsystem, attributes.name.substr( 0, 15 ), (long) syscall( SYS_gettid ),
+                         pthread_self(), chrono::steady_clock::now() };
+
+        lock_guard lock( threadsMutex );
+        runningThreads[ t.tid ] = t;
+    }
+
+
+    ThreadScope::~ThreadScope()
+    {
+        lock_guard lock( threadsMutex );
+        runningThreads.erase( (long) syscall( SYS_gettid ));
+    }
+
+} // ns
@@ -0,0 +1,481 @@
+/********************************************************************************
+ *  This file is part of the lopezworks SDK utility library for C/C++ (lwsdk).
+ *
+ *  Copyright (C) 2015-2017 Edwin R. Lopez
+ *  http://www.lopezworks.info
+ *
+ *  This source code is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation LGPL v2.1
+ *  (http://www.gnu.org/licenses/).
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ *  02110-1301  USA.
+ ********************************************************************************/
+#include "Timers.h"
+#include "Exceptions.h"
+#include "Threads.h"
+
+#include <chrono>
+#include <unistd.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+
+#define LOGGER_ENABLED 0   // turn off verbose logging
+#include "Logger.h"
+
+using namespace std;
+
+namespace lwsdk
+{
+    /**
+     * Returns CLOCK_MONOTONIC time in milliseconds, the same clock used by the timerfd.
+     */
+    static long monotonicMillis()
+    {
+        return chrono::duration_cast<chrono::milliseconds>( chrono::steady_clock::now().time_since_epoch() ).count();
+    }
+
+
+    Timers::Timers()
+    {
+        timerfd = timerfd_create( CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC );
+        if ( timerfd < 0 )
+            throw RuntimeException( "Failed to create timerfd", errnoCode() );
+
+        baseMillis = monotonicMillis();
+    }
+
+
+    Timers::~Timers()
+    {
+        stop();
+
+        for ( auto& it : nodes )
+            delete it.second;
+
+        for ( auto node : freeNodes )
+            delete node;
+
+        ::close( timerfd );
+    }
+
+
+    uint64_t Timers::schedule( uint32_t delayMs, const TimerTask_t& task, uint32_t periodMs )
+    {
+        lock_guard lock( mtx );
+
+        // Nothing in the wheel, so process() may not have run for a while; catch up so
+        // the timer is linked relative to the current time
+        if ( nodes.empty() )
+            currentTick = max( currentTick, now() );
+
+        TimerNode *node;
+        if ( !freeNodes.empty() )
+        {
+            node = freeNodes.back();
+            freeNodes.pop_back();
+        }
+        else
+        {
+            node = new TimerNode();
+        }
+
+        // Ticks are whole milliseconds, round up so timers never expire early
+        node->id = timerIdSeq++;
+        node->expires = now() + delayMs + (delayMs > 0 ? 1 : 0);
+        node->periodMs = periodMs;
+        node->cancelled = false;
+        node->task = task;
+
+        link( node );
+        nodes[ node->id ] = node;
+
+        // Re-arm only if this timer expires before the currently armed tick
+        if ( armedTick == 0 || node->expires < armedTick )
+            arm();
+
+        return node->id;
+    }
+
+
+    bool Timers::cancel( uint64_t timerId )
+    {
+        lock_guard lock( mtx );
+
+        auto it = nodes.find( timerId );
+        if ( it == nodes.end() )
+            return false;
+
+        TimerNode *node = it->second;
+        nodes.erase( it );
+
+        if ( node->slot == nullptr )
+        {
+            // Timer is running in process(), which will recycle it
+            node->cancelled = true;
+        }
+        else
+        {
+            unlink( node );
+            node->task = nullptr;
+            freeNodes.push_back( node );
+        }
+
+        return true;
+    }
+
+
+    int Timers::size()
+    {
+        lock_guard lock( mtx );
+        return (int) nodes.size();
+    }
+
+
+    int Timers::getFd()
+    {
+        return timerfd;
+    }
+
+
+    void Timers::process()
+    {
+        uint64_t n;
+        ::read( timerfd, &n, sizeof( n ));
+
+        vector<TimerNode*> expired;
+
+        {
+            lock_guard lock( mtx );
+
+            uint64_t nowTick = now();
+            armedTick = 0;
+
+            while ( currentTick <= nowTick )
+            {
+                // Jump to the next tick with timers to expire or cascade, skipping the
+                // empty ones in between
+                uint64_t next = nextTick();
+                if ( next > nowTick )
+                {
+                    currentTick = nowTick + 1;
+                    break;
+                }
+
+                currentTick = next;
+
+                int index = (int) (currentTick & (ROOT_SIZE - 1));
+
+                // Every time the root wheel wraps around, move the next upper slot down
+                if ( index == 0 )
+                {
+                    for ( int level = 0; level < LEVELS - 1; level++ )
+                    {
+                        int slot = (int) ((currentTick >> (ROOT_BITS + level * LEVEL_BITS)) & (LEVEL_SIZE - 1));
+                        cascade( level );
+
+                        if ( slot != 0 )
+                            break;
+                    }
+                }
+
+                // Detach expired list, nodes are flagged as running by having no slot
+                TimerNode *node = root[ index ];
+                root[ index ] = nullptr;
+
+                while ( node != nullptr )
+                {
+                    TimerNode *next = node->next;
+                    node->prev = node->next = nullptr;
+                    node->slot = nullptr;
+                    expired.push_back( node );
+                    node = next;
+                }
+
+                currentTick++;
+            }
+        }
+
+        // Run tasks unlocked, so they can schedule/cancel timers
+        for ( TimerNode *node : expired )
+        {
+            // May have been cancelled by an earlier task of this batch
+            {
+                lock_guard lock( mtx );
+                if ( node->cancelled )
+                    continue;
+            }
+
+            try
+            {
+                node->task();
+            }
+            catch ( const std::exception& e )
+            {
+                loge( "Timer task finished with errors: %s", e.what() );
+            }
+        }
+
+        {
+            lock_guard lock( mtx );
+
+            for ( TimerNode *node : expired )
+            {
+                if ( !node->cancelled && node->periodMs > 0 )
+                {
+                    node->expires = now() + node->periodMs;
+                    link( node );
+                    continue;
+                }
+
+                if ( !node->cancelled )
+                    nodes.erase( node->id );
+
+                node->task = nullptr;
+                freeNodes.push_back( node );
+            }
+
+            arm();
+        }
+    }
+
+
+    void Timers::start()
+    {
+        if ( timersThread != nullptr )
+            return;
+
+        wakefd = eventfd( 0, EFD_NONBLOCK | EFD_CLOEXEC );
+        keepWorking = true;
+        timersThread = new thread( &Timers::timersThreadLoop, this );
+    }
+
+
+    void Timers::stop()
+    {
+        if ( timersThread == nullptr )
+            return;
+
+        keepWorking = false;
+
+        uint64_t n = 1;
+        ::write( wakefd, &n, sizeof( n ));
+
+        timersThread->join();
+        delete timersThread;
+        timersThread = nullptr;
+
+        ::close( wakefd );
+        wakefd = -1;
+    }
+
+
+    /**
+     * Returns the current tick, i.e. milliseconds since this object was created.
+     */
+    uint64_t Timers::now()
+    {
+        return (uint64_t) (monotonicMillis() - baseMillis);
+    }
+
+
+    /**
+     * Returns a reference to the wheel slot for the node's expiration tick.
+     */
+    Timers::TimerNode*& Timers::slotFor( TimerNode *node )
+    {
+        uint64_t expires = max( node->expires, currentTick );
+        uint64_t delta = expires - currentTick;
+
+        if ( delta < ROOT_SIZE )
+            return root[ expires & (ROOT_SIZE - 1) ];
+
+        for ( int level = 0; level < LEVELS - 1; level++ )
+        {
+            int shift = ROOT_BITS + level * LEVEL_BITS;
+
+            if ( delta < (1ull << (shift + LEVEL_BITS)) || level == LEVELS - 2 )
+            {
+                // Timers beyond the wheel's range are parked in the last slot reachable
+                // and re-evaluated when cascaded
+                if ( delta >= (1ull << (shift + LEVEL_BITS)) )
+                    expires = currentTick + (1ull << (shift + LEVEL_BITS)) - 1;
+
+                return levels[ level ][ (expires >> shift) & (LEVEL_SIZE - 1) ];
+            }
+        }
+
+        return root[ 0 ]; // unreachable
+    }
+
+
+    /**
+     * Appends the node to the wheel slot for its expiration tick, so timers expiring on
+     * the same tick run in the order they were scheduled. The head's prev points to the
+     * tail of the slot's list.
+     */
+    void Timers::link( TimerNode *node )
+    {
+        if ( node->expires < currentTick )
+            node->expires = currentTick;
+
+        TimerNode *&head = slotFor( node );
+
+        node->next = nullptr;
+        node->slot = &head;
+
+        if ( head == nullptr )
+        {
+            node->prev = node;
+            head = node;
+            return;
+        }
+
+        node->prev = head->prev;
+        head->prev->next = node;
+        head->prev = node;
+    }
+
+
+    /**
+     * Removes the node from its wheel slot.
+     */
+    void Timers::unlink( TimerNode *node )
+    {
+        TimerNode *head = *node->slot;
+
+        if ( node == head )
+            *node->slot = node->next;
+        else
+            node->prev->next = node->next;
+
+        // The tail is linked from the head, the others from their successor
+        if ( node->next != nullptr )
+            node->next->prev = node->prev;
+        else if ( node != head )
+            head->prev = node->prev;
+
+        node->prev = node->next = nullptr;
+        node->slot = nullptr;
+    }
+
+
+    /**
+     * Moves all timers in the current slot of the given upper level down to the lower levels.
+     */
+    void Timers::cascade( int level )
+    {
+        int slot = (int) ((currentTick >> (ROOT_BITS + level * LEVEL_BITS)) & (LEVEL_SIZE - 1));
+
+        TimerNode *node = levels[ level ][ slot ];
+        levels[ level ][ slot ] = nullptr;
+
+        while ( node != nullptr )
+        {
+            TimerNode *next = node->next;
+            link( node );
+            node = next;
+        }
+    }
+
+
+    /**
+     * Returns the next tick that needs processing: the first non-empty root slot, or the
+     * first cascade of a non-empty upper slot, whichever comes first. Returns UINT64_MAX
+     * if the wheel is empty.
+     */
+    uint64_t Timers::nextTick()
+    {
+        uint64_t next = UINT64_MAX;
+
+        for ( uint64_t t = currentTick; t < currentTick + ROOT_SIZE; t++ )
+        {
+            if ( root[ t & (ROOT_SIZE - 1) ] != nullptr )
+            {
+                next = t;
+                break;
+            }
+        }
+
+        for ( int level = 0; level < LEVELS - 1; level++ )
+        {
+            int shift = ROOT_BITS + level * LEVEL_BITS;
+            uint64_t unit = 1ull << shift;
+            uint64_t boundary = (currentTick + unit - 1) & ~(unit - 1);
+
+            for ( int k = 0; k < LEVEL_SIZE && boundary + k * unit < next; k++ )
+            {
+                if ( levels[ level ][ ((boundary + k * unit) >> shift) & (LEVEL_SIZE - 1) ] != nullptr )
+                {
+                    next = boundary + k * unit;
+                    break;
+                }
+            }
+        }
+
+        return next;
+    }
+
+
+    /**
+     * Arms the timerfd for the next tick that needs processing. Disarms the timerfd if
+     * there are no timers.
+     */
+    void Timers::arm()
+    {
+        struct itimerspec spec{};
+        uint64_t next = nodes.empty() ? UINT64_MAX : nextTick();
+
+        if ( next != UINT64_MAX )
+        {
+            // Note an all-zero it_value disarms the timer, so make sure it is at least 1ns
+            long deadline = baseMillis + (long) next;
+            spec.it_value.tv_sec = deadline / 1000;
+            spec.it_value.tv_nsec = (deadline % 1000) * 1000000 + 1;
+            armedTick = next;
+        }
+        else
+        {
+            armedTick = 0;
+        }
+
+        timerfd_settime( timerfd, TFD_TIMER_ABSTIME, &spec, nullptr );
+    }
+
+
+    /**
+     * Thread loop for start(), waits on the timerfd until stop() is called.
+     */
+    void Timers::timersThreadLoop()
+    {
+        ThreadScope scope( "timers", "timers" );
+
+        struct pollfd fds[2] = { { timerfd, POLLIN, 0 }, { wakefd, POLLIN, 0 } };
+
+        logi( "Timers thread started ..." );
+
+        while ( keepWorking )
+        {
+            if ( poll( fds, 2, -1 ) < 0 && errno != EINTR )
+            {
+                loge( "Timers thread poll() error (errno=%i %s)", errno, strerror( errno ));
+                break;
+            }
+
+            if ( fds[0].revents & POLLIN )
+                process();
+        }
+
+        logi( "Timers thread ended." );
+    }
+
+} // ns
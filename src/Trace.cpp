@@ -0,0 +1,357 @@
+/********************************************************************************
+ *  This file is part of the lopezworks SDK utility library for C/C++ (lwsdk).
+ *
+ *  Copyright (C) 2015-2017 Edwin R. Lopez
+ *  http://www.lopezworks.info
+ *
+ *  This source code is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation LGPL v2.1
+ *  (http://www.gnu.org/licenses/).
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ *  02110-1301  USA.
+ ********************************************************************************/
+#include "Trace.h"
+
+#include <map>
+#include <mutex>
+#include <memory>
+#include <vector>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <algorithm>
+#include <time.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+
+using namespace std;
+
+namespace lwsdk
+{
+    struct TraceEvent
+    {
+        uint64_t    ts;
+        uint64_t    dur;
+        uint64_t    flowId;
+        const char *category;
+        const char *name;
+        char        phase;     // 'X' span, 'i' instant
+    };
+
+    /**
+     * Ring buffer of one thread's events. The lock is only contended while exporting.
+     */
+    struct ThreadBuffer
+    {
+        mutex mtx;
+        vector<TraceEvent> events;
+        uint64_t head{0};          // total events written, the next slot is head % size
+        long tid;
+        string threadName;
+        atomic_bool exited{false}; // thread is gone, dropped by the next start() or clear()
+    };
+
+    /**
+     * The calling thread's buffer, flagged as exited when the thread ends.
+     */
+    struct LocalBuffer
+    {
+        shared_ptr<ThreadBuffer> buffer;
+        string threadName;         // name set before the buffer was created
+
+        ~LocalBuffer()
+        {
+            if ( buffer )
+                buffer->exited = true;
+        }
+    };
+
+    static mutex buffersMutex;
+    static vector<shared_ptr<ThreadBuffer>> buffers;     // kept after their thread exits, for export
+    static atomic<size_t> bufferCapacity{65536};
+    static atomic<uint64_t> flowIdSeq{1};
+
+    static thread_local LocalBuffer localBuffer;
+
+
+    /**
+     * Returns the calling thread's buffer, created on the thread's first event.
+     */
+    static ThreadBuffer& getLocalBuffer()
+    {
+        if ( !localBuffer.buffer )
+        {
+            auto buffer = make_shared<ThreadBuffer>();
+            buffer->tid = (long) syscall( SYS_gettid );
+            buffer->threadName = std::move( localBuffer.threadName );
+
+            lock_guard lock( buffersMutex );
+            buffers.push_back( buffer );
+            localBuffer.buffer = buffer;
+        }
+
+        return *localBuffer.buffer;
+    }
+
+
+    /**
+     * Drops the buffers of exited threads. Must be called with buffersMutex held.
+     */
+    static void dropExitedBuffers()
+    {
+        buffers.erase( remove_if( buffers.begin(), buffers.end(),
+                                  []( const shared_ptr<ThreadBuffer>& b ) { return b->exited.load(); } ),
+                       buffers.end() );
+    }
+
+
+    void Trace::Detail::record( char phase, const char *category, const char *name,
+                                uint64_t ts, uint64_t dur, uint64_t flowId )
+    {
+        ThreadBuffer& buffer = getLocalBuffer();
+        lock_guard lock( buffer.mtx );
+
+        // Ring buffers are allocated on the thread's first event
+        if ( buffer.events.empty() )
+            buffer.events.resize( bufferCapacity.load() );
+
+        buffer.events[ buffer.head % buffer.events.size() ] = TraceEvent{ ts, dur, flowId, category, name, phase };
+        buffer.head++;
+    }
+
+
+    void Trace::start( size_t eventsPerThread )
+    {
+        {
+            lock_guard lock( buffersMutex );
+
+            bufferCapacity = max( (size_t) 1, eventsPerThread );
+            dropExitedBuffers();
+
+            for ( auto& buffer : buffers )
+            {
+                lock_guard lock2( buffer->mtx );
+                buffer->events.clear();
+                buffer->events.shrink_to_fit();
+                buffer->head = 0;
+            }
+        }
+
+        Detail::enabled = true;
+    }
+
+
+    void Trace::stop()
+    {
+        Detail::enabled = false;
+    }
+
+
+    void Trace::clear()
+    {
+        lock_guard lock( buffersMutex );
+        dropExitedBuffers();
+
+        for ( auto& buffer : buffers )
+        {
+            lock_guard lock2( buffer->mtx );
+            buffer->head = 0;
+        }
+    }
+
+
+    uint64_t Trace::nowNanos()
+    {
+        struct timespec ts;
+        clock_gettime( CLOCK_MONOTONIC, &ts );
+        return (uint64_t) ts.tv_sec * 1000000000ull + (uint64_t) ts.tv_nsec;
+    }
+
+
+    uint64_t Trace::newFlowId()
+    {
+        return isEnabled() ? flowIdSeq.fetch_add( 1, memory_order_relaxed ) : 0;
+    }
+
+
+    void Trace::instant( const char *category, const char *name, uint64_t flowId )
+    {
+        if ( isEnabled() )
+            Detail::record( 'i', category, name, nowNanos(), 0, flowId != 0 ? flowId : currentFlow() );
+    }
+
+
+    void Trace::setThreadName( const std::string& name )
+    {
+        // Kept aside until the thread records its first event, threads that never do
+        // don't get a buffer
+        if ( !localBuffer.buffer )
+        {
+            localBuffer.threadName = name;
+            return;
+        }
+
+        lock_guard lock( localBuffer.buffer->mtx );
+        localBuffer.buffer->threadName = name;
+    }
+
+
+    /**
+     * Escapes a string for JSON output.
+     */
+    static string jsonEscape( const char *s )
+    {
+        string out;
+
+        for ( ; s != nullptr && *s; s++ )
+        {
+            if ( *s == '"' || *s == '\\' )
+                out += '\\';
+
+            if ( (unsigned char) *s >= 0x20 )
+                out += *s;
+        }
+
+        return out;
+    }
+
+
+    /**
+     * Formats a nanosecond value as microseconds, the unit used by the trace format.
+     */
+    static string micros( uint64_t ns )
+    {
+        ostringstream ss;
+        ss << ns / 1000 << '.' << setw( 3 ) << setfill( '0' ) << ns % 1000;
+        return ss.str();
+    }
+
+
+    std::string Trace::toChromeJson()
+    {
+        struct Entry
+        {
+            TraceEvent event;
+            long tid;
+        };
+
+        vector<Entry> entries;
+        vector<pair<long, string>> threadNames;
+        long pid = (long) getpid();
+
+        {
+            lock_guard lock( buffersMutex );
+
+            for ( auto& buffer : buffers )
+            {
+                lock_guard lock2( buffer->mtx );
+                uint64_t size = buffer->events.size();
+                uint64_t first = buffer->head > size ? buffer->head - size : 0;
+
+                if ( size == 0 )
+                    continue;
+
+                for ( uint64_t i = first; i < buffer->head; i++ )
+                    entries.push_back( Entry{ buffer->events[ i % size ], buffer->tid } );
+
+                if ( !buffer->threadName.empty() )
+                    threadNames.emplace_back( buffer->tid, buffer->threadName );
+            }
+        }
+
+        sort( entries.begin(), entries.end(), []( const Entry& a, const Entry& b ) { return a.event.ts < b.event.ts; } );
+
+        // Flow arrows bind to spans: first span of a flow starts it, last one ends it
+        map<uint64_t, pair<size_t, size_t>> flows;   // flowId -> first, last entry index
+        for ( size_t i = 0; i < entries.size(); i++ )
+        {
+            uint64_t id = entries[i].event.flowId;
+            if ( id == 0 || entries[i].event.phase != 'X' )
+                continue;
+
+            auto it = flows.find( id );
+            if ( it == flows.end() )
+                flows.emplace( id, make_pair( i, i ));
+            else
+                it->second.second = i;
+        }
+
+        ostringstream ss;
+        bool first = true;
+
+        auto separator = [&] {
+            ss << (first ? "\n" : ",\n");
+            first = false;
+        };
+
+        ss << "{\"displayTimeUnit\": \"ns\", \"traceEvents\": [";
+
+        for ( auto& tn : threadNames )
+        {
+            separator();
+            ss << "{\"ph\": \"M\", \"name\": \"thread_name\", \"pid\": " << pid << ", \"tid\": " << tn.first
+               << ", \"args\": {\"name\": \"" << jsonEscape( tn.second.c_str() ) << "\"}}";
+        }
+
+        for ( size_t i = 0; i < entries.size(); i++ )
+        {
+            const TraceEvent& e = entries[i].event;
+            long tid = entries[i].tid;
+
+            separator();
+            ss << "{\"ph\": \"" << e.phase << "\", \"cat\": \"" << jsonEscape( e.category )
+               << "\", \"name\": \"" << jsonEscape( e.name ) << "\", \"pid\": " << pid << ", \"tid\": " << tid
+               << ", \"ts\": " << micros( e.ts );
+
+            if ( e.phase == 'X' )
+                ss << ", \"dur\": " << micros( e.dur );
+            else
+                ss << ", \"s\": \"t\"";
+
+            if ( e.flowId != 0 )
+                ss << ", \"args\": {\"flow\": " << e.flowId << "}";
+
+            ss << "}";
+
+            if ( e.flowId == 0 || e.phase != 'X' )
+                continue;
+
+            // Flow event bound to this span: start, step or finish
+            auto& range = flows[ e.flowId ];
+            if ( range.first == range.second )
+                continue;
+
+            char phase = (i == range.first) ? 's' : (i == range.second) ? 'f' : 't';
+
+            separator();
+            ss << "{\"ph\": \"" << phase << "\", \"cat\": \"flow\", \"name\": \"flow\", \"id\": " << e.flowId
+               << ", \"pid\": " << pid << ", \"tid\": " << tid << ", \"ts\": " << micros( e.ts )
+               << (phase == 's' ? "" : ", \"bp\": \"e\"") << "}";
+        }
+
+        ss << (first ? "]}" : "\n]}") << "\n";
+
+        return ss.str();
+    }
+
+
+    bool Trace::dump( const std::string& path )
+    {
+        ofstream out( path );
+        if ( !out )
+            return false;
+
+        out << toChromeJson();
+        return out.good();
+    }
+
+} // ns
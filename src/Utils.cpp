@@ -126,27 +126,6 @@ namespace lwsdk::Utils
 
 
 
-    long currentTimeUsec()
-    {
-        long t = system_clock::now().time_since_epoch().count();
-        return t * 1000000 * system_clock::period::num / system_clock::period::den;  // convert to ms
-    }
-
-
-    long currentTimeMillis()
-    {
-
-        long t = system_clock::now().time_since_epoch().count();
-        return t * 1000 * system_clock::period::num / system_clock::period::den;  // convert to ms
-    }
-
-
-    long currentTimeSeconds()
-    {
-        return currentTimeMillis() / 1000;
-    }
-
-
     std::string shellExec( const std::string &cmd )
     {
         char buffer[128];
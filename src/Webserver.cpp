@@ -20,17 +20,32 @@
  *  02110-1301  USA.
  ********************************************************************************/
 #include <map>
+#include <deque>
+#include <chrono>
 #include <sstream>
 #include <utility>
 #include <mutex>
 #include <thread>
 #include <optional>
+#include <future>
+#include <unistd.h>
+#include <sys/un.h>
+#include <sys/stat.h>
 
 #include "Webserver.h"
 #include "Files.h"
 #include "Exceptions.h"
 #include "Utils.h"
 #include "ConcurrentQueue.h"
+#include "Reactor.h"
+#include "ThreadPool.h"
+#include "BufferPool.h"
+#include "Metrics.h"
+#include "Trace.h"
+#include "Threads.h"
+#include "Alloc.h"
+#include "Delta.h"
+#include "Codecs.h"
 
 #include <libwebsockets.h>
 
@@ -44,12 +59,31 @@ using namespace std;
 namespace lwsdk::Webserver
 {
     #define MAX_PAYLOAD 4096                          // Size of the buffers used to serialize data in and out of the web socket
-    #define MAX_CLIENTS 64                            // Maximum number of connections accepted by this server
+    #define MAX_CLIENTS 64                            // Maximum number of connections accepted by each server instance
+    #define MAX_INSTANCES 64                          // Maximum number of server instances
+    #define MAX_PENDING 256                           // Maximum number of messages queued on a connection busy writing
+    #define MAX_SNAPSHOTS 8                           // Number of recent snapshots kept as delta bases
+    #define RX_RETRY_US 10000                         // Retry period for a message held while the incoming queue is full
 
     // Forwards
+    struct ServerInstance;
+    struct PooledMessage;
+    struct WSConnection;
+    struct Snapshot;
     static void interrupt();
     static int lwsCallback( struct lws *wsi, enum lws_callback_reasons reason, void *user, void *in, size_t len );
-    static void mainServerThread();
+    static int sseCallback( struct lws *wsi, enum lws_callback_reasons reason, void *user, void *in, size_t len );
+    static int httpCallback( struct lws *wsi, enum lws_callback_reasons reason, void *user, void *in, size_t len );
+    static void mainServerThread( ServerInstance *instance );
+    static void createContext( ServerInstance& instance );
+    static void destroyContext( ServerInstance& instance );
+    static void flushOutgoingMessages( ServerInstance& instance );
+    static void keepForReplay( PooledMessage& m, const std::string& message );
+    static bool offerOutgoing( const PooledMessage& m );
+    static void releaseIncoming( const PooledMessage& m );
+    static void updateReceive( WSConnection& connection );
+    static void removeSocketFile();
+    static bool isDrained();
     static const char * asString( int n );
 
     // Website config vars
@@ -59,45 +93,192 @@ namespace lwsdk::Webserver
     static string sslCertPath;                        // SSL/TLS cert file
     static string sslKeyPath;                         // SSL/TLS key file
     static int    sslPort = -1;                       // https port, < 0 means no https server is started
+    static string unixSocketPath;                     // Unix domain socket, blank means no socket is created
+    static ServerOptions options;                     // Optional features
 
 
     // Website state machine vars
     static atomic_bool       keepWorking = false;             // Server running state
-    static thread            *serverThread = nullptr;         // Server thread main loop function
     static thread            *msgDispatcherThread = nullptr;  // Thread function used to dispatch incoming websocket messages
     static MessageCallback_t userCallback = nullptr;          // Pointer to the user-defined callback function, null if none
+    static ValueCallback_t   valueCallback = nullptr;         // Pointer to the user-defined document callback, null if none
+    static ThreadPool        *threadPool = nullptr;           // Pool running user callbacks, null to run them in msgDispatcherThread
+    static Reactor           *reactor = nullptr;              // Reactor servicing the lws sockets, null to use serverThread
+    static uint64_t          reactorTimerId = 0;              // Reactor timer driving lws' periodic housekeeping
+    static map<int, int>     reactorPollEvents;               // poll() events requested by lws for each fd, reactor mode only
+
+
+    // Queued websocket message, the data is drawn from the buffer pool so it can be handed
+    // between threads without going back to malloc
+    // Document sent by sendValue(), encoded once per binary codec and shared by all the
+    // clients of that codec. Codecs with clients connected at send time are encoded right
+    // away; the others on first use, from the kept value, by a client that connected later.
+    struct ValueDocument {
+        mutex        mtx;
+        Json::Value  value;                           // kept only while a codec is not encoded yet
+        PooledBuffer encoded[3];                      // by Codec, Json unused
+    };
+
+
+    struct PooledMessage {
+        uint32_t     connectionId;                    // source or destination connection, 0 for all
+        PooledBuffer data;                            // message contents
+        uint64_t     flowId{0};                       // trace flow the message belongs to, 0 if none
+        uint64_t     seq{0};                          // broadcast sequence number if kept for replay, 0 otherwise
+        bool         binary{false};                   // send as a binary websocket message
+        shared_ptr<atomic_int> rxQueued;              // source connection's count of queued incoming messages, if limited
+        shared_ptr<Snapshot> snapshot;                // snapshot sent by sendSnapshot(), delta-encoded for ws0-delta clients
+        shared_ptr<ValueDocument> document;           // sendValue() document in the binary codecs, null if none
+        Codec        codec{Codec::Json};              // encoding of a received message
+    };
+
+
+    // Snapshot sent by sendSnapshot(). Clients speaking ws0-delta get binary frames, each
+    // encoded once per base version and shared by all the clients on that base:
+    //   'F' version payload         full snapshot
+    //   'D' version base delta      difference from base version, see Delta.h
+    // and acknowledge every frame applied with 'A' version. Integers are 32-bit big-endian.
+    struct Snapshot {
+        uint32_t     version;                         // snapshot version, never 0
+        PooledBuffer data;                            // snapshot contents, sent as is to the other clients
+        mutex        framesMutex;                     // guards frames
+        map<uint32_t, PooledBuffer> frames;           // encoded frames by base version, 0 for the full frame
+
+        Snapshot( uint32_t version, PooledBuffer data ) : version( version ), data( std::move( data )) {}
+    };
 
 
-    // Holds information and data-transfer state of a websocket connection
+    // lws timer resuming a connection paused by the inbound limits
+    struct RxTimer {
+        lws_sorted_usec_list_t sul;                   // must be first, the lws callback gets its address
+        WSConnection *connection;
+    };
+
+
+    // Holds information and data-transfer state of a websocket connection. Messages batched
+    // for ws0-delta clients are sent in a binary frame: 'B' followed by each message as
+    // a 32-bit big-endian length and its bytes.
     struct WSConnection {
         uint32_t id;                                  // connection's id
         struct lws * wsi;                             // underlying LWS connection handle
-        string inbox;                                 // string to store incoming data
-        shared_ptr<string> outbox{};                  // string holding outgoing data
+        PooledBuffer inbox;                           // buffer to store incoming data
+        PooledBuffer outbox;                          // buffer holding outgoing data, shared by all its recipients
+        deque<PooledMessage> pending;                 // messages waiting for the outbox to be written out
+        uint64_t replayedSeq{0};                      // broadcasts up to this sequence were replayed on connect
+        bool outBinary{false};                        // outbox is a binary message
+        bool delta{false};                            // client speaks ws0-delta, see Snapshot
+        uint32_t ackedVersion{0};                     // last snapshot version acknowledged by a ws0-delta client
+        bool batching{false};                         // small messages are batched, see ServerOptions::batchDelayUs
+        PooledBuffer batch;                           // batch being filled, empty if none
+        PooledMessage batchFirst;                     // first message in the batch, sent alone if no other joins it
+        shared_ptr<atomic_int> rxQueued;              // messages of this connection in the incoming queue, see ServerOptions::rxQueueShare
+        double rxMsgTokens{0};                        // inbound token buckets, see ServerOptions::rxMessagesPerSec
+        double rxByteTokens{0};
+        int64_t rxRefillNs{0};                        // time the buckets were last refilled
+        bool rxPaused{false};                         // receiving paused by lws_rx_flow_control()
+        deque<PooledMessage> rxHeld;                  // messages received while the incoming queue was full
+        RxTimer rxTimer{};
+        uint64_t outFlowId{0};                        // trace flow of the outgoing data
+        bool sse{false};                              // true for a Server-Sent Events stream, false for a websocket
+        Codec codec{Codec::Json};                     // encoding of binary messages, set by the ws0-cbor and ws0-msgpack subprotocols
         int outpos{0};                                // index, points to the beginning of the next chunk of data being written out, ie. &outbox[outpos]
         char outbuf[ LWS_PRE + MAX_PAYLOAD ]{0};      // buffer holding data being written out, with spare LWS_PRE-sized space
         WSConnection( uint32_t id, struct lws *wsi ) : id( id ), wsi( wsi ) {}
     };
 
 
-    // Message queues, connections list
-    static uint32_t connectionIdSeq = 1;                     // Incremental sequence to generate new connection IDs
-    static map<uint32_t, WSConnection> wsConnections;        // Stores active connections, indexed by ID
-    static mutex wsConnectionsMutex;                         // Mutex to provide thread-safe access to wsConnections[] map
-    static ConcurrentQueue<WSMessage> incomingMessages(100); // Hold messages coming from web clients
-    static ConcurrentQueue<WSMessage> outgoingMessages(100); // Hold messages going out to web clients
+    // An lws context with its own service thread, outgoing queue and connections. There is
+    // one instance unless ServerOptions::instances asks for more, in which case the
+    // instances share their listening ports and the kernel spreads connections among them.
+    struct ServerInstance {
+        int index;                                               // position in instances[]
+        struct lws_context *context{nullptr};                    // LWS web context, needed to call all LWS apis
+        thread *serverThread{nullptr};                           // Server thread main loop function
+        uint32_t connectionIdSeq;                                // Sequence to generate new connection IDs, see addConnection()
+        map<uint32_t, WSConnection> wsConnections;               // Stores active connections, indexed by ID
+        mutex wsConnectionsMutex;                                // Mutex to provide thread-safe access to wsConnections[] map
+        ConcurrentQueue<PooledMessage> outgoingMessages{100};    // Hold messages going out to this instance's web clients
+        atomic_bool rxWakeup{false};                             // a paused connection got room in the incoming queue
+
+        explicit ServerInstance( int index ) : index( index ), connectionIdSeq( index + 1 )
+        {
+            outgoingMessages.enableMetrics( index == 0 ? "webserver_outgoing" : "webserver_outgoing_" + to_string( index ));
+        }
+    };
+
 
+    // Message queues, server instances
+    static vector<unique_ptr<ServerInstance>> instances = [] {  // Created on demand, only the first instanceCount are in use
+        vector<unique_ptr<ServerInstance>> v;
+        v.push_back( make_unique<ServerInstance>( 0 ));
+        return v;
+    }();
+    static int instanceCount = 1;                                // Instances in use while running
+    static ConcurrentQueue<PooledMessage> incomingMessages(100); // Hold messages coming from web clients, shared by all instances
+    static atomic_int sendingCount = 0;                          // Connections with outbox data not yet written
 
-    // LWS config boilerplate structures
-    struct lws_context       *context = nullptr;             // LWS web context, needed to call all LWS apis
 
+    // Late-joiner replay, see ServerOptions::replayFrames
+    struct ReplayFrame {
+        string        key;                                       // replay key, blank if keeping the last N messages
+        PooledMessage message;                                   // broadcast message, sharing its buffer
+    };
+
+    static mutex replayMutex;                                    // Guards replayRing and broadcastSeq
+    static deque<ReplayFrame> replayRing;                        // Messages replayed to new connections, oldest first
+    static uint64_t broadcastSeq = 0;                            // Sequence number of the last broadcast kept for replay
+
+    // Recent snapshots, see sendSnapshot()
+    static mutex snapshotsMutex;                                 // Guards snapshots and snapshotVersion
+    static deque<shared_ptr<Snapshot>> snapshots;                // Delta bases, oldest first
+    static uint32_t snapshotVersion = 0;                         // Version of the last snapshot
+    static atomic_int dispatchingCount = 0;                      // Incoming messages taken but not yet handled
+    static atomic_int codecClients[3] = {};                      // Connected clients by Codec, see sendValue()
+
+
+    // Server metrics, registered on first use
+    struct WebserverMetrics {
+        Counter&   rxMessages = Metrics::counter( "webserver", "rx_messages", "", "Websocket messages received" );
+        Counter&   rxBytes    = Metrics::counter( "webserver", "rx_bytes", "", "Websocket payload bytes received" );
+        Counter&   rxDropped  = Metrics::counter( "webserver", "rx_dropped", "", "Messages dropped, incoming queue full" );
+        Counter&   rxPaused   = Metrics::counter( "webserver", "rx_paused", "", "Times a connection was paused by the inbound limits" );
+        Counter&   rxInvalid  = Metrics::counter( "webserver", "rx_invalid", "", "Messages the value callback could not decode" );
+        Counter&   txMessages = Metrics::counter( "webserver", "tx_messages", "", "Websocket messages sent, per recipient" );
+        Counter&   txBytes    = Metrics::counter( "webserver", "tx_bytes", "", "Websocket payload bytes sent" );
+        Counter&   txDropped  = Metrics::counter( "webserver", "tx_dropped", "", "Messages not sent, outgoing or connection queue full" );
+        Counter&   txReplayed = Metrics::counter( "webserver", "tx_replayed", "", "Messages replayed to new connections" );
+        Counter&   txDeltas   = Metrics::counter( "webserver", "tx_deltas", "", "Snapshot frames sent as deltas" );
+        Counter&   txFull     = Metrics::counter( "webserver", "tx_full", "", "Snapshot frames sent in full" );
+        Counter&   txBatches  = Metrics::counter( "webserver", "tx_batches", "", "Batches of messages sent in one frame" );
+        Gauge&     clients    = Metrics::gauge( "webserver", "clients", "", "Connected websocket clients" );
+        Gauge&     sseClients = Metrics::gauge( "webserver", "sse_clients", "", "Connected Server-Sent Events clients" );
+        Histogram& dispatchNs = Metrics::histogram( "webserver", "dispatch_ns", "", "Message callback duration in nanoseconds" );
+
+        WebserverMetrics()
+        {
+            incomingMessages.enableMetrics( "webserver_incoming" );
+        }
+    };
+
+    static WebserverMetrics& metrics()
+    {
+        static WebserverMetrics instance;
+        return instance;
+    }
+
+
+    // LWS config boilerplate structures
     struct per_session_data {                                // Structure allocated automatically by LWS for every connection
         WSConnection*  connection;
     };
 
     static struct lws_protocols protocols[] = {
-        { "http",  lws_callback_http_dummy, 0, 0, 0, nullptr, 0 },                           // first protocol must always be HTTP handler
+        { "http",  httpCallback, 0, 0, 0, nullptr, 0 },                                      // first protocol must always be HTTP handler
         { "ws0",   lwsCallback, sizeof(struct per_session_data), MAX_PAYLOAD, 0, nullptr },  // websocket protocol
+        { "ws0-delta", lwsCallback, sizeof(struct per_session_data), MAX_PAYLOAD, 0, nullptr },  // ws0 plus delta-encoded snapshots
+        { "ws0-cbor",  lwsCallback, sizeof(struct per_session_data), MAX_PAYLOAD, 0, nullptr },  // ws0 plus CBOR documents, see sendValue()
+        { "ws0-msgpack", lwsCallback, sizeof(struct per_session_data), MAX_PAYLOAD, 0, nullptr },  // ws0 plus MessagePack documents
+        { "sse",   sseCallback, sizeof(struct per_session_data), 0, 0, nullptr },            // event stream route, see ServerOptions::ssePath
         { nullptr, nullptr,  0 /* End of list */ }
     };
 
@@ -135,6 +316,26 @@ namespace lwsdk::Webserver
          .basic_auth_login_file = nullptr,
     };
 
+    static struct lws_http_mount sseMount = {
+         .mount_next =            &mount,        // static content for all other URLs
+         .mountpoint =            nullptr,       // set below when starting the server
+         .origin =                "sse",         // protocol handling the route
+         .def =                   nullptr,
+         .protocol =              nullptr,
+         .cgienv =                nullptr,
+         .extra_mimetypes =       nullptr,
+         .interpret =             nullptr,
+         .cgi_timeout =           0,
+         .cache_max_age =         0,
+         .auth_mask =             0,
+         .cache_reusable =        0,
+         .cache_revalidate =      0,
+         .cache_intermediaries =  0,
+         .origin_protocol =       LWSMPRO_CALLBACK,
+         .mountpoint_len =        0,
+         .basic_auth_login_file = nullptr,
+    };
+
 
     //
     // ================================================ Public API ===========================================================
@@ -143,7 +344,7 @@ namespace lwsdk::Webserver
     void setConfig( std::string hostname, std::string webDir, int port )
     {
         if ( keepWorking )
-            throw RuntimeException( PRETTY_FUNC + " - Cannot change config while web server is running." );
+            throw RuntimeException( "Cannot change config while web server is running." );
 
         Webserver::hostname = hostname;
         Webserver::webDir = webDir;
@@ -154,7 +355,7 @@ namespace lwsdk::Webserver
     void setConfigSSL( int sslPort, std::string sslCertPath, std::string sslKeyPath )
     {
         if ( keepWorking )
-            throw RuntimeException( PRETTY_FUNC + " - Cannot change config while web server is running." );
+            throw RuntimeException( "Cannot change config while web server is running." );
 
         if ( !Files::exists(sslCertPath) )
             throw RuntimeException( PRETTY_FUNC + " - Cannot find sslCertPath file: " + sslCertPath );
@@ -168,6 +369,62 @@ namespace lwsdk::Webserver
     }
 
 
+    void setConfigUnix( const std::string& socketPath )
+    {
+        if ( keepWorking )
+            throw RuntimeException( "Cannot change config while web server is running." );
+
+        if ( socketPath.size() >= sizeof( sockaddr_un::sun_path ))
+            throw RuntimeException( PRETTY_FUNC + " - Unix socket path too long: " + socketPath );
+
+        Webserver::unixSocketPath = socketPath;
+    }
+
+
+    void setOptions( const ServerOptions& options )
+    {
+        if ( keepWorking )
+            throw RuntimeException( "Cannot change options while web server is running." );
+
+        #if !defined(LWS_WITH_HTTP2)
+        if ( options.http2 )
+            throw RuntimeException( "libwebsockets was built without LWS_WITH_HTTP2." );
+        #endif
+
+        if ( !options.ssePath.empty() &&
+             (options.ssePath[0] != '/' || options.ssePath.size() < 2 || options.ssePath.size() > 255) )
+            throw RuntimeException( "Invalid Server-Sent Events path: " + options.ssePath );
+
+        if ( options.replayFrames < 0 || options.replayFrames > MAX_PENDING )
+            throw RuntimeException( "Number of replay frames out of range 0.." + to_string( MAX_PENDING ));
+
+        if ( options.rxQueueShare < 0 )
+            throw RuntimeException( "Incoming queue share cannot be negative." );
+
+        if ( options.batchDelayUs > 0 && options.batchMaxBytes < 64 )
+            throw RuntimeException( "Batch size must be at least 64 bytes." );
+
+        if ( options.instances < 1 || options.instances > MAX_INSTANCES )
+            throw RuntimeException( "Number of server instances out of range 1.." + to_string( MAX_INSTANCES ));
+
+        while ( (int) instances.size() < options.instances )
+            instances.emplace_back( make_unique<ServerInstance>( (int) instances.size() ));
+
+        // Connection IDs are striped by instance, see addConnection()
+        for ( auto& instance : instances )
+            instance->connectionIdSeq = instance->index + 1;
+
+        instanceCount = options.instances;
+        Webserver::options = options;
+    }
+
+
+    ServerOptions getOptions()
+    {
+        return options;
+    }
+
+
     std::string getConfig()
     {
         ostringstream ss;
@@ -180,6 +437,14 @@ namespace lwsdk::Webserver
         ss << "SSL Cert Path: " << sslCertPath << endl;
         ss << "SSL Key Path:  " << sslKeyPath << endl;
         ss << "HTTPS enabled: " << (sslPort > 0 ? "true" : "false") << endl;
+        ss << "HTTP/2:        " << (options.http2 ? "true" : "false") << endl;
+        ss << "Instances:     " << instanceCount << endl;
+        ss << "SSE path:      " << options.ssePath << endl;
+        ss << "Replay frames: " << options.replayFrames << (options.replayKey ? " (by key)" : "") << endl;
+        ss << "Batching:      " << options.batchDelayUs << " us, " << options.batchMaxBytes << " bytes" << endl;
+        ss << "RX limits:     " << options.rxMessagesPerSec << " msg/s, " << options.rxBytesPerSec << " bytes/s, "
+           << options.rxQueueShare << " queued" << endl;
+        ss << "Unix socket:   " << unixSocketPath << endl;
 
         return ss.str();
     }
@@ -204,6 +469,11 @@ namespace lwsdk::Webserver
         return sslPort;
     }
 
+    std::string getUnixSocketPath()
+    {
+        return unixSocketPath;
+    }
+
     std::string getSSLCertPath()
     {
         return sslCertPath;
@@ -219,26 +489,158 @@ namespace lwsdk::Webserver
         userCallback = msgCallback;
     }
 
+    void setValueCallback( const ValueCallback_t& valueCallback )
+    {
+        Webserver::valueCallback = valueCallback;
+    }
+
+    void setThreadPool( ThreadPool *pool )
+    {
+        threadPool = pool;
+    }
+
+    void setReactor( Reactor *reactor )
+    {
+        if ( keepWorking )
+            throw RuntimeException( "Cannot change reactor while web server is running." );
+
+        #if LWS_LIBRARY_VERSION_MAJOR >= 4 && !defined(LWS_WITH_EXTERNAL_POLL)
+        if ( reactor != nullptr )
+            throw RuntimeException( "libwebsockets was built without LWS_WITH_EXTERNAL_POLL." );
+        #endif
+
+        Webserver::reactor = reactor;
+    }
+
     bool sendMessage( const std::string& message, uint32_t destId )
     {
-        WSMessage m( destId, message );
-        bool res = outgoingMessages.offer( m, 0 );
+        PooledMessage m{ destId, BufferPool::copyOf( message ), Trace::currentFlow() };
+        Trace::instant( "webserver", "send", m.flowId );
+
+        if ( destId == 0 && options.replayFrames > 0 )
+            keepForReplay( m, message );
+
+        return offerOutgoing( m );
+    }
+
+
+    bool sendSnapshot( const std::string& snapshot )
+    {
+        shared_ptr<Snapshot> snap;
+
+        {
+            lock_guard lock( snapshotsMutex );
+
+            if ( ++snapshotVersion == 0 )  // 0 means no version
+                snapshotVersion = 1;
+
+            snap = make_shared<Snapshot>( snapshotVersion, BufferPool::copyOf( snapshot ));
+            snapshots.push_back( snap );
+
+            if ( snapshots.size() > MAX_SNAPSHOTS )
+                snapshots.pop_front();
+        }
+
+        PooledMessage m{ 0, snap->data, Trace::currentFlow() };
+        m.snapshot = std::move( snap );
+        Trace::instant( "webserver", "send", m.flowId );
+
+        return offerOutgoing( m );
+    }
+
+
+    bool sendValue( const Json::Value& value, uint32_t destId )
+    {
+        PooledMessage m{ destId, BufferPool::acquire( 256 ), Trace::currentFlow() };
+        Json::write( value, m.data );
+
+        // Binary encodings for the clients connected now; for a codec without clients the
+        // value is kept and encoded by encodedFor() if one connects before delivery
+        m.document = make_shared<ValueDocument>();
+        bool pending = false;
+
+        for ( Codec codec : { Codec::Cbor, Codec::MsgPack } )
+        {
+            if ( codecClients[ (int) codec ] > 0 )
+            {
+                m.document->encoded[ (int) codec ] = BufferPool::acquire( m.data.size() );
+                encode( codec, value, m.document->encoded[ (int) codec ] );
+            }
+            else
+            {
+                pending = true;
+            }
+        }
+
+        if ( pending )
+            m.document->value = value;
+
+        Trace::instant( "webserver", "send", m.flowId );
+
+        if ( destId == 0 && options.replayFrames > 0 )
+            keepForReplay( m, options.replayKey ? m.data.str() : string() );
+
+        return offerOutgoing( m );
+    }
+
+
+    /**
+     * Queues a message for the server instances: a broadcast goes to every instance,
+     * sharing the message buffer, and a message for a single connection goes to the
+     * instance owning it.
+     * @return false if an outgoing queue was full.
+     */
+    static bool offerOutgoing( const PooledMessage& m )
+    {
+        uint32_t destId = m.connectionId;
+        int first = (destId == 0) ? 0 : (int) ((destId - 1) % instanceCount);
+        int last = (destId == 0) ? instanceCount - 1 : first;
+        bool res = true;
+
+        for ( int i = first; i <= last; i++ )
+        {
+            ServerInstance& instance = *instances[i];
 
-        if (res)
-            interrupt(); // wake lws_service function
+            if ( instance.outgoingMessages.offer( m, 0 ))
+            {
+                if ( instance.context != nullptr )
+                    lws_cancel_service( instance.context ); // wake lws_service function
+            }
+            else
+            {
+                metrics().txDropped.inc();
+                res = false;
+            }
+        }
 
         return res;
     }
 
     std::optional<WSMessage> receiveMessage( uint32_t timeoutMsec )
     {
-        return userCallback ? nullopt : incomingMessages.take( timeoutMsec );
+        if ( userCallback || valueCallback )
+            return nullopt;
+
+        auto m = incomingMessages.take( timeoutMsec );
+        if ( !m.has_value() )
+            return nullopt;
+
+        releaseIncoming( *m );
+
+        return WSMessage( m->connectionId, m->data.str() );
     }
 
     int getClientCount()
     {
-        lock_guard lock( wsConnectionsMutex );
-        return (int) wsConnections.size();
+        int count = 0;
+
+        for ( int i = 0; i < instanceCount; i++ )
+        {
+            lock_guard lock( instances[i]->wsConnectionsMutex );
+            count += (int) instances[i]->wsConnections.size();
+        }
+
+        return count;
     }
 
     bool isRunning()
@@ -249,38 +651,149 @@ namespace lwsdk::Webserver
 
     void start()
     {
-        if ( serverThread != nullptr )
+        if ( instances[0]->serverThread != nullptr || (reactor != nullptr && keepWorking) )
             return;
 
         if ( port == sslPort )
-            throw RuntimeException( PRETTY_FUNC + " - port and sslPort cannot be the same." );
+            throw RuntimeException( "port and sslPort cannot be the same." );
 
-        if ( port <= 0 && sslPort <= 0 )
-            throw RuntimeException( PRETTY_FUNC + " - At least one port must be valid." );
+        if ( port <= 0 && sslPort <= 0 && unixSocketPath.empty() )
+            throw RuntimeException( "At least one port or a unix socket must be configured." );
 
         if ( !Files::exists(webDir) )
             throw RuntimeException( PRETTY_FUNC + " - Invalid web directory: " + webDir );
 
+        if ( reactor != nullptr && instanceCount > 1 )
+            throw RuntimeException( "Multiple server instances cannot be serviced by a reactor." );
+
+        metrics();   // register metrics before any traffic
+        sendingCount = 0;
+
+        {
+            lock_guard lock( replayMutex );
+            replayRing.clear();
+        }
+
+        dispatchingCount = 0;
         keepWorking = true;
-        serverThread = new thread( mainServerThread );
+
+        if ( reactor == nullptr )
+        {
+            for ( int i = 0; i < instanceCount; i++ )
+                instances[i]->serverThread = new thread( mainServerThread, instances[i].get() );
+
+            return;
+        }
+
+        // Reactor mode, lws is serviced by the reactor's thread
+        reactor->post( [] {
+            ServerInstance& instance = *instances[0];
+
+            try
+            {
+                createContext( instance );
+
+                // lws needs to be serviced periodically to handle its timeouts
+                reactorTimerId = reactor->runAfter( 1000, [&instance] {
+                    if ( instance.context != nullptr )
+                    {
+                        lws_service_fd( instance.context, nullptr );
+                        flushOutgoingMessages( instance );
+                    }
+                }, 1000 );
+            }
+            catch ( const std::exception& e )
+            {
+                loge( "Web server error: %s",  e.what() );
+                destroyContext( instance );
+            }
+        });
     }
 
 
     void stop()
     {
-        if ( serverThread == nullptr )
+        if ( reactor != nullptr )
+        {
+            if ( !keepWorking )
+                return;
+
+            keepWorking = false;
+
+            // lws must be torn down in the reactor's thread; run inline if there is no
+            // other thread to do it
+            if ( reactor->isReactorThread() || !reactor->isRunning() )
+            {
+                reactor->cancel( reactorTimerId );
+                destroyContext( *instances[0] );
+                return;
+            }
+
+            promise<void> done;
+            reactor->post( [&done] {
+                reactor->cancel( reactorTimerId );
+                destroyContext( *instances[0] );
+                done.set_value();
+            });
+            done.get_future().wait();
+            return;
+        }
+
+        if ( instances[0]->serverThread == nullptr )
             return;
 
-        // tell main thread loop to exit
+        // tell main thread loops to exit
         keepWorking = false;
         interrupt();
 
-        // Wait for thread to finish
-        serverThread->join();
+        // Wait for threads to finish
+        for ( int i = 0; i < instanceCount; i++ )
+        {
+            ServerInstance& instance = *instances[i];
+
+            if ( instance.serverThread == nullptr )
+                continue;
 
-        // Cleanup
-        delete serverThread;
-        serverThread = nullptr;
+            instance.serverThread->join();
+
+            // Cleanup
+            delete instance.serverThread;
+            instance.serverThread = nullptr;
+        }
+    }
+
+
+    bool shutdown( uint32_t timeoutMsec )
+    {
+        if ( !keepWorking )
+            return true;
+
+        auto deadline = chrono::steady_clock::now() + chrono::milliseconds( timeoutMsec );
+        bool drained = isDrained();
+
+        // Queues are drained by the server/reactor thread, which cannot be waited for
+        // from itself
+        while ( !drained && chrono::steady_clock::now() < deadline &&
+                !(reactor != nullptr && reactor->isReactorThread()) )
+        {
+            interrupt();
+            this_thread::sleep_for( chrono::milliseconds( 1 ));
+            drained = isDrained();
+        }
+
+        if ( !drained )
+        {
+            int outgoing = 0;
+            for ( int i = 0; i < instanceCount; i++ )
+                outgoing += instances[i]->outgoingMessages.size();
+
+            logw( "Web server shutdown deadline reached; in=%d out=%d sending=%d",
+                  incomingMessages.size(), outgoing, sendingCount.load() );
+        }
+
+        stop();
+
+        return drained;
     }
 
 
@@ -293,225 +806,616 @@ namespace lwsdk::Webserver
      */
     static void interrupt()
     {
-        if ( context != nullptr )
-            lws_cancel_service( context );
+        for ( int i = 0; i < instanceCount; i++ )
+        {
+            if ( instances[i]->context != nullptr )
+                lws_cancel_service( instances[i]->context );
+        }
+    }
+
+
+    /**
+     * Returns the server instance owning the given lws connection.
+     */
+    static ServerInstance& instanceOf( struct lws *wsi )
+    {
+        return *(ServerInstance *) lws_context_user( lws_get_context( wsi ));
     }
 
 
     /**
-     * Adds a connection data object to the list.
+     * Adds a connection data object to the instance's list.
      * @return pointer to added structure, null if the maximum number
      *         of connections is reached.
      */
-    static WSConnection* addConnection( struct lws * wsi )
+    static WSConnection* addConnection( ServerInstance& instance, struct lws * wsi )
     {
-        lock_guard lock( wsConnectionsMutex );
+        lock_guard lock( instance.wsConnectionsMutex );
 
-        if ( wsConnections.size() >= MAX_CLIENTS )
+        if ( instance.wsConnections.size() >= MAX_CLIENTS )
         {
             loge( "MAX_CLIENTS reached." );
             return nullptr;
         }
 
-        // Ensure sequence is never 0 if it wraps around
-        if ( connectionIdSeq == 0)
-            connectionIdSeq++;
+        // IDs are handed out in steps of instanceCount, so that (id - 1) % instanceCount
+        // tells the instance owning the connection; never 0, even if it wraps around
+        uint32_t id = instance.connectionIdSeq;
+        instance.connectionIdSeq += instanceCount;
 
-        uint32_t id = connectionIdSeq++;   // ok if rolls over
+        if ( instance.connectionIdSeq < id )
+            instance.connectionIdSeq = instance.index + 1;
 
-        wsConnections.emplace( make_pair( id, WSConnection( id, wsi)) );
+        instance.wsConnections.emplace( make_pair( id, WSConnection( id, wsi)) );
 
-        return &wsConnections.find( id )->second;
+        return &instance.wsConnections.find( id )->second;
 
     }
 
     /**
-     * Find a connection object by id
-     * @return Pointer to the requested connection, null if the given
-     *         id is not found in the list.
+     * Removes the connection associated with the given id from the instance's list.
+     * @return true if the id was found and removed, false otherwise.
      */
-    static WSConnection* getConnection( uint32_t id )
+    static bool removeConnection( ServerInstance& instance, uint32_t id )
     {
-        lock_guard lock( wsConnectionsMutex );
-
-        auto it = wsConnections.find( id );
-        if ( it != wsConnections.end() )
-            return &it->second;
-
-        return nullptr;
+        lock_guard lock( instance.wsConnectionsMutex );
+        return instance.wsConnections.erase( id ) > 0;
     }
 
+
     /**
-     * Removes the connection associated with the given id from the list.
-     * @return true if the id was found and removed, false otherwise.
+     * Queues a message for writing on the connection: right away if the connection is
+     * idle, otherwise after the messages already queued. The message is dropped if the
+     * connection's queue is full.
      */
-    static bool removeConnection( uint32_t id )
+    static void queueMessage( WSConnection& connection, const PooledMessage& m )
     {
-        lock_guard lock( wsConnectionsMutex );
-        return wsConnections.erase( id ) > 0;
+        if ( !connection.outbox )
+        {
+            connection.outbox = m.data;
+            connection.outFlowId = m.flowId;
+            connection.outBinary = m.binary;
+            connection.outpos = 0;
+            sendingCount++;
+            lws_callback_on_writable( connection.wsi ); // schedule a lws_callback to write
+            return;
+        }
+
+        if ( connection.pending.size() >= MAX_PENDING )
+        {
+            loge( "Connection %u send queue full; dropping message", connection.id );
+            metrics().txDropped.inc();
+            return;
+        }
+
+        connection.pending.push_back( m );
     }
 
 
     /**
-     * Main dispatcher thread loop to deliver received messages to user callback
+     * Moves the connection on to its next queued message once the outbox was written out.
+     * @return true if there is another message to write, false if the connection is idle.
      */
-    static void mainDispatcherThread()
+    static bool nextMessage( WSConnection& connection )
     {
-        logw( "Dispatcher thread stating ..." );
-        while ( keepWorking && userCallback )
+        if ( connection.pending.empty() )
         {
-            try
-            {
-                // block until new message arrives
-                WSMessage m = incomingMessages.take();
+            connection.outbox.reset(); // release buffer
+            sendingCount--;
+            return false;
+        }
 
-                try
-                {
-                    // Invoke user callback
-                    userCallback( m.connectionId, m.msg );
-                }
-                catch ( const std::exception& e2 )
-                {
-                    loge( "User callback finished with errors - %s ", e2.what() );
-                }
+        PooledMessage& m = connection.pending.front();
+        connection.outbox = std::move( m.data );
+        connection.outFlowId = m.flowId;
+        connection.outBinary = m.binary;
+        connection.outpos = 0;
+        connection.pending.pop_front();
 
-            }
-            catch ( const InterruptedException& e )
-            {
-                logw( "Dispatcher thread was interrupted! " );
-            }
+        return true;
+    }
 
-        } // while
 
-        logw( "Dispatcher thread exited." );
+    /**
+     * Discards the connection's outbox and queued messages, e.g. when it is closed.
+     */
+    static void discardMessages( WSConnection& connection )
+    {
+        if ( connection.outbox )
+            sendingCount--;
+
+        if ( connection.batch )
+            sendingCount--;
+
+        connection.outbox.reset();
+        connection.pending.clear();
+        connection.batch.reset();
+        connection.batchFirst.data.reset();
     }
 
+
     /**
-     * Main service thread loop for web server
+     * Queues the connection's batch for writing, if any. A batch of one message is sent as
+     * that message alone.
      */
-    static void mainServerThread()
+    static void closeBatch( WSConnection& connection )
     {
-        logw( "Web server thread started ..." );
+        if ( !connection.batch )
+            return;
 
-        struct lws_context_creation_info info{};
+        lws_set_timer_usecs( connection.wsi, LWS_SET_TIMER_USEC_CANCEL );
+        sendingCount--;   // counted by queueMessage() from now on
 
-        try
+        if ( connection.batch.size() == 5 + connection.batchFirst.data.size() )
         {
-            // Set what debug level to emit and to send it to syslog
-            int logs = LLL_USER | LLL_ERR | LLL_WARN /*| LLL_NOTICE*/
-            /* for LLL_ verbosity above NOTICE to be built into lws,
-             * lws must have been configured and built with
-             * -DCMAKE_BUILD_TYPE=DEBUG instead of =RELEASE */
-            /* | LLL_INFO */ /* | LLL_PARSER */ /* | LLL_HEADER */
-            /* | LLL_EXT */ /* | LLL_CLIENT */ /* | LLL_LATENCY */
-            /* | LLL_DEBUG */;
-
-            lws_set_log_level( logs, nullptr );
-
-            // Set origin dir, the location of web documents, note that
-            // the char *pointer returned by data() is OK as the server configuration is not
-            // allowed to change while the server is running. Also since C++11 data() is null terminated.
-            mount.origin = webDir.data();
-
-            // Create context
-            memset( &info, 0, sizeof info );
-            info.options = LWS_SERVER_OPTION_EXPLICIT_VHOSTS  // only creates the context without default vhost, manually added below
-                           // | LWS_SERVER_OPTION_HTTP_HEADERS_SECURITY_BEST_PRACTICES_ENFORCE;  // page can only include same domain resources
-                           ;
-
-            context = lws_create_context( &info );
-            if ( !context )
-                throw RuntimeException( PRETTY_FUNC + " - libwebsocket context init failed." );
-
-            // Populate info structure to  create virtual hosts
-            // Common config for all hosts
-            //info.iface = "eth0";     // bond to specific adapter, otherwise all e.g. "eth1" "eth2" "wifi0"
-            info.gid = -1;             // group id to change to after setting listen socket, or -1.
-            info.uid = -1;             // user id to change to after setting listen socket, or -1.
-            info.error_document_404 = "/404.html";
-
-            // Websocket config for all hosts
-            info.protocols = protocols;
-            info.options |= LWS_SERVER_OPTION_VALIDATE_UTF8;
-            //info.extensions = exts;   // deflate websockets extensions to support compressed streams
-
-            // Setup http host
-            if ( port > 0 )
-            {
-                info.vhost_name = hostname.data();
-                info.port = port;
-                info.mounts = &mount;
+            queueMessage( connection, connection.batchFirst );
+        }
+        else
+        {
+            PooledMessage m{ connection.id, std::move( connection.batch ), connection.batchFirst.flowId };
+            m.binary = true;
+            queueMessage( connection, m );
+            metrics().txBatches.inc();
+        }
 
-                if ( !lws_create_vhost( context, &info ))
-                    throw RuntimeException( PRETTY_FUNC + " - libwebsocket failed to create http vhost." );
+        connection.batch.reset();
+        connection.batchFirst.data.reset();
+    }
 
-            }
 
+    /**
+     * Queues a message for writing on the connection, adding text messages to the
+     * connection's batch if it batches messages. A batch is sent when its delay expires
+     * or it fills up.
+     */
+    static void batchMessage( WSConnection& connection, const PooledMessage& m )
+    {
+        if ( !connection.batching || m.binary || m.data.size() + 5 > options.batchMaxBytes )
+        {
+            closeBatch( connection );   // keep the messages in order
+            queueMessage( connection, m );
+            return;
+        }
 
-            // Setup https host
-            if ( sslPort > 0 )
-            {
-                info.vhost_name = hostname.data();
-                info.port = sslPort;
-                info.mounts = &mount;
-                info.options |= LWS_SERVER_OPTION_DO_SSL_GLOBAL_INIT;
-                info.ssl_cert_filepath = sslCertPath.data();
-                info.ssl_private_key_filepath = sslKeyPath.data();
+        if ( connection.batch && connection.batch.size() + 4 + m.data.size() > options.batchMaxBytes )
+            closeBatch( connection );
 
-                if ( !lws_create_vhost( context, &info ) )
-                    throw RuntimeException( PRETTY_FUNC + " - libwebsocket failed to create https vhost." );
+        if ( !connection.batch )
+        {
+            connection.batch = BufferPool::acquire( options.batchMaxBytes );
+            connection.batch.append( "B", 1 );
+            connection.batchFirst = m;
+            sendingCount++;   // the batch counts as data not yet written
+            lws_set_timer_usecs( connection.wsi, options.batchDelayUs );
+        }
 
-            }
+        Delta::put32( connection.batch, (uint32_t) m.data.size() );
+        connection.batch.append( m.data.data(), m.data.size() );
+    }
 
-            // If there is a user callback, start dispatcher thread
-            if ( userCallback )
-            {
-                logw( "Web server thread starting message dispatcher thread ..." );
-                msgDispatcherThread = new thread( mainDispatcherThread );
-            }
 
-            // Thread Main loop
-            int n = 0;
-            
-            while ( n >= 0 && keepWorking )
-            {
-                n = lws_service( context, 0 );
+    /**
+     * Test if any inbound limit is set, see ServerOptions::rxMessagesPerSec.
+     */
+    static bool rxLimited()
+    {
+        return options.rxMessagesPerSec > 0 || options.rxBytesPerSec > 0 || options.rxQueueShare > 0;
+    }
 
 
-                #if LOGGER_ENABLED
-                putchar( 'o' );
-                fflush( stdout );
-                #endif
+    /**
+     * Sets up the inbound limits of a new connection, with full token buckets.
+     */
+    static void initReceive( WSConnection& connection )
+    {
+        connection.rxQueued = make_shared<atomic_int>( 0 );
+        connection.rxMsgTokens = options.rxMessagesPerSec;
+        connection.rxByteTokens = options.rxBytesPerSec;
+        connection.rxRefillNs = chrono::duration_cast<chrono::nanoseconds>( chrono::steady_clock::now().time_since_epoch() ).count();
+        connection.rxTimer.connection = &connection;
+    }
+
+
+    /**
+     * Returns the number of microseconds until the connection is under its inbound limits,
+     * 0 if it is now, or -1 if it has to wait for the application to take its messages.
+     * Held messages are offered to the incoming queue first, in order.
+     */
+    static long receiveWaitUs( WSConnection& connection )
+    {
+        // Refill buckets, each holds up to one second worth of its rate
+        int64_t now = chrono::duration_cast<chrono::nanoseconds>( chrono::steady_clock::now().time_since_epoch() ).count();
+        double elapsed = (double) (now - connection.rxRefillNs) / 1e9;
+        connection.rxRefillNs = now;
+
+        if ( options.rxMessagesPerSec > 0 )
+            connection.rxMsgTokens = min( (double) options.rxMessagesPerSec,
+                                          connection.rxMsgTokens + elapsed * options.rxMessagesPerSec );
+
+        if ( options.rxBytesPerSec > 0 )
+            connection.rxByteTokens = min( (double) options.rxBytesPerSec,
+                                           connection.rxByteTokens + elapsed * options.rxBytesPerSec );
+
+        while ( !connection.rxHeld.empty() )
+        {
+            (*connection.rxQueued)++;
+
+            if ( !incomingMessages.offer( connection.rxHeld.front(), 0 ))
+            {
+                (*connection.rxQueued)--;
+                return RX_RETRY_US;
+            }
+
+            connection.rxHeld.pop_front();
+        }
+
+        // A message may overdraw a bucket, it is paid back before receiving more
+        double wait = 0;
+
+        if ( options.rxMessagesPerSec > 0 && connection.rxMsgTokens < 1 )
+            wait = (1 - connection.rxMsgTokens) / options.rxMessagesPerSec;
+
+        if ( options.rxBytesPerSec > 0 && connection.rxByteTokens < 0 )
+            wait = max( wait, -connection.rxByteTokens / options.rxBytesPerSec );
+
+        if ( wait > 0 )
+            return max( 1000L, (long) (wait * 1e6) );
+
+        if ( options.rxQueueShare > 0 && *connection.rxQueued >= options.rxQueueShare )
+            return -1;
+
+        return 0;
+    }
+
+
+    /**
+     * lws timer callback, re-checks the limits of a paused connection.
+     */
+    static void rxTimerCallback( lws_sorted_usec_list_t *sul )
+    {
+        updateReceive( *((RxTimer *) sul)->connection );
+    }
+
+
+    /**
+     * Pauses or resumes receiving on the connection according to its inbound limits.
+     * While paused lws stops reading the socket, so the client is pushed back by TCP.
+     */
+    static void updateReceive( WSConnection& connection )
+    {
+        long waitUs = receiveWaitUs( connection );
+
+        if ( waitUs == 0 )
+        {
+            if ( connection.rxPaused )
+            {
+                lws_rx_flow_control( connection.wsi, 1 );
+                connection.rxPaused = false;
+            }
+
+            return;
+        }
+
+        if ( !connection.rxPaused )
+        {
+            lws_rx_flow_control( connection.wsi, 0 );
+            connection.rxPaused = true;
+            metrics().rxPaused.inc();
+        }
+
+        // Otherwise woken up by releaseIncoming()
+        if ( waitUs > 0 )
+            lws_sul_schedule( lws_get_context( connection.wsi ), 0, &connection.rxTimer.sul, rxTimerCallback, waitUs );
+    }
 
-                // Copy outgoing messages to their respective connection
-                // output buffers, if any
-                while ( outgoingMessages.size() > 0 )
+
+    /**
+     * Accounts for a message taken from the incoming queue; wakes the instance owning its
+     * connection if the connection may be paused waiting for its queue share.
+     */
+    static void releaseIncoming( const PooledMessage& m )
+    {
+        if ( !m.rxQueued )
+            return;
+
+        if ( (*m.rxQueued)-- == options.rxQueueShare )
+        {
+            ServerInstance& instance = *instances[ (m.connectionId - 1) % instanceCount ];
+            instance.rxWakeup = true;
+
+            if ( instance.context != nullptr )
+                lws_cancel_service( instance.context );
+        }
+    }
+
+
+    /**
+     * Keeps a broadcast message for replay to the connections opened later, and tags it
+     * with its sequence number. Messages not kept keep seq 0, so connections opened while
+     * they are queued still get them.
+     */
+    static void keepForReplay( PooledMessage& m, const std::string& message )
+    {
+        string key = options.replayKey ? options.replayKey( message ) : string();
+
+        lock_guard lock( replayMutex );
+
+        if ( options.replayKey )
+        {
+            if ( key.empty() )
+                return;
+
+            // Only the latest message of each key is kept
+            for ( auto it = replayRing.begin(); it != replayRing.end(); ++it )
+            {
+                if ( it->key == key )
                 {
-                    WSMessage m = outgoingMessages.take();
-                    shared_ptr<string> msg = std::make_shared<string>(m.msg);
+                    replayRing.erase( it );
+                    break;
+                }
+            }
+        }
 
-                    for ( auto& conn : wsConnections )
-                    {
-                        if ( conn.second.outbox ) // still sending?
-                        {
-                            loge( "Connection %u busy sending; skipping..", conn.first );
-                            continue;
-                        }
+        m.seq = ++broadcastSeq;
+        replayRing.push_back( ReplayFrame{ std::move( key ), m } );
+
+        if ( (int) replayRing.size() > options.replayFrames )
+            replayRing.pop_front();
+    }
+
+
+    /**
+     * Returns the message as sent to the connection: a sendValue() document in the
+     * connection's binary encoding, if it has one, the message itself otherwise.
+     */
+    static PooledMessage encodedFor( const WSConnection& connection, const PooledMessage& m )
+    {
+        if ( connection.codec == Codec::Json || !m.document )
+            return m;
+
+        PooledBuffer encoded;
+
+        {
+            lock_guard lock( m.document->mtx );
+            PooledBuffer& buffer = m.document->encoded[ (int) connection.codec ];
+
+            // First client of this codec since the document was sent
+            if ( !buffer )
+            {
+                buffer = BufferPool::acquire( m.data.size() );
+                encode( connection.codec, m.document->value, buffer );
+
+                if ( m.document->encoded[ (int) Codec::Cbor ] && m.document->encoded[ (int) Codec::MsgPack ] )
+                    m.document->value = Json::Value();
+            }
+
+            encoded = buffer;
+        }
+
+        PooledMessage binary{ m.connectionId, encoded, m.flowId };
+        binary.seq = m.seq;
+        binary.binary = true;
+        return binary;
+    }
+
+
+    /**
+     * Queues the messages kept for replay on a new connection. Broadcasts replayed here are
+     * skipped when they come out of the outgoing queue later on, see flushOutgoingMessages().
+     */
+    static void replay( WSConnection& connection )
+    {
+        if ( options.replayFrames <= 0 )
+            return;
+
+        lock_guard lock( replayMutex );
+
+        for ( auto& frame : replayRing )
+            queueMessage( connection, encodedFor( connection, frame.message ));
+
+        connection.replayedSeq = broadcastSeq;
+        metrics().txReplayed.inc( (long) replayRing.size() );
+    }
 
-                        if ( m.connectionId == 0 || m.connectionId == conn.first )
-                        {
-                            conn.second.outbox = msg;
-                            conn.second.outpos = 0;
-                            lws_callback_on_writable( conn.second.wsi ); // schedule a lws_callback to write
 
-                            // Flush pending callback writes
-                            n = lws_service( context, 0 );
-                        }
+    /**
+     * Returns the snapshot frame for a ws0-delta client holding the given base version:
+     * a delta if the base is still kept and the delta is under half the snapshot size,
+     * the full snapshot otherwise.
+     */
+    static PooledBuffer snapshotFrame( Snapshot& snapshot, uint32_t baseVersion )
+    {
+        shared_ptr<Snapshot> base;
+
+        if ( baseVersion != 0 )
+        {
+            lock_guard lock( snapshotsMutex );
+
+            for ( auto& s : snapshots )
+            {
+                if ( s->version == baseVersion )
+                    base = s;
+            }
+        }
+
+        lock_guard lock( snapshot.framesMutex );
+
+        auto it = snapshot.frames.find( base ? baseVersion : 0 );
+        if ( it != snapshot.frames.end() )
+        {
+            (it->second.data()[0] == 'F' ? metrics().txFull : metrics().txDeltas).inc();
+            return it->second;
+        }
+
+        if ( base )
+        {
+            PooledBuffer frame = BufferPool::acquire( snapshot.data.size() / 2 + 9 );
+            frame.append( "D", 1 );
+            Delta::put32( frame, snapshot.version );
+            Delta::put32( frame, baseVersion );
+
+            if ( Delta::encode( base->data.view(), snapshot.data.view(), frame, snapshot.data.size() / 2 ))
+            {
+                snapshot.frames[ baseVersion ] = frame;
+                metrics().txDeltas.inc();
+                return frame;
+            }
+        }
+
+        // Full frame, also used from now on for the base the delta did not pay off for
+        PooledBuffer& full = snapshot.frames[ 0 ];
+        if ( !full )
+        {
+            full = BufferPool::acquire( snapshot.data.size() + 5 );
+            full.append( "F", 1 );
+            Delta::put32( full, snapshot.version );
+            full.append( snapshot.data.data(), snapshot.data.size() );
+        }
+
+        if ( base )
+            snapshot.frames[ baseVersion ] = full;
+
+        metrics().txFull.inc();
+        return full;
+    }
+
+
+    /**
+     * Queues the latest snapshot in full on a new ws0-delta connection, so it has a base
+     * for the deltas that follow.
+     */
+    static void sendLatestSnapshot( WSConnection& connection )
+    {
+        shared_ptr<Snapshot> latest;
+
+        {
+            lock_guard lock( snapshotsMutex );
+            if ( !snapshots.empty() )
+                latest = snapshots.back();
+        }
+
+        if ( !latest )
+            return;
+
+        PooledMessage m{ connection.id, snapshotFrame( *latest, 0 ), 0 };
+        m.binary = true;
+        queueMessage( connection, m );
+    }
+
+
+    /**
+     * Delivers a received message to the user callbacks: decoded to the value callback if
+     * set and the message decodes, as a string to the message callback otherwise.
+     */
+    static void dispatch( const PooledMessage& m, const MessageCallback_t& callback, const ValueCallback_t& valueCb )
+    {
+        TraceSpan span( "webserver", "dispatch", m.flowId );
+        ScopedTimer timer( &metrics().dispatchNs );
+
+        if ( valueCb )
+        {
+            // Parsed in place, the message string is never created
+            Expected<Json::Value> value = decode( m.codec, m.data.view() );
+            if ( value )
+            {
+                valueCb( m.connectionId, *value );
+                return;
+            }
+
+            metrics().rxInvalid.inc();
+            logw( "Invalid document from connection %u: %s", m.connectionId, value.error().message().c_str() );
+        }
+
+        if ( callback )
+            callback( m.connectionId, m.data.str() );
+    }
+
+
+    /**
+     * Main dispatcher thread loop to deliver received messages to user callback
+     */
+    static void mainDispatcherThread()
+    {
+        ThreadScope scope( "webserver.dispatcher", "ws-dispatch" );
+        logw( "Dispatcher thread stating ..." );
+        while ( keepWorking && (userCallback || valueCallback) )
+        {
+            // block until new message arrives, or interrupted on exit
+            Expected<PooledMessage> next = incomingMessages.tryTake();
+            if ( !next )
+            {
+                logw( "Dispatcher thread was interrupted! " );
+                continue;
+            }
+
+            PooledMessage m = std::move( *next );
+            dispatchingCount++;
+            releaseIncoming( m );
+
+            // Hand off to thread pool, if any; the message is decoded by the thread
+            // handling it
+            MessageCallback_t callback = userCallback;
+            ValueCallback_t valueCb = valueCallback;
+            ThreadPool *pool = threadPool;
+
+            if ( pool != nullptr && (callback || valueCb) &&
+                 pool->submit( [callback, valueCb, m] {
+                     try
+                     {
+                         dispatch( m, callback, valueCb );
+                     }
+                     catch ( const std::exception& e2 )
+                     {
+                         loge( "User callback finished with errors - %s ", e2.what() );
+                     }
+
+                     dispatchingCount--;
+                 }) )
+                continue;
+
+            try
+            {
+                // Invoke user callback
+                dispatch( m, callback, valueCb );
+            }
+            catch ( const std::exception& e2 )
+            {
+                loge( "User callback finished with errors - %s ", e2.what() );
+            }
+
+            dispatchingCount--;
+
+        } // while
+
+        logw( "Dispatcher thread exited." );
+    }
+
+    /**
+     * Main service thread loop for web server
+     */
+    static void mainServerThread( ServerInstance *instance )
+    {
+        ThreadScope scope( "webserver", instance->index == 0 ? "ws-server" : "ws-server-" + to_string( instance->index ));
+        logw( "Web server thread started ..." );
 
-                    } // for
+        try
+        {
+            createContext( *instance );
 
-                } // while
+            // Thread Main loop
+            int n = 0;
+            
+            while ( n >= 0 && keepWorking )
+            {
+                n = lws_service( instance->context, 0 );
+
+
+                #if LOGGER_ENABLED
+                putchar( 'o' );
+                fflush( stdout );
+                #endif
 
+                flushOutgoingMessages( *instance );
             }
 
         }
@@ -521,13 +1425,173 @@ namespace lwsdk::Webserver
 
         }
 
+        destroyContext( *instance );
+
+        logw( "Web server thread stopped." );
+    }
+
+
+    /**
+     * lws allocator routing its allocations through the tracked allocator, see Alloc.h.
+     */
+    static void* lwsAllocator( void *ptr, size_t size, const char *reason )
+    {
+        return Alloc::reallocate( ptr, size );
+    }
+
+
+    /**
+     * Creates the instance's lws context and its virtual hosts; the first instance also
+     * starts the message dispatcher thread if needed.
+     *
+     * @throw RuntimeException if lws fails to initialize.
+     */
+    static void createContext( ServerInstance& instance )
+    {
+        struct lws_context_creation_info info{};
+
+        // Set what debug level to emit and to send it to syslog
+        int logs = LLL_USER | LLL_ERR | LLL_WARN /*| LLL_NOTICE*/
+        /* for LLL_ verbosity above NOTICE to be built into lws,
+         * lws must have been configured and built with
+         * -DCMAKE_BUILD_TYPE=DEBUG instead of =RELEASE */
+        /* | LLL_INFO */ /* | LLL_PARSER */ /* | LLL_HEADER */
+        /* | LLL_EXT */ /* | LLL_CLIENT */ /* | LLL_LATENCY */
+        /* | LLL_DEBUG */;
+
+        lws_set_log_level( logs, nullptr );
+
+        if ( Alloc::isEnabled() )
+            lws_set_allocator( lwsAllocator );
+
+        // Set origin dir, the location of web documents, note that
+        // the char *pointer returned by data() is OK as the server configuration is not
+        // allowed to change while the server is running. Also since C++11 data() is null terminated.
+        mount.origin = webDir.data();
+
+        // Route the event stream path, if any, ahead of the static content
+        struct lws_http_mount *mounts = &mount;
+        if ( !options.ssePath.empty() )
+        {
+            sseMount.mountpoint = options.ssePath.data();
+            sseMount.mountpoint_len = (unsigned char) options.ssePath.size();
+            mounts = &sseMount;
+        }
+
+        // Create context
+        memset( &info, 0, sizeof info );
+        info.options = LWS_SERVER_OPTION_EXPLICIT_VHOSTS  // only creates the context without default vhost, manually added below
+                       // | LWS_SERVER_OPTION_HTTP_HEADERS_SECURITY_BEST_PRACTICES_ENFORCE;  // page can only include same domain resources
+                       ;
+
+        // In reactor mode, fds created along with the context must be reported to our http
+        // callback, too
+        if ( reactor != nullptr )
+            info.protocols = protocols;
+
+        // Callbacks find their instance through the context
+        info.user = &instance;
+
+        instance.context = lws_create_context( &info );
+        if ( !instance.context )
+            throw RuntimeException( "libwebsocket context init failed." );
+
+        struct lws_context *context = instance.context;
+
+        // Populate info structure to  create virtual hosts
+        // Common config for all hosts
+        //info.iface = "eth0";     // bond to specific adapter, otherwise all e.g. "eth1" "eth2" "wifi0"
+        info.gid = -1;             // group id to change to after setting listen socket, or -1.
+        info.uid = -1;             // user id to change to after setting listen socket, or -1.
+        info.error_document_404 = "/404.html";
+
+        // Websocket config for all hosts
+        info.protocols = protocols;
+        info.options |= LWS_SERVER_OPTION_VALIDATE_UTF8;
+
+        // Instances bind the same ports with SO_REUSEPORT, the kernel balances accepts
+        if ( instanceCount > 1 )
+            info.options |= LWS_SERVER_OPTION_ALLOW_LISTEN_SHARE;
+        //info.extensions = exts;   // deflate websockets extensions to support compressed streams
+
+        // Setup http host
+        if ( port > 0 )
+        {
+            info.vhost_name = hostname.data();
+            info.port = port;
+            info.mounts = mounts;
+
+            if ( !lws_create_vhost( context, &info ))
+                throw RuntimeException( "libwebsocket failed to create http vhost." );
+
+        }
+
+
+        // Setup unix socket host, lws takes the socket path from iface; SO_REUSEPORT
+        // does not apply to unix sockets, so the first instance serves it alone
+        if ( !unixSocketPath.empty() && instance.index == 0 )
+        {
+            struct lws_context_creation_info unixInfo = info;
+            unixInfo.vhost_name = hostname.data();
+            unixInfo.port = 0;
+            unixInfo.iface = unixSocketPath.data();
+            unixInfo.mounts = mounts;
+            unixInfo.options |= LWS_SERVER_OPTION_UNIX_SOCK;
+            unixInfo.options &= ~LWS_SERVER_OPTION_ALLOW_LISTEN_SHARE;
+
+            // A socket file left over by a previous run would make bind() fail
+            removeSocketFile();
+
+            if ( !lws_create_vhost( context, &unixInfo ))
+                throw RuntimeException( "libwebsocket failed to create unix socket vhost." );
+        }
+
+
+        // Setup https host
+        if ( sslPort > 0 )
+        {
+            info.vhost_name = hostname.data();
+            info.port = sslPort;
+            info.mounts = mounts;
+            info.options |= LWS_SERVER_OPTION_DO_SSL_GLOBAL_INIT;
+            info.ssl_cert_filepath = sslCertPath.data();
+            info.ssl_private_key_filepath = sslKeyPath.data();
+
+            // lws offers h2 by default when built with it; keep HTTP/1.1 unless opted in
+            info.alpn = options.http2 ? "h2,http/1.1" : "http/1.1";
+
+            if ( !lws_create_vhost( context, &info ) )
+                throw RuntimeException( "libwebsocket failed to create https vhost." );
+
+        }
+
+        // If there is a user callback, start dispatcher thread
+        if ( (userCallback || valueCallback) && instance.index == 0 )
+        {
+            logw( "Web server thread starting message dispatcher thread ..." );
+            msgDispatcherThread = new thread( mainDispatcherThread );
+        }
+    }
+
+
+    /**
+     * Destroys the instance's lws context; the first instance also waits for the message
+     * dispatcher thread to exit.
+     */
+    static void destroyContext( ServerInstance& instance )
+    {
         logw( "Web server thread freeing context ..." );
-        if ( context != nullptr )
-            lws_context_destroy( context );
+        if ( instance.context != nullptr )
+            lws_context_destroy( instance.context );
 
-        context = nullptr;
+        instance.context = nullptr;
         keepWorking = false;
 
+        if ( instance.index != 0 )
+            return;
+
+        removeSocketFile();
+
 
         // Wait for dispatcher thread to exit, if any
         if ( msgDispatcherThread != nullptr )
@@ -538,8 +1602,143 @@ namespace lwsdk::Webserver
             delete msgDispatcherThread;
             msgDispatcherThread = nullptr;
         }
+    }
 
-        logw( "Web server thread stopped." );
+
+    /**
+     * Removes the unix socket file, if configured; files other than sockets are left alone.
+     */
+    static void removeSocketFile()
+    {
+        struct stat st{};
+
+        if ( unixSocketPath.empty() || unixSocketPath[0] == '@' )
+            return;
+
+        if ( ::lstat( unixSocketPath.c_str(), &st ) == 0 && S_ISSOCK( st.st_mode ))
+            ::unlink( unixSocketPath.c_str() );
+    }
+
+
+    /**
+     * Copy outgoing messages to their respective connection output buffers, if any.
+     */
+    static void flushOutgoingMessages( ServerInstance& instance )
+    {
+        // Resume the connections that got their share of the incoming queue back
+        if ( instance.rxWakeup.exchange( false ))
+        {
+            for ( auto& conn : instance.wsConnections )
+            {
+                if ( conn.second.rxPaused )
+                    updateReceive( conn.second );
+            }
+        }
+
+        while ( instance.outgoingMessages.size() > 0 )
+        {
+            PooledMessage m = instance.outgoingMessages.take();
+            TraceSpan span( "webserver", "flush", m.flowId );
+
+            for ( auto& conn : instance.wsConnections )
+            {
+                if ( m.connectionId != 0 && m.connectionId != conn.first )
+                    continue;
+
+                // Already sent when the connection was opened
+                if ( m.seq != 0 && m.seq <= conn.second.replayedSeq )
+                    continue;
+
+                bool idle = !conn.second.outbox;
+
+                if ( m.snapshot && conn.second.delta )
+                {
+                    PooledMessage frame{ m.connectionId, snapshotFrame( *m.snapshot, conn.second.ackedVersion ), m.flowId };
+                    frame.binary = true;
+                    batchMessage( conn.second, frame );
+                }
+                else
+                {
+                    batchMessage( conn.second, encodedFor( conn.second, m ));
+                }
+
+                // Flush pending callback writes
+                if ( idle && reactor == nullptr )
+                    lws_service( instance.context, 0 );
+
+            } // for
+
+        } // while
+    }
+
+
+    /**
+     * Test if all received messages were handled and all outgoing messages were written
+     * out to their clients.
+     */
+    static bool isDrained()
+    {
+        for ( auto& instance : instances )
+        {
+            if ( !instance->outgoingMessages.isEmpty() )
+                return false;
+        }
+
+        return incomingMessages.isEmpty() && dispatchingCount <= 0 && sendingCount <= 0;
+    }
+
+
+    /**
+     * Handle the plain http protocol events. In reactor mode, this is also where lws
+     * reports the file descriptors it needs polled.
+     */
+    static int httpCallback( struct lws *wsi, enum lws_callback_reasons reason, void *user, void *in, size_t len )
+    {
+        if ( reactor != nullptr )
+        {
+            auto *pa = (struct lws_pollargs *) in;
+
+            switch ( reason )
+            {
+                case LWS_CALLBACK_ADD_POLL_FD:
+                {
+                    int fd = pa->fd;
+                    reactorPollEvents[ fd ] = pa->events;
+
+                    // Note poll() and epoll event bits have the same values
+                    // Reactor mode runs a single instance
+                    reactor->add( fd, (uint32_t) pa->events, [fd]( uint32_t events ) {
+                        ServerInstance& instance = *instances[0];
+                        if ( instance.context == nullptr )
+                            return;
+
+                        struct lws_pollfd pfd{};
+                        pfd.fd = fd;
+                        pfd.events = (short) reactorPollEvents[ fd ];
+                        pfd.revents = (short) events;
+
+                        lws_service_fd( instance.context, &pfd );
+                        flushOutgoingMessages( instance );
+                    });
+                    return 0;
+                }
+
+                case LWS_CALLBACK_DEL_POLL_FD:
+                    reactorPollEvents.erase( pa->fd );
+                    reactor->remove( pa->fd );
+                    return 0;
+
+                case LWS_CALLBACK_CHANGE_MODE_POLL_FD:
+                    reactorPollEvents[ pa->fd ] = pa->events;
+                    reactor->modify( pa->fd, (uint32_t) pa->events );
+                    return 0;
+
+                default:
+                    break;
+            }
+        }
+
+        return lws_callback_http_dummy( wsi, reason, user, in, len );
     }
 
 
@@ -567,11 +1766,32 @@ namespace lwsdk::Webserver
             case LWS_CALLBACK_ESTABLISHED:
             {
                 logi( "LWS_CALLBACK_ESTABLISHED" );
-                pss->connection = addConnection( wsi );
+                pss->connection = addConnection( instanceOf( wsi ), wsi );
 
                 if ( pss->connection == nullptr )
                     return -1;
 
+                metrics().clients.inc();
+                initReceive( *pss->connection );
+
+                // The encoding is needed by the replayed messages already
+                const char *name = lws_get_protocol( wsi )->name;
+
+                if ( strcmp( name, "ws0-cbor" ) == 0 )
+                    pss->connection->codec = Codec::Cbor;
+                else if ( strcmp( name, "ws0-msgpack" ) == 0 )
+                    pss->connection->codec = Codec::MsgPack;
+
+                codecClients[ (int) pss->connection->codec ]++;
+                replay( *pss->connection );
+
+                if ( strcmp( name, "ws0-delta" ) == 0 )
+                {
+                    // Only ws0-delta clients unpack batch envelopes
+                    pss->connection->delta = true;
+                    pss->connection->batching = options.batchDelayUs > 0;
+                    sendLatestSnapshot( *pss->connection );
+                }
 
                 logw( "\nclients=%d", getClientCount());
 
@@ -586,7 +1806,11 @@ namespace lwsdk::Webserver
                if ( pss->connection == nullptr )
                     return -1;
 
-               removeConnection( pss->connection->id );
+               discardMessages( *pss->connection );
+               lws_sul_cancel( &pss->connection->rxTimer.sul );
+               codecClients[ (int) pss->connection->codec ]--;
+               removeConnection( instanceOf( wsi ), pss->connection->id );
+               metrics().clients.dec();
                logw("\nclients=%d", getClientCount() );
 
                break;
@@ -613,23 +1837,57 @@ namespace lwsdk::Webserver
                 #if LOGGER_ENABLED
                 Utils::memdump( in, len );
                 #endif
-                
 
-                if ( first )
-                    connection->inbox.clear();
+                // Snapshot acks are consumed here, see Snapshot
+                if ( connection->delta && binary && first && final && len == 5 && *(char *) in == 'A' )
+                {
+                    uint32_t version = Delta::get32( (char *) in + 1 );
+
+                    // Versions only wrap after billions of snapshots, ignore stale acks
+                    if ( version - connection->ackedVersion < 0x80000000u )
+                        connection->ackedVersion = version;
 
-                connection->inbox.append( (char *) in, (long) len );
+                    break;
+                }
+
+                // Start a new buffer for every message, the previous one may still be queued
+                if ( first || !connection->inbox )
+                    connection->inbox = BufferPool::acquire( final ? len : MAX_PAYLOAD );
+
+                connection->inbox.append( in, len );
+                connection->rxByteTokens -= (double) len;
 
                 if ( final )
                 {
-                    WSMessage msg( connection->id, connection->inbox );
-                    if ( !incomingMessages.offer( msg, 0 ))
+                    long size = (long) connection->inbox.size();
+                    uint64_t flowId = Trace::newFlowId();
+
+                    Trace::instant( "webserver", "receive", flowId );
+
+                    metrics().rxMessages.inc();
+                    metrics().rxBytes.inc( size );
+                    PooledMessage msg{ connection->id, std::move( connection->inbox ), flowId };
+                    msg.codec = binary ? connection->codec : Codec::Json;
+
+                    // With inbound limits, every message is charged and held until it fits in
+                    // the incoming queue, its connection paused meanwhile. lws may still hand
+                    // over messages it read before the pause; they are held behind, in order.
+                    if ( rxLimited() )
+                    {
+                        msg.rxQueued = connection->rxQueued;
+                        connection->rxMsgTokens -= 1;
+                        connection->rxHeld.push_back( std::move( msg ));
+                    }
+                    else if ( !incomingMessages.offer( std::move( msg ), 0 ))
                     {
-                        loge( "Incoming queue full; discarding incoming message: '%s'",
-                              connection->inbox.c_str() );
+                        loge( "Incoming queue full; discarding incoming message of %ld bytes", size );
+                        metrics().rxDropped.inc();
                     }
                 }
 
+                if ( rxLimited() )
+                    updateReceive( *connection );
+
                 //lws_callback_on_writable( wsi );
                 //lws_callback_on_writable_all_protocol( context, &protocols[1] );              // a) --or--
                 //lws_callback_on_writable_all_protocol( lws_get_context(wsi), &protocols[1] );   // b)
@@ -649,48 +1907,64 @@ namespace lwsdk::Webserver
                 if ( !connection->outbox  ) // spurious write callback? ignore
                     return 0;
 
-                string &s = *connection->outbox;
+                TraceSpan span( "webserver", "write", connection->outFlowId );
+
+                PooledBuffer &s = connection->outbox;
                 char* buf = connection->outbuf;   // formatted as [LWS_PRE:DATA_BUFFER]
 
                 // Compute start pos and byte count of the next chunk of text to send
-                // from the outbox string
+                // from the outbox buffer
                 int start = connection->outpos;                            // outbox's chunk start
                 int end = std::min( (int)s.size(), start + MAX_PAYLOAD );  // outbox's chunk end
                 int length = end - start;                                  // chunk's length
                 connection->outpos = end;                                  // save position of next chunk
 
-                memcpy( &buf[LWS_PRE], &s[start], length );
+                memcpy( &buf[LWS_PRE], s.data() + start, length );
 
                 // Generate lws write flags
                 int first = (start == 0);                                  // is first chunk?
-                int final = (start + MAX_PAYLOAD >= (int)s.length() );     // is last chunk?
-                int flags = lws_write_ws_flags( LWS_WRITE_TEXT, first, final);
+                int final = (start + MAX_PAYLOAD >= (int)s.size() );       // is last chunk?
+                int flags = lws_write_ws_flags( connection->outBinary ? LWS_WRITE_BINARY : LWS_WRITE_TEXT, first, final);
 
                 logi("WRITE: destId=%d, slen=%d, range[ %03d..%03d ), len=%d, first=%d, final=%d",
-                             connection->id, (int)s.length(), start, end, length, first, final );
+                             connection->id, (int)s.size(), start, end, length, first, final );
 
-                // Write chunk from outbox's string
+                // Write chunk from outbox's buffer
                 // notice we allowed for LWS_PRE spare space in front of payload data
                 int n = lws_write( wsi, (unsigned char *)&buf[LWS_PRE], length,
                                         (enum lws_write_protocol)flags );
 
-                if ( n < length || final )
-                    connection->outbox = nullptr; // free string
+                if ( n > 0 )
+                    metrics().txBytes.inc( n );
+
+                if ( final && n >= length )
+                    metrics().txMessages.inc();
 
                 if (n < length)
                 {
                     loge("WRITE: Incomplete write error, only %d of %d written to ws socket\n", n, length );
+                    discardMessages( *connection );
                     return -1;
                 }
 
-                // If not done, request write for next chunk
-                if ( !final )
+                // If not done, or more messages are queued, request write for next chunk
+                if ( !final || nextMessage( *connection ))
 		            lws_callback_on_writable(wsi);
 
                 break;
             }
 
 
+            // The connection's batching delay expired
+            case LWS_CALLBACK_TIMER:
+            {
+                if ( pss->connection != nullptr )
+                    closeBatch( *pss->connection );
+
+                break;
+            }
+
+
             case LWS_CALLBACK_CLIENT_CONFIRM_EXTENSION_SUPPORTED:
             {
                 logw( "LWS_CALLBACK_CLIENT_CONFIRM_EXTENSION_SUPPORTED" );
@@ -714,6 +1988,150 @@ namespace lwsdk::Webserver
     }
 
 
+    /**
+     * Handle Server-Sent Events streams: the request is answered with a text/event-stream
+     * response that is kept open, and every message sent to the connection is written out
+     * as one event.
+     */
+    static int sseCallback( struct lws *wsi, enum lws_callback_reasons reason, void *user, void *in, size_t len )
+    {
+        struct per_session_data *pss = (struct per_session_data *) user;
+
+        switch ( reason )
+        {
+            // A client opened the stream, reply headers and add it to our list
+            case LWS_CALLBACK_HTTP:
+            {
+                logi( "SSE LWS_CALLBACK_HTTP" );
+                pss->connection = addConnection( instanceOf( wsi ), wsi );
+
+                if ( pss->connection == nullptr )
+                    return -1;
+
+                pss->connection->sse = true;
+                metrics().sseClients.inc();
+
+                unsigned char headers[ LWS_PRE + 256 ];
+                unsigned char *start = &headers[ LWS_PRE ];
+                unsigned char *p = start;
+                unsigned char *end = &headers[ sizeof( headers ) - 1 ];
+                static const char noCache[] = "no-cache";
+
+                if ( lws_add_http_common_headers( wsi, HTTP_STATUS_OK, "text/event-stream",
+                                                  LWS_ILLEGAL_HTTP_CONTENT_LEN, &p, end ) ||
+                     lws_add_http_header_by_token( wsi, WSI_TOKEN_HTTP_CACHE_CONTROL,
+                                                   (const unsigned char *) noCache, sizeof( noCache ) - 1, &p, end ) ||
+                     lws_finalize_write_http_header( wsi, start, &p, end ))
+                    return -1;
+
+                // The stream stays open indefinitely, drop the pending http timeout
+                lws_set_timeout( wsi, NO_PENDING_TIMEOUT, 0 );
+
+                replay( *pss->connection );
+
+                logw( "\nclients=%d", getClientCount());
+                return 0;
+            }
+
+            // A client closed the stream, remove it from our list
+            case LWS_CALLBACK_CLOSED_HTTP:
+            {
+                logi( "SSE LWS_CALLBACK_CLOSED_HTTP" );
+
+                if ( pss == nullptr || pss->connection == nullptr )
+                    break;
+
+                discardMessages( *pss->connection );
+                removeConnection( instanceOf( wsi ), pss->connection->id );
+                pss->connection = nullptr;
+                metrics().sseClients.dec();
+                logw( "\nclients=%d", getClientCount() );
+
+                break;
+            }
+
+            // Application is sending data to the client, write the next chunk of the event
+            case LWS_CALLBACK_HTTP_WRITEABLE:
+            {
+                if ( pss->connection == nullptr )
+                    return -1;
+
+                WSConnection* connection = pss->connection;
+                if ( !connection->outbox  ) // spurious write callback? ignore
+                    return 0;
+
+                TraceSpan span( "webserver", "write", connection->outFlowId );
+
+                PooledBuffer &s = connection->outbox;
+                const char *data = s.data();
+                int size = (int) s.size();
+                int start = connection->outpos;
+                char *out = &connection->outbuf[LWS_PRE];
+                int length = 0;
+
+                // Every line of the message goes out as a "data:" field; line breaks need
+                // up to 7 bytes, so stop filling the chunk when there is no room for one
+                if ( start == 0 )
+                {
+                    memcpy( out, "data: ", 6 );
+                    length = 6;
+                }
+
+                int pos = start;
+                while ( pos < size && length <= MAX_PAYLOAD - 7 )
+                {
+                    char c = data[pos++];
+
+                    if ( c == '\n' )
+                    {
+                        memcpy( &out[length], "\ndata: ", 7 );
+                        length += 7;
+                    }
+                    else if ( c != '\r' )  // a bare CR would end the field, too
+                    {
+                        out[length++] = c;
+                    }
+                }
+
+                connection->outpos = pos;
+
+                // The blank line terminating the event goes out with the last chunk
+                int final = (pos >= size && length <= MAX_PAYLOAD - 2);
+                if ( final )
+                {
+                    out[length++] = '\n';
+                    out[length++] = '\n';
+                }
+
+                int n = lws_write( wsi, (unsigned char *) out, length, LWS_WRITE_HTTP );
+
+                if ( n > 0 )
+                    metrics().txBytes.inc( n );
+
+                if ( final && n >= length )
+                    metrics().txMessages.inc();
+
+                if ( n < length )
+                {
+                    loge( "SSE WRITE: Incomplete write error, only %d of %d written to socket", n, length );
+                    discardMessages( *connection );
+                    return -1;
+                }
+
+                if ( !final || nextMessage( *connection ))
+                    lws_callback_on_writable( wsi );
+
+                return 0;
+            }
+
+            default:
+                break;
+        }
+
+        return lws_callback_http_dummy( wsi, reason, user, in, len );
+    }
+
+
     /**
      * Converts libwebsocket event number to string, for debugging purposes.
      */
@@ -0,0 +1,748 @@
+/********************************************************************************
+ *  This file is part of the lopezworks SDK utility library for C/C++ (lwsdk).
+ *
+ *  Copyright (C) 2015-2017 Edwin R. Lopez
+ *  http://www.lopezworks.info
+ *
+ *  This source code is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation LGPL v2.1
+ *  (http://www.gnu.org/licenses/).
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ *  02110-1301  USA.
+ ********************************************************************************/
+#include <map>
+#include <random>
+#include <future>
+#include <cstring>
+
+#include "WebsocketClient.h"
+#include "Exceptions.h"
+#include "Reactor.h"
+#include "Metrics.h"
+#include "Threads.h"
+#include "Codecs.h"
+
+#include <libwebsockets.h>
+
+#define LOGGER_ENABLED 0   // turn off verbose logging
+#include "Logger.h"
+
+using namespace std;
+
+namespace lwsdk
+{
+    #define MAX_PAYLOAD 4096                          // Size of the chunks messages are written in
+    #define SERVICE_PERIOD_MS 1000                    // lws housekeeping period in reactor mode
+
+    // lws timer scheduling the next connection attempt
+    struct ReconnectTimer {
+        lws_sorted_usec_list_t sul;                   // must be first, the lws callback gets its address
+        WebsocketClient *client;
+    };
+
+
+    // Holds the lws state of a client
+    struct WebsocketClient::Session {
+        atomic<struct lws_context *> context{nullptr}; // LWS context, read by send() from other threads
+        mutex contextMutex;                           // held while waking the context from other threads
+        struct lws *wsi{nullptr};                     // connection, null while disconnected
+        ReconnectTimer timer{};                       // reconnect timer, thread mode
+        uint64_t timerId{0};                          // reconnect timer, reactor mode
+        uint32_t attempts{0};                         // connection attempts since last connected
+        int outpos{0};                                // bytes of the first queued message already written
+        PooledBuffer inbox;                           // message being received
+        map<int, int> pollEvents;                     // poll() events requested by lws for each fd, reactor mode only
+        minstd_rand random{ random_device()() };      // reconnect jitter
+        char outbuf[ LWS_PRE + MAX_PAYLOAD ]{0};      // chunk being written, with spare LWS_PRE-sized space
+    };
+
+
+    // lws callbacks, friends of WebsocketClient
+    struct WebsocketClientCallbacks {
+        static int callback( struct lws *wsi, enum lws_callback_reasons reason, void *user, void *in, size_t len );
+        static int pollCallback( WebsocketClient& client, enum lws_callback_reasons reason, void *in );
+        static void reconnectCallback( lws_sorted_usec_list_t *sul );
+    };
+
+    static struct lws_protocols clientProtocols[] = {
+        { "lwsdk-client", WebsocketClientCallbacks::callback, 0, MAX_PAYLOAD, 0, nullptr, 0 },
+        { nullptr, nullptr, 0 /* End of list */ }
+    };
+
+
+    WebsocketClient::WebsocketClient( const std::string& url, const ClientOptions& options ) :
+            url( url ), options( options ), session( make_unique<Session>() ),
+            alive( make_shared<atomic_bool>( true ))
+    {
+        parseUrl();
+
+        // Metrics are kept per URL, so they survive re-creating the client
+        txMessagesMetric = &Metrics::counter( "wsclient", "tx_messages", url, "Websocket messages sent" );
+        txBytesMetric    = &Metrics::counter( "wsclient", "tx_bytes", url, "Websocket payload bytes sent" );
+        txDroppedMetric  = &Metrics::counter( "wsclient", "tx_dropped", url, "Messages not sent, send queue full" );
+        rxMessagesMetric = &Metrics::counter( "wsclient", "rx_messages", url, "Websocket messages received" );
+        rxBytesMetric    = &Metrics::counter( "wsclient", "rx_bytes", url, "Websocket payload bytes received" );
+        reconnectsMetric = &Metrics::counter( "wsclient", "reconnects", url, "Connection attempts after a failure or disconnect" );
+
+        session->timer.client = this;
+    }
+
+
+    WebsocketClient::WebsocketClient( Reactor& reactor, const std::string& url, const ClientOptions& options ) :
+            WebsocketClient( url, options )
+    {
+        #if LWS_LIBRARY_VERSION_MAJOR >= 4 && !defined(LWS_WITH_EXTERNAL_POLL)
+        throw RuntimeException( "libwebsockets was built without LWS_WITH_EXTERNAL_POLL." );
+        #endif
+
+        // No service thread, the lws sockets are watched by the reactor while started
+        this->reactor = &reactor;
+    }
+
+
+    WebsocketClient::~WebsocketClient()
+    {
+        stop();
+
+        // Tasks still queued in the reactor find the client gone; wait for one that may be
+        // running in the reactor's thread
+        *alive = false;
+
+        if ( reactor != nullptr && reactor->isRunning() && !reactor->isReactorThread() )
+        {
+            promise<void> done;
+            reactor->post( [&done] { done.set_value(); } );
+            done.get_future().wait();
+        }
+    }
+
+
+    void WebsocketClient::setMessageCallback( const WSClientMessageCallback_t& messageCallback )
+    {
+        this->messageCallback = messageCallback;
+    }
+
+
+    void WebsocketClient::setStatusCallback( const WSClientStatusCallback_t& statusCallback )
+    {
+        this->statusCallback = statusCallback;
+    }
+
+
+    void WebsocketClient::start()
+    {
+        if ( keepWorking )
+            return;
+
+        keepWorking = true;
+
+        if ( reactor == nullptr )
+        {
+            serviceThread = new thread( &WebsocketClient::serviceThreadLoop, this );
+            return;
+        }
+
+        // Reactor mode, lws is serviced by the reactor's thread
+        reactor->post( [this, alive = alive] {
+            if ( !*alive || !keepWorking )
+                return;
+
+            try
+            {
+                createContext();
+                connect();
+
+                // lws needs to be serviced periodically to handle its timeouts
+                serviceTimerId = reactor->runAfter( SERVICE_PERIOD_MS, [this] {
+                    if ( session->context != nullptr )
+                        lws_service_fd( session->context, nullptr );
+                }, SERVICE_PERIOD_MS );
+            }
+            catch ( const std::exception& e )
+            {
+                loge( "Websocket client error: %s", e.what() );
+                destroyContext();
+            }
+        });
+    }
+
+
+    void WebsocketClient::stop()
+    {
+        if ( !keepWorking )
+            return;
+
+        keepWorking = false;
+
+        if ( reactor != nullptr )
+        {
+            auto teardown = [this] {
+                reactor->cancel( serviceTimerId );
+                reactor->cancel( session->timerId );
+                destroyContext();
+            };
+
+            // lws must be torn down in the reactor's thread; run inline if there is no
+            // other thread to do it
+            if ( reactor->isReactorThread() || !reactor->isRunning() )
+            {
+                teardown();
+                return;
+            }
+
+            promise<void> done;
+            reactor->post( [&teardown, &done] {
+                teardown();
+                done.set_value();
+            });
+            done.get_future().wait();
+            return;
+        }
+
+        {
+            lock_guard lock( session->contextMutex );
+
+            if ( session->context != nullptr )
+                lws_cancel_service( session->context );
+        }
+
+        if ( serviceThread != nullptr )
+        {
+            serviceThread->join();
+            delete serviceThread;
+            serviceThread = nullptr;
+        }
+    }
+
+
+    bool WebsocketClient::send( const std::string& message, bool binary )
+    {
+        {
+            lock_guard lock( mtx );
+
+            if ( (int) sendQueue.size() >= options.sendQueueSize )
+            {
+                txDroppedMetric->inc();
+                return false;
+            }
+
+            sendQueue.push_back( OutMessage{ BufferPool::copyOf( message ), binary } );
+        }
+
+        wakeup();
+        return true;
+    }
+
+
+    bool WebsocketClient::sendValue( const Json::Value& value )
+    {
+        Codec codec = options.protocol == "ws0-cbor"    ? Codec::Cbor :
+                      options.protocol == "ws0-msgpack" ? Codec::MsgPack : Codec::Json;
+
+        PooledBuffer data = BufferPool::acquire( 256 );
+        encode( codec, value, data );
+
+        {
+            lock_guard lock( mtx );
+
+            if ( (int) sendQueue.size() >= options.sendQueueSize )
+            {
+                txDroppedMetric->inc();
+                return false;
+            }
+
+            sendQueue.push_back( OutMessage{ std::move( data ), codec != Codec::Json } );
+        }
+
+        wakeup();
+        return true;
+    }
+
+
+    bool WebsocketClient::isConnected()
+    {
+        return connected;
+    }
+
+
+    int WebsocketClient::getQueueSize()
+    {
+        lock_guard lock( mtx );
+        return (int) sendQueue.size();
+    }
+
+
+    std::string WebsocketClient::getUrl()
+    {
+        return url;
+    }
+
+
+    /**
+     * Splits the URL into address, port and path.
+     * @throw RuntimeException if the URL is not a ws:// or wss:// URL.
+     */
+    void WebsocketClient::parseUrl()
+    {
+        size_t hostStart;
+
+        if ( url.compare( 0, 5, "ws://" ) == 0 )
+            hostStart = 5;
+        else if ( url.compare( 0, 6, "wss://" ) == 0 )
+            hostStart = 6, ssl = true;
+        else
+            throw RuntimeException( "Invalid websocket URL: " + url );
+
+        size_t pathStart = url.find( '/', hostStart );
+        string hostPort = url.substr( hostStart, pathStart - hostStart );
+        path = (pathStart == string::npos) ? "/" : url.substr( pathStart );
+        port = ssl ? 443 : 80;
+
+        // IPv6 addresses are bracketed, e.g. ws://[::1]:8080/
+        size_t colon = hostPort.rfind( ':' );
+        if ( colon != string::npos && hostPort.find( ']', colon ) == string::npos )
+        {
+            char *end;
+            long n = strtol( hostPort.c_str() + colon + 1, &end, 10 );
+
+            if ( *end != '\0' || n <= 0 || n > 65535 )
+                throw RuntimeException( "Invalid websocket URL port: " + url );
+
+            port = (int) n;
+            hostPort.resize( colon );
+        }
+
+        if ( hostPort.size() > 2 && hostPort.front() == '[' && hostPort.back() == ']' )
+            hostPort = hostPort.substr( 1, hostPort.size() - 2 );
+
+        if ( hostPort.empty() )
+            throw RuntimeException( "Invalid websocket URL host: " + url );
+
+        address = hostPort;
+    }
+
+
+    /**
+     * Creates the client's lws context, which does not listen on any port.
+     * @throw RuntimeException if lws fails to initialize.
+     */
+    void WebsocketClient::createContext()
+    {
+        struct lws_context_creation_info info{};
+
+        info.port = CONTEXT_PORT_NO_LISTEN;
+        info.protocols = clientProtocols;
+        info.gid = -1;
+        info.uid = -1;
+        info.user = this;   // callbacks find their client through the context
+
+        if ( ssl )
+            info.options |= LWS_SERVER_OPTION_DO_SSL_GLOBAL_INIT;
+
+        session->context = lws_create_context( &info );
+        if ( session->context == nullptr )
+            throw RuntimeException( "libwebsocket client context init failed." );
+    }
+
+
+    /**
+     * Destroys the client's lws context, closing the connection if open.
+     */
+    void WebsocketClient::destroyContext()
+    {
+        // Once cleared under the lock, no other thread can still be waking the context; it
+        // is destroyed unlocked as its callbacks may call send()
+        struct lws_context *context;
+
+        {
+            lock_guard lock( session->contextMutex );
+            context = session->context.exchange( nullptr );
+        }
+
+        if ( context != nullptr )
+            lws_context_destroy( context );
+
+        session->wsi = nullptr;
+        session->outpos = 0;
+        session->attempts = 0;
+        connected = false;
+    }
+
+
+    /**
+     * Starts a connection attempt; failures are reported to the callback, which schedules
+     * the next attempt.
+     */
+    void WebsocketClient::connect()
+    {
+        struct lws_client_connect_info info{};
+
+        info.context = session->context;
+        info.address = address.c_str();
+        info.port = port;
+        info.path = path.c_str();
+        info.host = address.c_str();
+        info.origin = options.origin.empty() ? address.c_str() : options.origin.c_str();
+        info.protocol = options.protocol.empty() ? nullptr : options.protocol.c_str();
+        info.local_protocol_name = clientProtocols[0].name;
+        info.pwsi = &session->wsi;
+
+        if ( ssl )
+        {
+            info.ssl_connection = LCCSCF_USE_SSL;
+
+            if ( options.allowSelfSigned )
+                info.ssl_connection |= LCCSCF_ALLOW_SELFSIGNED | LCCSCF_SKIP_SERVER_CERT_HOSTNAME_CHECK;
+        }
+
+        logi( "Websocket client connecting to %s ...", url.c_str() );
+
+        // Counted here only, lws may report a failed attempt both ways below
+        session->attempts++;
+
+        if ( lws_client_connect_via_info( &info ) == nullptr )
+            scheduleReconnect();
+    }
+
+
+    /**
+     * Schedules the next connection attempt, backing off exponentially with jitter.
+     */
+    void WebsocketClient::scheduleReconnect()
+    {
+        if ( !keepWorking || session->context == nullptr )
+            return;
+
+        // Attempts that failed in a row, none if the connection was lost
+        uint32_t failed = session->attempts > 0 ? session->attempts - 1 : 0;
+        uint64_t delay = min( (uint64_t) options.reconnectMaxMs,
+                              (uint64_t) max( 1u, options.reconnectMinMs ) << min( failed, 20u ));
+
+        // Half fixed, half random
+        delay = delay / 2 + session->random() % (delay / 2 + 1);
+
+        logi( "Websocket client reconnecting to %s in %u ms", url.c_str(), (uint32_t) delay );
+
+        // lws may report a failed attempt both ways, rescheduling replaces the pending attempt
+        if ( reactor != nullptr )
+        {
+            reactor->cancel( session->timerId );
+            session->timerId = reactor->runAfter( (uint32_t) delay, [this] {
+                if ( keepWorking && session->context != nullptr )
+                {
+                    reconnectsMetric->inc();
+                    connect();
+                }
+            });
+        }
+        else
+        {
+            lws_sul_schedule( session->context, 0, &session->timer.sul,
+                              WebsocketClientCallbacks::reconnectCallback, (long long) delay * 1000 );
+        }
+    }
+
+
+    /**
+     * Has the servicing thread ask lws for a writable callback, unless already asked.
+     */
+    void WebsocketClient::wakeup()
+    {
+        if ( writeRequested.exchange( true ))
+            return;
+
+        if ( reactor != nullptr )
+        {
+            // Nothing to write to while stopped; start() connects and sends what is queued
+            if ( !keepWorking )
+            {
+                writeRequested = false;
+                return;
+            }
+
+            reactor->post( [this, alive = alive] {
+                if ( !*alive )
+                    return;
+
+                writeRequested = false;
+                if ( session->wsi != nullptr && connected )
+                    lws_callback_on_writable( session->wsi );
+            });
+            return;
+        }
+
+        lock_guard lock( session->contextMutex );
+
+        if ( session->context != nullptr )
+            lws_cancel_service( session->context ); // wake lws_service function
+    }
+
+
+    /**
+     * Writes queued messages out until the queue is empty or the socket cannot take more,
+     * in which case another writable callback is requested. Messages are written in
+     * MAX_PAYLOAD-sized fragments and removed from the queue once written in full.
+     */
+    void WebsocketClient::writeQueued()
+    {
+        struct lws *wsi = session->wsi;
+        char *buf = session->outbuf;   // formatted as [LWS_PRE:DATA_BUFFER]
+
+        while ( !lws_send_pipe_choked( wsi ))
+        {
+            OutMessage m;
+
+            {
+                lock_guard lock( mtx );
+                if ( sendQueue.empty() )
+                    return;
+
+                m = sendQueue.front();   // shares the buffer, the queue keeps it until written
+            }
+
+            // Compute start pos and byte count of the next fragment
+            int size = (int) m.data.size();
+            int start = session->outpos;
+            int end = min( size, start + MAX_PAYLOAD );
+            int length = end - start;
+
+            memcpy( &buf[LWS_PRE], m.data.data() + start, length );
+
+            int flags = lws_write_ws_flags( m.binary ? LWS_WRITE_BINARY : LWS_WRITE_TEXT, start == 0, end == size );
+            int n = lws_write( wsi, (unsigned char *) &buf[LWS_PRE], length, (enum lws_write_protocol) flags );
+
+            if ( n < length )
+            {
+                // The connection is closed by lws, the message is sent again on reconnect
+                loge( "Websocket client write error on %s, wrote %d of %d bytes", url.c_str(), n, length );
+                session->outpos = 0;
+                return;
+            }
+
+            session->outpos = end;
+
+            if ( end == size )
+            {
+                lock_guard lock( mtx );
+                sendQueue.pop_front();
+                session->outpos = 0;
+                txMessagesMetric->inc();
+                txBytesMetric->inc( size );
+            }
+        }
+
+        lws_callback_on_writable( wsi );
+    }
+
+
+    /**
+     * Service thread loop, runs lws until stop() is called.
+     */
+    void WebsocketClient::serviceThreadLoop()
+    {
+        ThreadScope scope( "wsclient", "ws-client" );
+        logi( "Websocket client thread started ..." );
+
+        try
+        {
+            createContext();
+            connect();
+
+            int n = 0;
+            while ( n >= 0 && keepWorking )
+            {
+                n = lws_service( session->context, 0 );
+
+                if ( writeRequested.exchange( false ) && session->wsi != nullptr && connected )
+                    lws_callback_on_writable( session->wsi );
+            }
+        }
+        catch ( const std::exception& e )
+        {
+            loge( "Websocket client thread error: %s", e.what() );
+        }
+
+        destroyContext();
+        logi( "Websocket client thread stopped." );
+    }
+
+
+    /**
+     * lws timer callback, starts the next connection attempt.
+     */
+    void WebsocketClientCallbacks::reconnectCallback( lws_sorted_usec_list_t *sul )
+    {
+        WebsocketClient& client = *((ReconnectTimer *) sul)->client;
+
+        if ( client.keepWorking )
+        {
+            client.reconnectsMetric->inc();
+            client.connect();
+        }
+    }
+
+
+    /**
+     * In reactor mode, watches the file descriptors lws needs polled.
+     * @return 1 if the event was handled, 0 otherwise.
+     */
+    int WebsocketClientCallbacks::pollCallback( WebsocketClient& client, enum lws_callback_reasons reason, void *in )
+    {
+        auto *pa = (struct lws_pollargs *) in;
+        auto& pollEvents = client.session->pollEvents;
+
+        switch ( reason )
+        {
+            case LWS_CALLBACK_ADD_POLL_FD:
+            {
+                int fd = pa->fd;
+                pollEvents[ fd ] = pa->events;
+
+                // Note poll() and epoll event bits have the same values
+                client.reactor->add( fd, (uint32_t) pa->events, [&client, fd]( uint32_t events ) {
+                    struct lws_context *context = client.session->context;
+                    if ( context == nullptr )
+                        return;
+
+                    struct lws_pollfd pfd{};
+                    pfd.fd = fd;
+                    pfd.events = (short) client.session->pollEvents[ fd ];
+                    pfd.revents = (short) events;
+
+                    lws_service_fd( context, &pfd );
+                });
+                return 1;
+            }
+
+            case LWS_CALLBACK_DEL_POLL_FD:
+                pollEvents.erase( pa->fd );
+                client.reactor->remove( pa->fd );
+                return 1;
+
+            case LWS_CALLBACK_CHANGE_MODE_POLL_FD:
+                pollEvents[ pa->fd ] = pa->events;
+                client.reactor->modify( pa->fd, (uint32_t) pa->events );
+                return 1;
+
+            default:
+                return 0;
+        }
+    }
+
+
+    /**
+     * Handle the client connection events.
+     */
+    int WebsocketClientCallbacks::callback( struct lws *wsi, enum lws_callback_reasons reason, void *user, void *in, size_t len )
+    {
+        auto *client = (WebsocketClient *) lws_context_user( lws_get_context( wsi ));
+
+        if ( client == nullptr )
+            return 0;
+
+        if ( client->reactor != nullptr && pollCallback( *client, reason, in ))
+            return 0;
+
+        WebsocketClient::Session& session = *client->session;
+
+        switch ( reason )
+        {
+            case LWS_CALLBACK_CLIENT_ESTABLISHED:
+            {
+                logi( "Websocket client connected to %s", client->url.c_str() );
+
+                session.attempts = 0;
+                session.outpos = 0;
+                client->connected = true;
+
+                if ( client->statusCallback )
+                    client->statusCallback( true );
+
+                // Send what was queued while disconnected
+                if ( client->getQueueSize() > 0 )
+                    lws_callback_on_writable( wsi );
+
+                break;
+            }
+
+            case LWS_CALLBACK_CLIENT_CONNECTION_ERROR:
+            {
+                logw( "Websocket client failed to connect to %s: %s", client->url.c_str(),
+                      in ? (const char *) in : "unknown error" );
+
+                session.wsi = nullptr;
+                client->scheduleReconnect();
+                break;
+            }
+
+            case LWS_CALLBACK_CLIENT_CLOSED:
+            {
+                logi( "Websocket client disconnected from %s", client->url.c_str() );
+
+                session.wsi = nullptr;
+                session.outpos = 0;     // a message cut short is sent again in full
+                session.inbox.reset();
+                client->connected = false;
+
+                if ( client->statusCallback )
+                    client->statusCallback( false );
+
+                client->scheduleReconnect();
+                break;
+            }
+
+            // The server sent us data, it might take several calls to collect all the
+            // fragments making up the whole message
+            case LWS_CALLBACK_CLIENT_RECEIVE:
+            {
+                int first = lws_is_first_fragment( wsi );
+                int final = lws_is_final_fragment( wsi );
+
+                if ( first || !session.inbox )
+                    session.inbox = BufferPool::acquire( final ? len : MAX_PAYLOAD );
+
+                session.inbox.append( in, len );
+
+                if ( final )
+                {
+                    client->rxMessagesMetric->inc();
+                    client->rxBytesMetric->inc( (long) session.inbox.size() );
+
+                    try
+                    {
+                        if ( client->messageCallback )
+                            client->messageCallback( session.inbox.str() );
+                    }
+                    catch ( const std::exception& e )
+                    {
+                        loge( "Websocket client callback finished with errors - %s ", e.what() );
+                    }
+
+                    session.inbox.reset();
+                }
+
+                break;
+            }
+
+            case LWS_CALLBACK_CLIENT_WRITEABLE:
+                if ( session.wsi != nullptr )
+                    client->writeQueued();
+                break;
+
+            default:
+                break;
+        }
+
+        return 0;
+    }
+
+} // ns